@@ -0,0 +1,227 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+/* Measures the throughput of the port and connection queries of the JACK
+ * API with a large number of ports, like a DAW does when it loads a
+ * session. Needs a running server. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <jack/jack.h>
+#include <jack/uuid.h>
+
+#define PORTS_PER_CLIENT	512
+
+struct data {
+	uint32_t n_ports;
+	uint32_t n_loops;
+
+	uint32_t n_clients;
+	jack_client_t **clients;
+
+	jack_port_t **ports;
+	char **names;
+	jack_port_id_t *ids;
+};
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, uint64_t count, uint64_t t1, uint64_t t2)
+{
+	double secs = (t2 - t1) / 1e9;
+	fprintf(stdout, "%-32s %10" PRIu64 " calls %8.3f s %12.0f calls/s %8.0f ns/call\n",
+			name, count, secs, count / secs, (t2 - t1) / (double)count);
+}
+
+static int setup(struct data *d)
+{
+	uint32_t i, j, n;
+	char name[64];
+	jack_status_t status;
+
+	d->n_clients = (d->n_ports + PORTS_PER_CLIENT - 1) / PORTS_PER_CLIENT;
+	d->clients = calloc(d->n_clients, sizeof(jack_client_t *));
+	d->ports = calloc(d->n_ports, sizeof(jack_port_t *));
+	d->names = calloc(d->n_ports, sizeof(char *));
+	d->ids = calloc(d->n_ports, sizeof(jack_port_id_t));
+	if (d->clients == NULL || d->ports == NULL || d->names == NULL || d->ids == NULL)
+		return -1;
+
+	for (i = 0, n = 0; i < d->n_clients; i++) {
+		snprintf(name, sizeof(name), "port-bench-%u", i);
+		d->clients[i] = jack_client_open(name, JackNoStartServer, &status);
+		if (d->clients[i] == NULL) {
+			fprintf(stderr, "jack_client_open() failed, status = 0x%2.0x\n", status);
+			return -1;
+		}
+		/* outputs and inputs alternate */
+		for (j = 0; j < PORTS_PER_CLIENT && n < d->n_ports; j++, n++) {
+			snprintf(name, sizeof(name), "%s_%u", j & 1 ? "in" : "out", j / 2);
+			d->ports[n] = jack_port_register(d->clients[i], name,
+					JACK_DEFAULT_AUDIO_TYPE,
+					j & 1 ? JackPortIsInput : JackPortIsOutput, 0);
+			if (d->ports[n] == NULL) {
+				fprintf(stderr, "can't register port %u\n", n);
+				return -1;
+			}
+			d->names[n] = strdup(jack_port_name(d->ports[n]));
+			d->ids[n] = jack_uuid_to_index(jack_port_uuid(d->ports[n]));
+		}
+		if (jack_activate(d->clients[i]) != 0) {
+			fprintf(stderr, "can't activate client %u\n", i);
+			return -1;
+		}
+	}
+
+	/* connect the outputs of a client to the inputs of the next client */
+	for (i = 0; i + 1 < d->n_ports; i += 2) {
+		uint32_t dst = (i + PORTS_PER_CLIENT + 1) % d->n_ports;
+		if (dst & 1)
+			jack_connect(d->clients[0], d->names[i], d->names[dst]);
+	}
+
+	/* wait until the first client knows about all ports */
+	for (i = 0; i < 100; i++) {
+		if (jack_port_by_name(d->clients[0], d->names[d->n_ports - 1]) != NULL)
+			break;
+		usleep(100000);
+	}
+	return 0;
+}
+
+static void run(struct data *d)
+{
+	jack_client_t *c = d->clients[0];
+	uint64_t t1, t2, count;
+	uint32_t i, l;
+	const char **res;
+
+	count = 0;
+	t1 = get_time_ns();
+	for (l = 0; l < d->n_loops; l++) {
+		for (i = 0; i < d->n_ports; i++, count++)
+			jack_port_by_name(c, d->names[i]);
+	}
+	t2 = get_time_ns();
+	report("jack_port_by_name", count, t1, t2);
+
+	count = 0;
+	t1 = get_time_ns();
+	for (l = 0; l < d->n_loops; l++) {
+		for (i = 0; i < d->n_ports; i++, count++)
+			jack_port_by_id(c, d->ids[i]);
+	}
+	t2 = get_time_ns();
+	report("jack_port_by_id", count, t1, t2);
+
+	count = 0;
+	t1 = get_time_ns();
+	for (l = 0; l < d->n_loops; l++) {
+		for (i = 0; i < d->n_ports; i++, count++) {
+			res = jack_port_get_all_connections(c, d->ports[i]);
+			jack_free(res);
+		}
+	}
+	t2 = get_time_ns();
+	report("jack_port_get_all_connections", count, t1, t2);
+
+	count = 0;
+	t1 = get_time_ns();
+	for (l = 0; l < d->n_loops; l++) {
+		for (i = 0; i < d->n_ports; i++, count++)
+			jack_port_connected(d->ports[i]);
+	}
+	t2 = get_time_ns();
+	report("jack_port_connected", count, t1, t2);
+
+	count = 0;
+	t1 = get_time_ns();
+	for (l = 0; l < d->n_loops; l++, count++) {
+		res = jack_get_ports(c, NULL, NULL, 0);
+		jack_free(res);
+	}
+	t2 = get_time_ns();
+	report("jack_get_ports", count, t1, t2);
+}
+
+static void cleanup(struct data *d)
+{
+	uint32_t i;
+
+	for (i = 0; d->clients != NULL && i < d->n_clients; i++) {
+		if (d->clients[i] != NULL)
+			jack_client_close(d->clients[i]);
+	}
+	for (i = 0; d->names != NULL && i < d->n_ports; i++)
+		free(d->names[i]);
+	free(d->clients);
+	free(d->ports);
+	free(d->names);
+	free(d->ids);
+}
+
+static void show_help(const char *name)
+{
+	fprintf(stdout, "%s [options]\n"
+		"  -h, --help        Show this help\n"
+		"  -p, --ports       Number of ports (default 5000)\n"
+		"  -l, --loops       Number of query loops (default 10)\n",
+		name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { .n_ports = 5000, .n_loops = 10, };
+	static const struct option long_options[] = {
+		{ "help",	no_argument,		NULL, 'h' },
+		{ "ports",	required_argument,	NULL, 'p' },
+		{ "loops",	required_argument,	NULL, 'l' },
+		{ NULL, 0, NULL, 0 }
+	};
+	int c, res = EXIT_FAILURE;
+
+	while ((c = getopt_long(argc, argv, "hp:l:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			show_help(argv[0]);
+			return EXIT_SUCCESS;
+		case 'p':
+			data.n_ports = atoi(optarg);
+			break;
+		case 'l':
+			data.n_loops = atoi(optarg);
+			break;
+		default:
+			show_help(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (data.n_ports < 2 || data.n_loops < 1) {
+		show_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (setup(&data) < 0)
+		goto exit;
+
+	fprintf(stdout, "%u ports in %u clients, %u loops\n",
+			data.n_ports, data.n_clients, data.n_loops);
+	run(&data);
+	res = EXIT_SUCCESS;
+exit:
+	cleanup(&data);
+	return res;
+}
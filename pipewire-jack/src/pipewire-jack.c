@@ -41,6 +41,10 @@
 #include "pipewire/extensions/metadata.h"
 #include "pipewire-jack-extensions.h"
 
+#ifdef HAVE_MIX_OPS
+#include "spa/plugins/audiomixer/mix-ops.h"
+#endif
+
 /* use 512KB stack per thread - the default is way too high to be feasible
  * with mlockall() on many systems */
 #define THREAD_STACK 524288
@@ -130,10 +134,27 @@ static thread_local float midi_scratch[MIDI_SCRATCH_FRAMES];
 #define OBJECT_CHUNK		8
 #define RECYCLE_THRESHOLD	128
 
+#define OBJECT_HASH_BITS	10
+#define OBJECT_HASH_SIZE	(1u << OBJECT_HASH_BITS)
+#define OBJECT_HASH_MASK	(OBJECT_HASH_SIZE - 1)
+
+#ifndef HAVE_MIX_OPS
 typedef void (*mix_func) (float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples);
+#endif
+
+struct object;
+
+/* an entry of an object in an index list */
+struct object_ref {
+	struct spa_list link;
+	struct object *object;
+	uint32_t hash;
+};
 
 struct object {
 	struct spa_list link;
+	struct spa_list id_link;
+	struct spa_list serial_link;
 
 	struct client *client;
 
@@ -168,6 +189,7 @@ struct object {
 			bool dst_ours;
 			struct port *our_input;
 			struct port *our_output;
+			struct object_ref ends[2];	/* in port.links of the output and input port */
 		} port_link;
 		struct {
 			unsigned long flags;
@@ -185,6 +207,13 @@ struct object {
 			bool is_monitor;
 			struct object *node;
 			struct spa_latency_info latency[2];
+#define PORT_NAME_NAME		0
+#define PORT_NAME_ALIAS1	1
+#define PORT_NAME_ALIAS2	2
+#define PORT_NAME_SYSTEM	3
+#define N_PORT_NAMES		4
+			struct object_ref names[N_PORT_NAMES];
+			struct spa_list links;
 		} port;
 	};
 	struct pw_proxy *proxy;
@@ -290,10 +319,33 @@ struct port {
 
 	void *(*get_buffer) (struct port *p, jack_nframes_t frames);
 
+	/* input buffer returned in the current cycle */
+	void *cycle_ptr;
+	uint64_t cycle_seq;
+	uint32_t cycle_frames;
+
 	float *emptyptr;
 	float empty[];
 };
 
+/* the mixes of a port, as seen by the process thread */
+struct rt_port {
+	struct port *port;
+	struct mix *global_mix;
+	uint32_t n_mix;
+	struct mix **mix;
+};
+
+/* A snapshot of the ports and their mixes, indexed by direction and port_id.
+ * The process thread does not walk the port map and the mix lists, those are
+ * changed by the main thread. It uses the last published snapshot instead. */
+struct rt_ports {
+	struct spa_list link;
+	uint32_t n_ports[2];
+	struct rt_port *ports[2];
+	/* followed by the ports and the mix pointers */
+};
+
 struct link {
 	struct spa_list link;
 	struct spa_list target_link;
@@ -317,6 +369,11 @@ struct context {
 	pthread_mutex_t lock;		/* protects map and lists below, in addition to thread_lock */
 	struct spa_list objects;
 	uint32_t free_count;
+
+	/* indexes of the objects by id, serial and port name */
+	struct spa_list id_hash[OBJECT_HASH_SIZE];
+	struct spa_list serial_hash[OBJECT_HASH_SIZE];
+	struct spa_list name_hash[OBJECT_HASH_SIZE];
 };
 
 #define GET_DIRECTION(f)	((f) & JackPortIsInput ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT)
@@ -432,6 +489,10 @@ struct client {
 	struct pw_map ports[2];
 	uint32_t n_ports;
 
+	struct rt_ports *rt_ports;		/* last published snapshot */
+	struct rt_ports *rt_ports_used;		/* snapshot used by the process thread */
+	struct spa_list rt_ports_retired;
+
 	struct spa_list links;
 	uint32_t driver_id;
 	struct pw_node_activation *driver_activation;
@@ -444,6 +505,8 @@ struct client {
 		struct spa_io_position *position;
 		struct pw_node_activation *driver_activation;
 		struct spa_list target_links;
+		struct rt_ports *ports;
+		uint64_t seq;
 		unsigned int prepared:1;
 		unsigned int first:1;
 		unsigned int thread_entered:1;
@@ -486,7 +549,11 @@ struct client {
 
 	uint32_t max_frames;
 	uint32_t max_align;
+#ifdef HAVE_MIX_OPS
+	struct mix_ops mix_ops;
+#else
 	mix_func mix_function;
+#endif
 
 	jack_position_t jack_position;
 	jack_transport_state_t jack_state;
@@ -522,6 +589,115 @@ int pw_jack_match_rules(const char *rules, size_t size, const struct spa_dict *p
 		int (*matched) (void *data, const char *action, const char *val, int len),
 		void *data);
 
+static inline uint32_t hash_id(uint32_t id)
+{
+	/* fibonacci hashing */
+	return (id * 0x9E3779B9u) >> (32 - OBJECT_HASH_BITS);
+}
+
+static inline uint32_t hash_name(const char *name)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+	while (*name)
+		h = (h ^ (uint8_t)*name++) * 16777619u;
+	return h;
+}
+
+/* objects are zeroed when they are recycled, a zeroed entry is not linked */
+static inline void index_remove(struct spa_list *l)
+{
+	if (l->next != NULL) {
+		spa_list_remove(l);
+		spa_zero(*l);
+	}
+}
+
+static const char *port_name_slot(struct object *o, uint32_t slot)
+{
+	switch (slot) {
+	case PORT_NAME_NAME:
+		return o->port.name;
+	case PORT_NAME_ALIAS1:
+		return o->port.alias1;
+	case PORT_NAME_ALIAS2:
+		return o->port.alias2;
+	case PORT_NAME_SYSTEM:
+		return o->port.system;
+	}
+	return "";
+}
+
+/* call after the id and serial of an object are known */
+static void object_set_id(struct client *c, struct object *o, uint32_t id, uint32_t serial)
+{
+	pthread_mutex_lock(&c->context.lock);
+	index_remove(&o->id_link);
+	index_remove(&o->serial_link);
+	o->id = id;
+	o->serial = serial;
+	if (id != SPA_ID_INVALID)
+		spa_list_append(&c->context.id_hash[hash_id(id)], &o->id_link);
+	if (serial != SPA_ID_INVALID)
+		spa_list_append(&c->context.serial_hash[hash_id(serial)], &o->serial_link);
+	pthread_mutex_unlock(&c->context.lock);
+}
+
+/* call after one of the names of a port changed */
+static void port_names_changed(struct client *c, struct object *o)
+{
+	uint32_t i;
+
+	pthread_mutex_lock(&c->context.lock);
+	for (i = 0; i < N_PORT_NAMES; i++) {
+		struct object_ref *n = &o->port.names[i];
+		const char *name = port_name_slot(o, i);
+
+		index_remove(&n->link);
+		if (o->removed || name[0] == '\0')
+			continue;
+		n->object = o;
+		n->hash = hash_name(name);
+		spa_list_append(&c->context.name_hash[n->hash & OBJECT_HASH_MASK], &n->link);
+	}
+	pthread_mutex_unlock(&c->context.lock);
+}
+
+/* call with both ports of the link found */
+static void link_add_ports(struct client *c, struct object *l,
+		struct object *src, struct object *dst)
+{
+	pthread_mutex_lock(&c->context.lock);
+	l->port_link.ends[SPA_DIRECTION_OUTPUT].object = l;
+	spa_list_append(&src->port.links, &l->port_link.ends[SPA_DIRECTION_OUTPUT].link);
+	l->port_link.ends[SPA_DIRECTION_INPUT].object = l;
+	spa_list_append(&dst->port.links, &l->port_link.ends[SPA_DIRECTION_INPUT].link);
+	pthread_mutex_unlock(&c->context.lock);
+}
+
+/* called with context.lock when the object is freed. The serial stays
+ * valid until the object is recycled. */
+static void object_unindex(struct object *o)
+{
+	struct object_ref *r;
+	uint32_t i;
+
+	index_remove(&o->id_link);
+
+	switch (o->type) {
+	case INTERFACE_Port:
+		for (i = 0; i < N_PORT_NAMES; i++)
+			index_remove(&o->port.names[i].link);
+		spa_list_consume(r, &o->port.links, link)
+			index_remove(&r->link);
+		break;
+	case INTERFACE_Link:
+		index_remove(&o->port_link.ends[SPA_DIRECTION_OUTPUT].link);
+		index_remove(&o->port_link.ends[SPA_DIRECTION_INPUT].link);
+		break;
+	}
+}
+
 static struct object * alloc_object(struct client *c, int type)
 {
 	struct object *o;
@@ -545,6 +721,8 @@ static struct object * alloc_object(struct client *c, int type)
 	o->client = c;
 	o->removed = false;
 	o->type = type;
+	if (type == INTERFACE_Port)
+		spa_list_init(&o->port.links);
 	pw_log_debug("%p: object:%p type:%d", c, o, type);
 
 	return o;
@@ -560,6 +738,7 @@ static void recycle_objects(struct client *c, uint32_t remain)
 				c->context.free_count, remain);
 		if (o->removed) {
 			spa_list_remove(&o->link);
+			index_remove(&o->serial_link);
 			memset(o, 0, sizeof(struct object));
 			spa_list_append(&globals.free_objects, &o->link);
 			if (--c->context.free_count == remain)
@@ -578,6 +757,7 @@ static void free_object(struct client *c, struct object *o)
 			c->context.free_count, RECYCLE_THRESHOLD);
 	pthread_mutex_lock(&c->context.lock);
 	spa_list_remove(&o->link);
+	object_unindex(o);
 	o->removed = true;
 	o->id = SPA_ID_INVALID;
 	spa_list_append(&c->context.objects, &o->link);
@@ -786,6 +966,7 @@ static struct port * alloc_port(struct client *c, enum spa_direction direction)
 
 	p->valid = true;
 	p->zeroed = false;
+	p->cycle_ptr = NULL;
 	p->client = c;
 	p->object = o;
 	spa_list_init(&p->mix);
@@ -820,6 +1001,106 @@ static void free_port(struct client *c, struct port *p, bool free)
 		p->object->removing = true;
 }
 
+static void rt_ports_reclaim(struct client *c, bool all)
+{
+	struct rt_ports *s, *t;
+	struct rt_ports *used = all ? NULL : SPA_ATOMIC_LOAD(c->rt_ports_used);
+
+	spa_list_for_each_safe(s, t, &c->rt_ports_retired, link) {
+		if (s == used)
+			continue;
+		spa_list_remove(&s->link);
+		free(s);
+	}
+}
+
+/* called from thread-loop after the ports or mixes changed. The new snapshot
+ * replaces the old one atomically, the old one is freed when the process
+ * thread no longer uses it. This never waits for the process thread. */
+static int rt_ports_update(struct client *c)
+{
+	struct rt_ports *s, *old;
+	struct rt_port *rp;
+	struct mix **mp, *m;
+	struct port *p;
+	union pw_map_item *item;
+	uint32_t i, n_ports[2], n_mix = 0;
+
+	for (i = 0; i < 2; i++) {
+		n_ports[i] = pw_map_get_size(&c->ports[i]);
+		pw_array_for_each(item, &c->ports[i].items) {
+			if (pw_map_item_is_free(item))
+				continue;
+			p = item->data;
+			spa_list_for_each(m, &p->mix, port_link)
+				n_mix++;
+		}
+	}
+
+	s = calloc(1, sizeof(*s) + (n_ports[0] + n_ports[1]) * sizeof(struct rt_port) +
+			n_mix * sizeof(struct mix *));
+	if (s == NULL) {
+		pw_log_warn("%p: can't update process ports: %m", c);
+		return -errno;
+	}
+	rp = SPA_PTROFF(s, sizeof(*s), struct rt_port);
+	mp = SPA_PTROFF(rp, (n_ports[0] + n_ports[1]) * sizeof(struct rt_port), struct mix *);
+
+	for (i = 0; i < 2; i++) {
+		s->n_ports[i] = n_ports[i];
+		s->ports[i] = rp;
+		pw_array_for_each(item, &c->ports[i].items) {
+			if (!pw_map_item_is_free(item)) {
+				p = item->data;
+				rp->port = p;
+				rp->global_mix = p->global_mix;
+				rp->mix = mp;
+				spa_list_for_each(m, &p->mix, port_link)
+					mp[rp->n_mix++] = m;
+				mp += rp->n_mix;
+			}
+			rp++;
+		}
+	}
+
+	old = SPA_ATOMIC_XCHG(c->rt_ports, s);
+	if (old != NULL)
+		spa_list_append(&c->rt_ports_retired, &old->link);
+	rt_ports_reclaim(c, false);
+	return 0;
+}
+
+/* process thread, the snapshot is kept until the end of the cycle */
+static inline void rt_ports_acquire(struct client *c)
+{
+	struct rt_ports *s;
+
+	do {
+		s = SPA_ATOMIC_LOAD(c->rt_ports);
+		SPA_ATOMIC_STORE(c->rt_ports_used, s);
+	} while (s != SPA_ATOMIC_LOAD(c->rt_ports));
+
+	c->rt.ports = s;
+}
+
+static inline void rt_ports_release(struct client *c)
+{
+	c->rt.seq++;
+	c->rt.ports = NULL;
+	SPA_ATOMIC_STORE(c->rt_ports_used, NULL);
+}
+
+static inline struct rt_port *rt_port_get(struct port *p)
+{
+	struct rt_ports *s = p->client->rt.ports;
+	struct rt_port *rp;
+
+	if (SPA_UNLIKELY(s == NULL || p->port_id >= s->n_ports[p->direction]))
+		return NULL;
+	rp = &s->ports[p->direction][p->port_id];
+	return SPA_LIKELY(rp->port == p) ? rp : NULL;
+}
+
 static struct object *find_node(struct client *c, const char *name)
 {
 	struct object *o;
@@ -855,28 +1136,35 @@ static inline bool client_port_visible(struct client *c, struct object *o)
 	return o->visible;
 }
 
+/* a port name wins over the aliases and system names of other ports */
 static struct object *find_port_by_name(struct client *c, const char *name)
 {
-	struct object *o;
+	struct object_ref *n;
+	struct object *o, *found = NULL;
+	uint32_t slot, hash = hash_name(name);
 
-	spa_list_for_each(o, &c->context.objects, link) {
-		if (o->type != INTERFACE_Port || o->removed ||
+	spa_list_for_each(n, &c->context.name_hash[hash & OBJECT_HASH_MASK], link) {
+		o = n->object;
+		if (n->hash != hash || o->removed ||
 		    (!client_port_visible(c, o)))
 			continue;
-		if (spa_streq(o->port.name, name) ||
-		    spa_streq(o->port.alias1, name) ||
-		    spa_streq(o->port.alias2, name))
-			return o;
-		if (is_port_default(c, o) && spa_streq(o->port.system, name))
+		slot = n - o->port.names;
+		if (!spa_streq(port_name_slot(o, slot), name))
+			continue;
+		if (slot == PORT_NAME_SYSTEM && !is_port_default(c, o))
+			continue;
+		if (slot == PORT_NAME_NAME)
 			return o;
+		if (found == NULL)
+			found = o;
 	}
-	return NULL;
+	return found;
 }
 
 static struct object *find_by_id(struct client *c, uint32_t id)
 {
 	struct object *o;
-	spa_list_for_each(o, &c->context.objects, link) {
+	spa_list_for_each(o, &c->context.id_hash[hash_id(id)], id_link) {
 		if (o->id == id)
 			return o;
 	}
@@ -886,7 +1174,7 @@ static struct object *find_by_id(struct client *c, uint32_t id)
 static struct object *find_by_serial(struct client *c, uint32_t serial)
 {
 	struct object *o;
-	spa_list_for_each(o, &c->context.objects, link) {
+	spa_list_for_each(o, &c->context.serial_hash[hash_id(serial)], serial_link) {
 		if (o->serial == serial)
 			return o;
 	}
@@ -916,10 +1204,15 @@ static struct object *find_client(struct client *c, uint32_t client_id)
 
 static struct object *find_link(struct client *c, uint32_t src, uint32_t dst)
 {
-	struct object *l;
+	struct object *p, *l;
+	struct object_ref *r;
 
-	spa_list_for_each(l, &c->context.objects, link) {
-		if (l->type != INTERFACE_Link || l->removed)
+	if ((p = find_type(c, src, INTERFACE_Port, true)) == NULL)
+		return NULL;
+
+	spa_list_for_each(r, &p->port.links, link) {
+		l = r->object;
+		if (l->removed)
 			continue;
 		if (l->port_link.src == src &&
 		    l->port_link.dst == dst) {
@@ -929,6 +1222,7 @@ static struct object *find_link(struct client *c, uint32_t src, uint32_t dst)
 	return NULL;
 }
 
+#ifndef HAVE_MIX_OPS
 #if defined (__SSE__)
 #include <xmmintrin.h>
 static void mix_sse(float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples)
@@ -966,6 +1260,7 @@ static void mix_c(float *dst, float *src[], uint32_t n_src, bool aligned, uint32
 		dst[n] = t;
 	}
 }
+#endif
 
 SPA_EXPORT
 void jack_get_version(int *major_ptr, int *minor_ptr, int *micro_ptr, int *proto_ptr)
@@ -1792,16 +2087,20 @@ static inline void process_empty(struct port *p, uint32_t frames)
 
 static void prepare_output(struct port *p, uint32_t frames, uint32_t cycle)
 {
+	struct rt_port *rp;
 	struct mix *mix;
 	struct spa_io_buffers *io;
+	uint32_t i;
 
 	if (SPA_UNLIKELY(p->empty_out || p->tied))
 		process_empty(p, frames);
 
-	if (p->global_mix == NULL || (io = p->global_mix->io[cycle]) == NULL)
+	if ((rp = rt_port_get(p)) == NULL ||
+	    rp->global_mix == NULL || (io = rp->global_mix->io[cycle]) == NULL)
 		return;
 
-	spa_list_for_each(mix, &p->mix, port_link) {
+	for (i = 0; i < rp->n_mix; i++) {
+		mix = rp->mix[i];
 		if (SPA_LIKELY(mix->io[cycle] != NULL))
 			*mix->io[cycle] = *io;
 	}
@@ -1809,31 +2108,31 @@ static void prepare_output(struct port *p, uint32_t frames, uint32_t cycle)
 
 static void complete_process(struct client *c, uint32_t frames)
 {
-	struct port *p;
+	struct rt_ports *s = c->rt.ports;
+	struct rt_port *rp;
 	struct mix *mix;
-	union pw_map_item *item;
-	uint32_t cycle = c->rt.position->clock.cycle & 1;
+	uint32_t i, j, cycle = c->rt.position->clock.cycle & 1;
 
-	pw_array_for_each(item, &c->ports[SPA_DIRECTION_OUTPUT].items) {
-                if (pw_map_item_is_free(item))
-			continue;
-		p = item->data;
-		if (!p->valid)
+	if (SPA_UNLIKELY(s == NULL))
+		return;
+
+	for (i = 0; i < s->n_ports[SPA_DIRECTION_OUTPUT]; i++) {
+		rp = &s->ports[SPA_DIRECTION_OUTPUT][i];
+		if (rp->port == NULL || !rp->port->valid)
 			continue;
-		prepare_output(p, frames, cycle);
-		p->io[cycle].status = SPA_STATUS_NEED_DATA;
+		prepare_output(rp->port, frames, cycle);
+		rp->port->io[cycle].status = SPA_STATUS_NEED_DATA;
 	}
-	pw_array_for_each(item, &c->ports[SPA_DIRECTION_INPUT].items) {
-                if (pw_map_item_is_free(item))
-			continue;
-		p = item->data;
-		if (!p->valid)
+	for (i = 0; i < s->n_ports[SPA_DIRECTION_INPUT]; i++) {
+		rp = &s->ports[SPA_DIRECTION_INPUT][i];
+		if (rp->port == NULL || !rp->port->valid)
 			continue;
-		spa_list_for_each(mix, &p->mix, port_link) {
+		for (j = 0; j < rp->n_mix; j++) {
+			mix = rp->mix[j];
 			if (SPA_LIKELY(mix->io[cycle] != NULL))
 				mix->io[cycle]->status = SPA_STATUS_NEED_DATA;
 		}
-        }
+	}
 }
 
 static inline void debug_position(struct client *c, jack_position_t *p)
@@ -2006,6 +2305,8 @@ static inline uint32_t cycle_run(struct client *c)
 	struct pw_node_activation *activation = c->activation;
 	struct pw_node_activation *driver = c->rt.driver_activation;
 
+	rt_ports_acquire(c);
+
 	while (true) {
 		if (SPA_UNLIKELY(read(fd, &cmd, sizeof(cmd)) != sizeof(cmd))) {
 			if (errno == EINTR)
@@ -2179,6 +2480,7 @@ static inline void cycle_signal(struct client *c, int status)
 		}
 	}
 	signal_sync(c);
+	rt_ports_release(c);
 }
 
 static void
@@ -3358,6 +3660,7 @@ static int client_node_port_set_mix_info(void *data,
 		}
 		mix = create_mix(c, p, mix_id, peer_id);
 	}
+	rt_ports_update(c);
 exit:
 	if (res < 0)
 		pw_proxy_errorf((struct pw_proxy*)c->node, res,
@@ -3650,6 +3953,7 @@ static void node_info(void *data, const struct pw_node_info *info)
 
 	if (info->change_mask & PW_NODE_CHANGE_MASK_STATE) {
 		struct object *p, *l;
+		struct object_ref *r;
 		spa_list_for_each(p, &c->context.objects, link) {
 			if (p->type != INTERFACE_Port || p->removed ||
 			    p->port.node_id != info->id)
@@ -3657,8 +3961,9 @@ static void node_info(void *data, const struct pw_node_info *info)
 			if (active)
 				queue_notify(c, NOTIFY_TYPE_PORTREGISTRATION, p, 1, NULL);
 			else {
-				spa_list_for_each(l, &c->context.objects, link) {
-					if (l->type != INTERFACE_Link || l->removed ||
+				spa_list_for_each(r, &p->port.links, link) {
+					l = r->object;
+					if (l->removed ||
 					    (l->port_link.src_serial != p->serial &&
 					     l->port_link.dst_serial != p->serial))
 						continue;
@@ -3728,6 +4033,7 @@ static void port_info(void *data, const struct pw_port_info *info)
 		const char *str = spa_dict_lookup(info->props, PW_KEY_PORT_NAME);
 		if (str != NULL) {
 			if (update_port_name(o, str) > 0) {
+				port_names_changed(c, o);
 				pw_log_info("%p: port rename %u %s->%s", c, o->serial,
 						o->port.old_name, o->port.name);
 				queue_notify(c, NOTIFY_TYPE_PORT_RENAME, o, 1, NULL);
@@ -4007,11 +4313,13 @@ static void registry_event_global(void *data, uint32_t id,
 		if (node_id != c->node_id)
 			update_port_name(o, name);
 
+		port_names_changed(c, o);
+
 		pw_log_debug("%p: %p add port %d name:%s %d", c, o, id,
 				o->port.name, type_id);
 	}
 	else if (spa_streq(type, PW_TYPE_INTERFACE_Link)) {
-		struct object *p;
+		struct object *p, *src;
 
 		o = alloc_object(c, INTERFACE_Link);
 		if (o == NULL)
@@ -4025,14 +4333,14 @@ static void registry_event_global(void *data, uint32_t id,
 			goto exit_free;
 		o->port_link.src = pw_properties_parse_int(str);
 
-		if ((p = find_type(c, o->port_link.src, INTERFACE_Port, true)) == NULL)
+		if ((src = find_type(c, o->port_link.src, INTERFACE_Port, true)) == NULL)
 			goto exit_free;
-		o->port_link.src_serial = p->serial;
+		o->port_link.src_serial = src->serial;
 
-		o->port_link.src_ours = p->port.port != NULL &&
-			p->port.port->client == c;
+		o->port_link.src_ours = src->port.port != NULL &&
+			src->port.port->client == c;
 		if (o->port_link.src_ours)
-			o->port_link.our_output = p->port.port;
+			o->port_link.our_output = src->port.port;
 
 		if ((str = spa_dict_lookup(props, PW_KEY_LINK_INPUT_PORT)) == NULL)
 			goto exit_free;
@@ -4047,6 +4355,8 @@ static void registry_event_global(void *data, uint32_t id,
 		if (o->port_link.dst_ours)
 			o->port_link.our_input = p->port.port;
 
+		link_add_ports(c, o, src, p);
+
 		if (o->port_link.our_input != NULL &&
 		    o->port_link.our_output != NULL) {
 			struct mix *mix;
@@ -4102,8 +4412,7 @@ static void registry_event_global(void *data, uint32_t id,
 		goto exit;
 	}
 
-	o->id = id;
-	o->serial = serial;
+	object_set_id(c, o, id, serial);
 
 	switch (o->type) {
 	case INTERFACE_Node:
@@ -4242,6 +4551,10 @@ jack_client_t * jack_client_open (const char *client_name,
 	struct spa_cpu *cpu_iface;
 	const struct pw_properties *props;
 	va_list ap;
+	uint32_t i;
+#ifdef HAVE_MIX_OPS
+	int res;
+#endif
         jack_status_t status;
         if (getenv("PIPEWIRE_NOJACK") != NULL ||
             getenv("PIPEWIRE_INTERNAL") != NULL ||
@@ -4264,6 +4577,11 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	pthread_mutex_init(&client->context.lock, NULL);
 	spa_list_init(&client->context.objects);
+	for (i = 0; i < OBJECT_HASH_SIZE; i++) {
+		spa_list_init(&client->context.id_hash[i]);
+		spa_list_init(&client->context.serial_hash[i]);
+		spa_list_init(&client->context.name_hash[i]);
+	}
 
 	client->node_id = SPA_ID_INVALID;
 
@@ -4277,6 +4595,7 @@ jack_client_t * jack_client_open (const char *client_name,
 	spa_list_init(&client->free_ports);
 	pw_map_init(&client->ports[SPA_DIRECTION_INPUT], 32, 32);
 	pw_map_init(&client->ports[SPA_DIRECTION_OUTPUT], 32, 32);
+	spa_list_init(&client->rt_ports_retired);
 
 	spa_list_init(&client->links);
 	client->driver_id = SPA_ID_INVALID;
@@ -4335,18 +4654,30 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	support = pw_context_get_support(client->context.context, &n_support);
 
-	client->mix_function = mix_c;
 	cpu_iface = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
+#ifdef HAVE_MIX_OPS
+	client->mix_ops.fmt = SPA_AUDIO_FORMAT_F32;
+	client->mix_ops.n_channels = 1;
+	client->mix_ops.cpu_flags = cpu_iface ? spa_cpu_get_flags(cpu_iface) : 0;
+	if ((res = mix_ops_init(&client->mix_ops)) < 0) {
+		pw_log_error("%p: can't init mix ops: %s", client, spa_strerror(res));
+		goto no_props;
+	}
+	pw_log_info("%p: using mix ops with cpu flags %08x", client, client->mix_ops.cpu_flags);
+#else
+	client->mix_function = mix_c;
 	if (cpu_iface) {
 #if defined (__SSE__)
 		uint32_t flags = spa_cpu_get_flags(cpu_iface);
 		if (flags & SPA_CPU_FLAG_SSE)
 			client->mix_function = mix_sse;
 #endif
+	}
+#endif
+	if (cpu_iface)
 		client->max_align = spa_cpu_get_max_align(cpu_iface);
-	} else {
+	else
 		client->max_align = MAX_ALIGN;
-	}
 	client->context.old_thread_utils =
 		pw_context_get_object(client->context.context,
 				SPA_TYPE_INTERFACE_ThreadUtils);
@@ -4460,6 +4791,7 @@ jack_client_t * jack_client_open (const char *client_name,
 	client->info.change_mask = 0;
 
 	client->dummy_port.type = INTERFACE_Port;
+	spa_list_init(&client->dummy_port.port.links);
 	snprintf(client->dummy_port.port.name, sizeof(client->dummy_port.port.name), "%s:dummy", client_name);
 	snprintf(client->dummy_port.port.alias1, sizeof(client->dummy_port.port.alias1), "%s:dummy", client_name);
 	snprintf(client->dummy_port.port.alias2, sizeof(client->dummy_port.port.alias2), "%s:dummy", client_name);
@@ -4683,6 +5015,9 @@ int jack_client_close (jack_client_t *client)
 	pw_map_clear(&c->ports[SPA_DIRECTION_INPUT]);
 	pw_map_clear(&c->ports[SPA_DIRECTION_OUTPUT]);
 
+	free(c->rt_ports);
+	rt_ports_reclaim(c, true);
+
 	pthread_mutex_destroy(&c->context.lock);
 	pthread_mutex_destroy(&c->rt_lock);
 	pw_properties_free(c->props);
@@ -5562,6 +5897,7 @@ jack_port_t * jack_port_register (jack_client_t *client,
 	o->port.flags = flags;
 	strcpy(o->port.name, name);
 	o->port.type_id = type_id;
+	port_names_changed(c, o);
 
 	init_buffer(p, c->max_frames);
 
@@ -5640,6 +5976,7 @@ jack_port_t * jack_port_register (jack_client_t *client,
 		pw_thread_loop_unlock(c->context.loop);
 		goto error_free;
 	}
+	rt_ports_update(c);
 
 	freeze_callbacks(c);
 
@@ -5669,7 +6006,10 @@ jack_port_t * jack_port_register (jack_client_t *client,
 	return object_to_port(o);
 
 error_free:
+	pw_thread_loop_lock(c->context.loop);
 	free_port(c, p, true);
+	rt_ports_update(c);
+	pw_thread_loop_unlock(c->context.loop);
 	return NULL;
 }
 
@@ -5680,6 +6020,7 @@ do_free_port(struct spa_loop *loop,
 	struct port *p = user_data;
 	struct client *c = p->client;
 	free_port(c, p, !c->active);
+	rt_ports_update(c);
 	return 0;
 }
 
@@ -5766,17 +6107,45 @@ static inline void *get_buffer_data(struct buffer *b, jack_nframes_t frames)
 	return SPA_PTROFF(d->data, offset, void);
 }
 
+/* The input buffer of a port does not change during a cycle, the snapshot of
+ * the mixes is fixed until the end of the cycle. Return the same buffer when
+ * it is asked for again instead of mixing again. */
+static inline void *get_cycle_buffer(struct port *p, jack_nframes_t frames)
+{
+	if (p->cycle_ptr != NULL && p->cycle_seq == p->client->rt.seq &&
+	    p->cycle_frames == frames)
+		return p->cycle_ptr;
+	return NULL;
+}
+
+static inline void *set_cycle_buffer(struct port *p, jack_nframes_t frames, void *ptr)
+{
+	if (p->client->rt.ports != NULL) {
+		p->cycle_ptr = ptr;
+		p->cycle_seq = p->client->rt.seq;
+		p->cycle_frames = frames;
+	}
+	return ptr;
+}
+
 static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 {
+	struct rt_port *rp = rt_port_get(p);
 	struct mix *mix;
 	struct buffer *b;
 	void *ptr = NULL;
 	float *mix_ptr[MAX_MIX], *np;
-	uint32_t n_ptr = 0;
+	uint32_t i, n_ptr = 0;
+#ifndef HAVE_MIX_OPS
 	bool ptr_aligned = true;
+#endif
 	struct client *c = p->client;
 
-	spa_list_for_each(mix, &p->mix, port_link) {
+	if ((ptr = get_cycle_buffer(p, frames)) != NULL)
+		return ptr;
+
+	for (i = 0; rp != NULL && i < rp->n_mix; i++) {
+		mix = rp->mix[i];
 		if (mix->id == SPA_ID_INVALID)
 			continue;
 
@@ -5789,42 +6158,51 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 		if ((np = get_buffer_data(b, frames)) == NULL)
 			continue;
 
+#ifndef HAVE_MIX_OPS
 		if (!SPA_IS_ALIGNED(np, 16))
 			ptr_aligned = false;
-
+#endif
 		mix_ptr[n_ptr++] = np;
 		if (n_ptr == MAX_MIX)
 			break;
 	}
 	if (n_ptr == 1) {
+		/* a single peer, use its buffer directly */
 		ptr = mix_ptr[0];
 	} else if (n_ptr > 1) {
 		ptr = p->emptyptr;
+#ifdef HAVE_MIX_OPS
+		mix_ops_process(&c->mix_ops, ptr, (const void **)mix_ptr, n_ptr, frames);
+#else
 		c->mix_function(ptr, mix_ptr, n_ptr, ptr_aligned, frames);
+#endif
 		p->zeroed = false;
 	}
 	if (ptr == NULL)
 		ptr = init_buffer(p, frames);
-	return ptr;
+	return set_cycle_buffer(p, frames, ptr);
 }
 
 static void *get_buffer_input_midi(struct port *p, jack_nframes_t frames)
 {
+	struct rt_port *rp = rt_port_get(p);
 	struct mix *mix;
 	void *ptr = p->emptyptr;
 	struct midi_buffer *mb = (struct midi_buffer*)midi_scratch;
 	struct mix_info *mix_info[MAX_MIX];
-	uint32_t n_mix_info = 0;
+	uint32_t i, n_mix_info = 0;
 
-	spa_list_for_each(mix, &p->mix, port_link) {
+	for (i = 0; rp != NULL && i < rp->n_mix; i++) {
 		struct spa_data *d;
 		struct buffer *b;
-		struct mix_info *mi = &mix->mix_info;
+		struct mix_info *mi;
 		struct spa_pod_sequence seq;
 		const void *seq_body;
 
+		mix = rp->mix[i];
 		if (mix->id == SPA_ID_INVALID)
 			continue;
+		mi = &mix->mix_info;
 
 		pw_log_trace_fp("%p: port %p mix %d.%d get buffer %d",
 				p->client, p, p->port_id, mix->id, frames);
@@ -6042,6 +6420,7 @@ int jack_port_connected (const jack_port_t *port)
 	struct object *o = port_to_object(port);
 	struct client *c;
 	struct object *l;
+	struct object_ref *r;
 	int res = 0;
 
 	return_val_if_fail(o != NULL, 0);
@@ -6051,8 +6430,9 @@ int jack_port_connected (const jack_port_t *port)
 	c = o->client;
 
 	pthread_mutex_lock(&c->context.lock);
-	spa_list_for_each(l, &c->context.objects, link) {
-		if (l->type != INTERFACE_Link || l->removed)
+	spa_list_for_each(r, &o->port.links, link) {
+		l = r->object;
+		if (l->removed)
 			continue;
 		if (l->port_link.src_serial == o->serial ||
 		    l->port_link.dst_serial == o->serial)
@@ -6125,6 +6505,7 @@ const char ** jack_port_get_all_connections (const jack_client_t *client,
 	struct client *c = (struct client *) client;
 	struct object *o = port_to_object(port);
 	struct object *p, *l;
+	struct object_ref *r;
 	const char **res;
 	int count = 0;
 	struct pw_array tmp;
@@ -6132,11 +6513,15 @@ const char ** jack_port_get_all_connections (const jack_client_t *client,
 	return_val_if_fail(c != NULL, NULL);
 	return_val_if_fail(o != NULL, NULL);
 
+	if (o->type != INTERFACE_Port)
+		return NULL;
+
 	pw_array_init(&tmp, sizeof(void*) * 32);
 
 	pthread_mutex_lock(&c->context.lock);
-	spa_list_for_each(l, &c->context.objects, link) {
-		if (l->type != INTERFACE_Link || l->removed)
+	spa_list_for_each(r, &o->port.links, link) {
+		l = r->object;
+		if (l->removed)
 			continue;
 		if (l->port_link.src_serial == o->serial)
 			p = find_type(c, l->port_link.dst, INTERFACE_Port, true);
@@ -6226,6 +6611,7 @@ int jack_port_rename (jack_client_t* client, jack_port_t *port, const char *port
 
 	pw_properties_set(p->props, PW_KEY_PORT_NAME, port_name);
 	snprintf(o->port.name, sizeof(o->port.name), "%s:%s", c->name, port_name);
+	port_names_changed(c, o);
 
 	p->info.change_mask |= SPA_PORT_CHANGE_MASK_PROPS;
 	p->info.props = &p->props->dict;
@@ -6280,6 +6666,7 @@ int jack_port_set_alias (jack_port_t *port, const char *alias)
 		res = -1;
 		goto done;
 	}
+	port_names_changed(c, o);
 
 	pw_properties_set(p->props, key, alias);
 
@@ -6614,18 +7001,21 @@ int jack_port_disconnect (jack_client_t *client, jack_port_t *port)
 	struct client *c = (struct client *) client;
 	struct object *o = port_to_object(port);
 	struct object *l;
+	struct object_ref *r;
 	int res;
 
 	return_val_if_fail(c != NULL, -EINVAL);
 	return_val_if_fail(o != NULL, -EINVAL);
+	return_val_if_fail(o->type == INTERFACE_Port, -EINVAL);
 
 	pw_log_debug("%p: disconnect %p", client, port);
 
 	pw_thread_loop_lock(c->context.loop);
 	freeze_callbacks(c);
 
-	spa_list_for_each(l, &c->context.objects, link) {
-		if (l->type != INTERFACE_Link || l->removed)
+	spa_list_for_each(r, &o->port.links, link) {
+		l = r->object;
+		if (l->removed)
 			continue;
 		if (l->port_link.src_serial == o->serial ||
 		    l->port_link.dst_serial == o->serial) {
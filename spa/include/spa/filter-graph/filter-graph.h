@@ -64,7 +64,7 @@ struct spa_filter_graph_events {
 };
 
 struct spa_filter_graph_methods {
-#define SPA_VERSION_FILTER_GRAPH_METHODS	0
+#define SPA_VERSION_FILTER_GRAPH_METHODS	1
 	uint32_t version;
 
 	int (*add_listener) (void *object,
@@ -83,6 +83,14 @@ struct spa_filter_graph_methods {
 	int (*reset) (void *object);
 
 	int (*process) (void *object, const void *in[], void *out[], uint32_t n_samples);
+
+	/**
+	 * Emit the info event with the current processing statistics
+	 * of the graph and start a new measurement period.
+	 *
+	 * Since version 1:1
+	 */
+	int (*update_info) (void *object);
 };
 
 SPA_API_FILTER_GRAPH int spa_filter_graph_add_listener(struct spa_filter_graph *object,
@@ -138,6 +146,12 @@ SPA_API_FILTER_GRAPH int spa_filter_graph_process(struct spa_filter_graph *objec
 			spa_filter_graph, &object->iface, process, 0, in, out, n_samples);
 }
 
+SPA_API_FILTER_GRAPH int spa_filter_graph_update_info(struct spa_filter_graph *object)
+{
+	return spa_api_method_r(int, -ENOTSUP,
+			spa_filter_graph, &object->iface, update_info, 1);
+}
+
 /**
  * \}
  */
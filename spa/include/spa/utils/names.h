@@ -39,6 +39,9 @@ extern "C" {
 									  *  and output buffer sizes. supported
 									  *  formats must include f32 and
 									  *  optionally f64 and s24_32 */
+#define SPA_NAME_AUDIO_MIXER_MINUS	"audio.mixer.minus"		/**< mixes mono audio on N input ports
+									  *  to N output ports, each output
+									  *  without the matching input */
 
 /** audio processing */
 #define SPA_NAME_AUDIO_PROCESS_FORMAT	"audio.process.format"		/**< processes raw audio from one format
@@ -11,6 +11,8 @@
 #include <errno.h>
 #include <time.h>
 
+#include <spa/param/audio/raw.h>
+
 #include "test-helper.h"
 #include "mix-ops.h"
 
@@ -27,7 +29,7 @@ struct stats {
 };
 
 #define MAX_SAMPLES	4096
-#define MAX_SRC		11
+#define MAX_SRC		512
 
 #define MAX_COUNT 100
 
@@ -37,12 +39,16 @@ static uint8_t samp_out[MAX_SAMPLES * 8];
 static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
 static const int src_counts[] = { 1, 2, 4, 6, 8, 11 };
 
+#define WIDE_SAMPLES	1024
+static const int wide_src_counts[] = { 8, 16, 32, 64, 128, 256, 512 };
+
 #define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(src_counts) * 70
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
 
-static void run_test1(const char *name, const char *impl, mix_func_t func, int n_src, int n_samples)
+static void run_test1(const char *name, const char *impl, mix_func_t func, int n_src, int n_samples,
+		uint32_t offset)
 {
 	int i, j;
 	const void *ip[n_src];
@@ -54,8 +60,8 @@ static void run_test1(const char *name, const char *impl, mix_func_t func, int n
 	mix.n_channels = 1;
 
 	for (j = 0; j < n_src; j++)
-		ip[j] = SPA_PTR_ALIGN(&samp_in[j * n_samples * 4], 32, void);
-	op = SPA_PTR_ALIGN(samp_out, 32, void);
+		ip[j] = SPA_PTROFF(SPA_PTR_ALIGN(&samp_in[j * n_samples * 4], 32, void), offset, void);
+	op = SPA_PTROFF(SPA_PTR_ALIGN(samp_out, 32, void), offset, void);
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
@@ -79,18 +85,77 @@ static void run_test1(const char *name, const char *impl, mix_func_t func, int n
 	};
 }
 
-static void run_test(const char *name, const char *impl, mix_func_t func)
+static void run_test_offset(const char *name, const char *impl, mix_func_t func, uint32_t offset)
 {
 	size_t i, j;
 
 	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
 		for (j = 0; j < SPA_N_ELEMENTS(src_counts); j++) {
 			run_test1(name, impl, func, src_counts[j],
-				(sample_sizes[i] + (src_counts[j] -1)) / src_counts[j]);
+				(sample_sizes[i] + (src_counts[j] -1)) / src_counts[j], offset);
 		}
 	}
 }
 
+static void run_test(const char *name, const char *impl, mix_func_t func)
+{
+	run_test_offset(name, impl, func, 0);
+}
+
+static void run_wide_test(const char *name, const char *impl, mix_func_t func)
+{
+	size_t j;
+
+	for (j = 0; j < SPA_N_ELEMENTS(wide_src_counts); j++)
+		run_test1(name, impl, func, wide_src_counts[j], WIDE_SAMPLES, 0);
+}
+
+static struct mix_ops wide_ops;
+
+/* goes through mix_ops, which mixes wide fan-in in tiles */
+static void mix_f32_tiled(struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t n_samples)
+{
+	mix_ops_process(&wide_ops, dst, src, n_src, n_samples);
+}
+
+#if defined (__SSE__)
+#include <xmmintrin.h>
+/* the mixer that pipewire-jack used before it switched to mix-ops, kept
+ * here to compare against */
+static void mix_f32_jack_sse(struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t n_samples)
+{
+	const float **s = (const float **)src;
+	float *d = dst;
+	uint32_t i, n, unrolled;
+	bool aligned = true;
+	__m128 in[1];
+
+	for (i = 0; i < n_src; i++)
+		if (!SPA_IS_ALIGNED(s[i], 16))
+			aligned = false;
+
+	if (SPA_IS_ALIGNED(d, 16) && aligned)
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for (n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_load_ps(&s[0][n]);
+		for (i = 1; i < n_src; i++)
+			in[0] = _mm_add_ps(in[0], _mm_load_ps(&s[i][n]));
+		_mm_store_ps(&d[n], in[0]);
+	}
+	for (; n < n_samples; n++) {
+		in[0] = _mm_load_ss(&s[0][n]);
+		for (i = 1; i < n_src; i++)
+			in[0] = _mm_add_ss(in[0], _mm_load_ss(&s[i][n]));
+		_mm_store_ss(&d[n], in[0]);
+	}
+}
+#endif
+
 static void test_s8(void)
 {
 	run_test("test_s8", "c", mix_s8_c);
@@ -138,18 +203,43 @@ static void test_u32(void)
 static void test_f32(void)
 {
 	run_test("test_f32", "c", mix_f32_c);
+	run_test_offset("test_f32_unaligned", "c", mix_f32_c, 4);
 #if defined (HAVE_SSE)
 	if (cpu_flags & SPA_CPU_FLAG_SSE) {
 		run_test("test_f32", "sse", mix_f32_sse);
+		run_test_offset("test_f32_unaligned", "sse", mix_f32_sse, 4);
 	}
 #endif
+#if defined (__SSE__)
+	run_test("test_f32", "jack-sse", mix_f32_jack_sse);
+	run_test_offset("test_f32_unaligned", "jack-sse", mix_f32_jack_sse, 4);
+#endif
 #if defined (HAVE_AVX2)
 	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
 		run_test("test_f32", "avx2", mix_f32_avx2);
+		run_test_offset("test_f32_unaligned", "avx2", mix_f32_avx2, 4);
 	}
 #endif
 }
 
+static void test_f32_wide(void)
+{
+	run_wide_test("test_f32_wide", "c", mix_f32_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_wide_test("test_f32_wide", "sse", mix_f32_sse);
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2)
+		run_wide_test("test_f32_wide", "avx2", mix_f32_avx2);
+#endif
+	wide_ops.fmt = SPA_AUDIO_FORMAT_F32;
+	wide_ops.n_channels = 1;
+	wide_ops.cpu_flags = cpu_flags;
+	if (mix_ops_init(&wide_ops) >= 0)
+		run_wide_test("test_f32_wide", "tiled", mix_f32_tiled);
+}
+
 static void test_f64(void)
 {
 	run_test("test_f64", "c", mix_f64_c);
@@ -189,6 +279,7 @@ int main(int argc, char *argv[])
 	test_s24_32();
 	test_u24_32();
 	test_f32();
+	test_f32_wide();
 	test_f64();
 
 	qsort(results, n_results, sizeof(struct stats), compare_func);
@@ -0,0 +1,1028 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/log.h>
+#include <spa/support/loop.h>
+#include <spa/utils/list.h>
+#include <spa/utils/names.h>
+#include <spa/utils/string.h>
+#include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/node/io.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/param.h>
+#include <spa/pod/filter.h>
+
+#undef SPA_LOG_TOPIC_DEFAULT
+#define SPA_LOG_TOPIC_DEFAULT &log_topic
+SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.mix-minus");
+
+/* Mix-minus (N-1) bus. Input port N is paired with output port N. Each
+ * output gets the sum of all inputs except the one with the same id.
+ *
+ * The sum of all inputs is made once, the mix-minus for a port is then
+ * the sum minus its own input. That makes the bus O(N) instead of the
+ * O(N²) of N mixers with N-1 inputs each. The sum is kept in double
+ * precision so that the subtraction does not leave the rounding error
+ * of a loud input on the outputs of the quiet ones. The channelVolumes
+ * property has the gain of each input in the bus. */
+
+#define MAX_BUFFERS	64
+#define MAX_PORTS	256
+
+#define DEFAULT_PORTS		2
+#define DEFAULT_QUANTUM_LIMIT	8192u
+#define DEFAULT_VOLUME		1.0f
+#define DEFAULT_MUTE		false
+
+struct props {
+	float volumes[MAX_PORTS];
+	bool mute;
+};
+
+static void reset_props(struct props *props)
+{
+	uint32_t i;
+	for (i = 0; i < MAX_PORTS; i++)
+		props->volumes[i] = DEFAULT_VOLUME;
+	props->mute = DEFAULT_MUTE;
+}
+
+struct buffer {
+	uint32_t id;
+#define BUFFER_FLAG_QUEUED	(1 << 0)
+#define BUFFER_FLAG_MAPPED	(1 << 1)
+	uint32_t flags;
+
+	struct spa_list link;
+	struct spa_buffer *buffer;
+	void *data;
+};
+
+struct port {
+	uint32_t direction;
+	uint32_t id;
+
+	struct spa_io_buffers *io[2];
+
+	uint64_t info_all;
+	struct spa_port_info info;
+	struct spa_param_info params[5];
+
+	unsigned int have_format:1;
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+
+	struct spa_list queue;
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct spa_log *log;
+	struct spa_loop *data_loop;
+
+	uint32_t quantum_limit;
+	uint32_t n_ports;
+
+	struct props props;
+
+	uint64_t info_all;
+	struct spa_node_info info;
+	struct spa_param_info params[2];
+
+	struct spa_io_position *position;
+
+	struct spa_hook_list hooks;
+
+	struct port *in_ports[MAX_PORTS];
+	struct port *out_ports[MAX_PORTS];
+
+	const float *datas[MAX_PORTS];
+	double *sum;
+
+	unsigned int started:1;
+};
+
+#define CHECK_PORT(this,d,p)	((p) < this->n_ports)
+#define GET_IN_PORT(this,p)	(this->in_ports[p])
+#define GET_OUT_PORT(this,p)	(this->out_ports[p])
+#define GET_PORT(this,d,p)	(d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+
+static void emit_node_info(struct impl *this, bool full)
+{
+	uint64_t old = full ? this->info.change_mask : 0;
+	if (full)
+		this->info.change_mask = this->info_all;
+	if (this->info.change_mask) {
+		spa_node_emit_info(&this->hooks, &this->info);
+		this->info.change_mask = old;
+	}
+}
+
+static int impl_node_enum_params(void *object, int seq,
+				 uint32_t id, uint32_t start, uint32_t num,
+				 const struct spa_pod *filter)
+{
+	struct impl *this = object;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[4096];
+	struct spa_pod *param;
+	struct props *p;
+	struct spa_result_node_params result;
+	uint32_t count = 0;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	p = &this->props;
+
+	result.id = id;
+	result.next = start;
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_PropInfo:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_id,   SPA_POD_Id(SPA_PROP_channelVolumes),
+				SPA_PROP_INFO_description, SPA_POD_String("Input Volumes"),
+				SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Float(DEFAULT_VOLUME, 0.0, 10.0),
+				SPA_PROP_INFO_container, SPA_POD_Id(SPA_TYPE_Array));
+			break;
+		case 1:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_id,   SPA_POD_Id(SPA_PROP_mute),
+				SPA_PROP_INFO_description, SPA_POD_String("Mute"),
+				SPA_PROP_INFO_type, SPA_POD_Bool(p->mute));
+			break;
+		default:
+			return 0;
+		}
+		break;
+	case SPA_PARAM_Props:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_Props, id,
+				SPA_PROP_channelVolumes, SPA_POD_Array(sizeof(float),
+								SPA_TYPE_Float,
+								this->n_ports,
+								p->volumes),
+				SPA_PROP_mute,   SPA_POD_Bool(p->mute));
+			break;
+		default:
+			return 0;
+		}
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	struct impl *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	switch (id) {
+	case SPA_PARAM_Props:
+	{
+		struct props *p = &this->props;
+		struct spa_pod_object *obj = (struct spa_pod_object *) param;
+		struct spa_pod_prop *prop;
+
+		if (param == NULL) {
+			reset_props(p);
+		} else {
+			SPA_POD_OBJECT_FOREACH(obj, prop) {
+				switch (prop->key) {
+				case SPA_PROP_channelVolumes:
+					spa_pod_copy_array(&prop->value, SPA_TYPE_Float,
+							p->volumes, this->n_ports);
+					break;
+				case SPA_PROP_mute:
+					spa_pod_get_bool(&prop->value, &p->mute);
+					break;
+				}
+			}
+		}
+		this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+		this->params[1].user++;
+		emit_node_info(this, false);
+		break;
+	}
+	default:
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
+{
+	struct impl *this = object;
+
+	switch (id) {
+	case SPA_IO_Position:
+		this->position = data;
+		break;
+	default:
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+static int impl_node_send_command(void *object, const struct spa_command *command)
+{
+	struct impl *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	switch (SPA_NODE_COMMAND_ID(command)) {
+	case SPA_NODE_COMMAND_Start:
+		this->started = true;
+		break;
+	case SPA_NODE_COMMAND_Pause:
+		this->started = false;
+		break;
+	default:
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+static void emit_port_info(struct impl *this, struct port *port, bool full)
+{
+	uint64_t old = full ? port->info.change_mask : 0;
+	if (full)
+		port->info.change_mask = port->info_all;
+	if (port->info.change_mask) {
+		spa_node_emit_port_info(&this->hooks,
+				port->direction, port->id, &port->info);
+		port->info.change_mask = old;
+	}
+}
+
+static int impl_node_add_listener(void *object,
+		struct spa_hook *listener,
+		const struct spa_node_events *events,
+		void *data)
+{
+	struct impl *this = object;
+	struct spa_hook_list save;
+	uint32_t i;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	spa_hook_list_isolate(&this->hooks, &save, listener, events, data);
+
+	emit_node_info(this, true);
+	for (i = 0; i < this->n_ports; i++) {
+		emit_port_info(this, GET_IN_PORT(this, i), true);
+		emit_port_info(this, GET_OUT_PORT(this, i), true);
+	}
+
+	spa_hook_list_join(&this->hooks, &save);
+
+	return 0;
+}
+
+static int
+impl_node_set_callbacks(void *object,
+			const struct spa_node_callbacks *callbacks,
+			void *user_data)
+{
+	return 0;
+}
+
+static int impl_node_add_port(void *object, enum spa_direction direction, uint32_t port_id,
+		const struct spa_dict *props)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_remove_port(void *object, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_enum_params(void *object, int seq,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t id, uint32_t start, uint32_t num,
+			   const struct spa_pod *filter)
+{
+	struct impl *this = object;
+	struct port *port;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	result.id = id;
+	result.next = start;
+next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_EnumFormat:
+		if (result.index > 0)
+			return 0;
+
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+			SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+			SPA_FORMAT_mediaSubtype,   SPA_POD_Id(SPA_MEDIA_SUBTYPE_dsp),
+			SPA_FORMAT_AUDIO_format,   SPA_POD_Id(SPA_AUDIO_FORMAT_DSP_F32));
+		break;
+
+	case SPA_PARAM_Format:
+		if (!port->have_format)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Format, SPA_PARAM_Format,
+			SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+			SPA_FORMAT_mediaSubtype,   SPA_POD_Id(SPA_MEDIA_SUBTYPE_dsp),
+			SPA_FORMAT_AUDIO_format,   SPA_POD_Id(SPA_AUDIO_FORMAT_DSP_F32));
+		break;
+
+	case SPA_PARAM_Buffers:
+		if (!port->have_format)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamBuffers, id,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(1, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_CHOICE_RANGE_Int(
+								this->quantum_limit * sizeof(float),
+								16 * sizeof(float),
+								INT32_MAX),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(sizeof(float)));
+		break;
+
+	case SPA_PARAM_Meta:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamMeta, id,
+				SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+				SPA_PARAM_META_size, SPA_POD_Int(sizeof(struct spa_meta_header)));
+			break;
+		default:
+			return 0;
+		}
+		break;
+
+	case SPA_PARAM_IO:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamIO, id,
+				SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_Buffers),
+				SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+			break;
+		case 1:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamIO, id,
+				SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_AsyncBuffers),
+				SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_async_buffers)));
+			break;
+		default:
+			return 0;
+		}
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	uint32_t i;
+
+	spa_log_debug(this->log, "%p: clear buffers %p %d", this, port, port->n_buffers);
+	for (i = 0; i < port->n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+		if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_MAPPED)) {
+			munmap(b->data, b->buffer->datas[0].maxsize);
+			b->data = NULL;
+			SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_MAPPED);
+		}
+	}
+	port->n_buffers = 0;
+	spa_list_init(&port->queue);
+	return 0;
+}
+
+static int queue_buffer(struct impl *this, struct port *port, struct buffer *b)
+{
+	if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_QUEUED))
+		return -EINVAL;
+
+	spa_list_append(&port->queue, &b->link);
+	SPA_FLAG_SET(b->flags, BUFFER_FLAG_QUEUED);
+	spa_log_trace_fp(this->log, "%p: queue buffer %d", this, b->id);
+	return 0;
+}
+
+static struct buffer *dequeue_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->queue))
+		return NULL;
+
+	b = spa_list_first(&port->queue, struct buffer, link);
+	spa_list_remove(&b->link);
+	SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_QUEUED);
+	spa_log_trace_fp(this->log, "%p: dequeue buffer %d", this, b->id);
+	return b;
+}
+
+static int port_set_format(struct impl *this,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   uint32_t flags,
+			   const struct spa_pod *format)
+{
+	struct port *port;
+	int res;
+
+	port = GET_PORT(this, direction, port_id);
+
+	spa_log_debug(this->log, "%p: port %d:%d set format", this, direction, port_id);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+	} else {
+		struct spa_audio_info info = { 0 };
+
+		if ((res = spa_format_parse(format, &info.media_type, &info.media_subtype)) < 0)
+			return res;
+
+		if (info.media_type != SPA_MEDIA_TYPE_audio ||
+		    info.media_subtype != SPA_MEDIA_SUBTYPE_dsp)
+			return -EINVAL;
+
+		if (spa_format_audio_dsp_parse(format, &info.info.dsp) < 0)
+			return -EINVAL;
+
+		if (info.info.dsp.format != SPA_AUDIO_FORMAT_DSP_F32)
+			return -EINVAL;
+
+		port->have_format = true;
+	}
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	if (port->have_format) {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
+	} else {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	}
+	emit_port_info(this, port, false);
+
+	return 0;
+}
+
+static int
+impl_node_port_set_param(void *object,
+			 enum spa_direction direction, uint32_t port_id,
+			 uint32_t id, uint32_t flags,
+			 const struct spa_pod *param)
+{
+	struct impl *this = object;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	switch (id) {
+	case SPA_PARAM_Format:
+		return port_set_format(this, direction, port_id, flags, param);
+	default:
+		return -ENOENT;
+	}
+}
+
+static int
+impl_node_port_use_buffers(void *object,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   uint32_t flags,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this = object;
+	struct port *port;
+	uint32_t i;
+	int res;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	spa_log_debug(this->log, "%p: use %d buffers on port %d:%d",
+			this, n_buffers, direction, port_id);
+
+	spa_return_val_if_fail(!this->started || port->io[0] == NULL, -EIO);
+
+	clear_buffers(this, port);
+
+	if (n_buffers > 0 && !port->have_format)
+		return -EIO;
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+		struct spa_data *d = buffers[i]->datas;
+		void *data;
+
+		if (buffers[i]->n_datas < 1) {
+			spa_log_error(this->log, "%p: invalid blocks %d on buffer %d",
+					this, buffers[i]->n_datas, i);
+			res = -EINVAL;
+			goto error;
+		}
+
+		b->buffer = buffers[i];
+		b->flags = 0;
+		b->id = i;
+
+		data = d[0].data;
+		if (data == NULL && SPA_FLAG_IS_SET(d[0].flags, SPA_DATA_FLAG_MAPPABLE)) {
+			int prot = 0;
+			if (SPA_FLAG_IS_SET(d[0].flags, SPA_DATA_FLAG_READABLE))
+				prot |= PROT_READ;
+			if (SPA_FLAG_IS_SET(d[0].flags, SPA_DATA_FLAG_WRITABLE))
+				prot |= PROT_WRITE;
+			data = mmap(NULL, d[0].maxsize,
+				prot, MAP_SHARED, d[0].fd, d[0].mapoffset);
+			if (data == MAP_FAILED) {
+				spa_log_error(this->log, "%p: mmap failed on buffer %d %d: %m",
+						this, i, d[0].type);
+				res = -EINVAL;
+				goto error;
+			}
+			SPA_FLAG_SET(b->flags, BUFFER_FLAG_MAPPED);
+		}
+		if (data == NULL) {
+			spa_log_error(this->log, "%p: invalid memory on buffer %d %d",
+					this, i, d[0].type);
+			res = -EINVAL;
+			goto error;
+		}
+		b->data = data;
+
+		if (direction == SPA_DIRECTION_OUTPUT)
+			queue_buffer(this, port, b);
+
+		port->n_buffers++;
+	}
+	return 0;
+error:
+	clear_buffers(this, port);
+	return res;
+}
+
+struct io_info {
+	struct port *port;
+	void *data;
+	size_t size;
+};
+
+static int do_port_set_io(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct io_info *info = user_data;
+	struct port *port = info->port;
+
+	if (info->data == NULL || info->size < sizeof(struct spa_io_buffers)) {
+		port->io[0] = NULL;
+		port->io[1] = NULL;
+	} else if (info->size >= sizeof(struct spa_io_async_buffers)) {
+		struct spa_io_async_buffers *ab = info->data;
+		port->io[0] = &ab->buffers[port->direction];
+		port->io[1] = &ab->buffers[port->direction^1];
+	} else {
+		port->io[0] = info->data;
+		port->io[1] = info->data;
+	}
+	return 0;
+}
+
+static int
+impl_node_port_set_io(void *object,
+		      enum spa_direction direction, uint32_t port_id,
+		      uint32_t id, void *data, size_t size)
+{
+	struct impl *this = object;
+	struct io_info info;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	spa_log_debug(this->log, "%p: port %d:%d io %d %p/%zd", this,
+			direction, port_id, id, data, size);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	info.port = GET_PORT(this, direction, port_id);
+	info.data = data;
+	info.size = size;
+
+	switch (id) {
+	case SPA_IO_Buffers:
+	case SPA_IO_AsyncBuffers:
+		spa_loop_locked(this->data_loop,
+				do_port_set_io, SPA_ID_INVALID, NULL, 0, &info);
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
+}
+
+static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this = object;
+	struct port *port;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id), -EINVAL);
+
+	port = GET_OUT_PORT(this, port_id);
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	return queue_buffer(this, port, &port->buffers[buffer_id]);
+}
+
+static int impl_node_process(void *object)
+{
+	struct impl *this = object;
+	uint32_t i, n, n_samples, cycle, n_active = 0;
+	const float **datas = this->datas;
+	double *sum = this->sum;
+	float gain;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	if (SPA_UNLIKELY(this->position == NULL))
+		return -EIO;
+
+	cycle = this->position->clock.cycle & 1;
+	n_samples = SPA_MIN(this->position->clock.duration, this->quantum_limit);
+
+	for (i = 0; i < this->n_ports; i++) {
+		struct port *inport = GET_IN_PORT(this, i);
+		struct spa_io_buffers *inio = inport->io[cycle];
+		struct buffer *inb;
+		struct spa_data *bd;
+		uint32_t size, offs;
+
+		datas[i] = NULL;
+
+		if (inio == NULL ||
+		    inio->buffer_id >= inport->n_buffers ||
+		    inio->status != SPA_STATUS_HAVE_DATA)
+			continue;
+
+		inb = &inport->buffers[inio->buffer_id];
+		bd = &inb->buffer->datas[0];
+		inio->status = SPA_STATUS_NEED_DATA;
+
+		if (SPA_FLAG_IS_SET(bd->chunk->flags, SPA_CHUNK_FLAG_EMPTY))
+			continue;
+
+		offs = SPA_MIN(bd->chunk->offset, bd->maxsize);
+		size = SPA_MIN(bd->maxsize - offs, bd->chunk->size);
+		n_samples = SPA_MIN(n_samples, size / sizeof(float));
+
+		datas[i] = SPA_PTROFF(inb->data, offs, const float);
+		n_active++;
+	}
+
+	spa_log_trace_fp(this->log, "%p: %d active inputs, %d samples",
+			this, n_active, n_samples);
+
+	memset(sum, 0, n_samples * sizeof(double));
+	for (i = 0; i < this->n_ports; i++) {
+		const float *s = datas[i];
+		if (s == NULL)
+			continue;
+		gain = this->props.mute ? 0.0f : this->props.volumes[i];
+		for (n = 0; n < n_samples; n++)
+			sum[n] += (double)gain * s[n];
+	}
+
+	for (i = 0; i < this->n_ports; i++) {
+		struct port *outport = GET_OUT_PORT(this, i);
+		struct spa_io_buffers *outio = outport->io[cycle];
+		const float *s = datas[i];
+		struct buffer *outb;
+		struct spa_data *d;
+		uint32_t maxsamples;
+		float *dst;
+
+		if (outio == NULL || outio->status == SPA_STATUS_HAVE_DATA)
+			continue;
+
+		/* recycle */
+		if (SPA_LIKELY(outio->buffer_id < outport->n_buffers)) {
+			queue_buffer(this, outport, &outport->buffers[outio->buffer_id]);
+			outio->buffer_id = SPA_ID_INVALID;
+		}
+		if (SPA_UNLIKELY((outb = dequeue_buffer(this, outport)) == NULL)) {
+			if (outport->n_buffers > 0)
+				spa_log_warn(this->log, "%p: out of buffers on port %d (%d)",
+						this, i, outport->n_buffers);
+			continue;
+		}
+
+		d = &outb->buffer->datas[0];
+		dst = outb->data;
+		maxsamples = SPA_MIN(n_samples, d[0].maxsize / sizeof(float));
+
+		if (s == NULL) {
+			for (n = 0; n < maxsamples; n++)
+				dst[n] = (float)sum[n];
+		} else {
+			/* remove the input of the port from the sum */
+			gain = this->props.mute ? 0.0f : this->props.volumes[i];
+			for (n = 0; n < maxsamples; n++)
+				dst[n] = (float)(sum[n] - (double)gain * s[n]);
+		}
+
+		d[0].chunk->offset = 0;
+		d[0].chunk->size = maxsamples * sizeof(float);
+		d[0].chunk->stride = sizeof(float);
+		SPA_FLAG_UPDATE(d[0].chunk->flags, SPA_CHUNK_FLAG_EMPTY,
+				n_active == 0 || (n_active == 1 && s != NULL));
+
+		outio->buffer_id = outb->id;
+		outio->status = SPA_STATUS_HAVE_DATA;
+	}
+	return SPA_STATUS_HAVE_DATA | SPA_STATUS_NEED_DATA;
+}
+
+static const struct spa_node_methods impl_node = {
+	SPA_VERSION_NODE_METHODS,
+	.add_listener = impl_node_add_listener,
+	.set_callbacks = impl_node_set_callbacks,
+	.enum_params = impl_node_enum_params,
+	.set_param = impl_node_set_param,
+	.set_io = impl_node_set_io,
+	.send_command = impl_node_send_command,
+	.add_port = impl_node_add_port,
+	.remove_port = impl_node_remove_port,
+	.port_enum_params = impl_node_port_enum_params,
+	.port_set_param = impl_node_port_set_param,
+	.port_use_buffers = impl_node_port_use_buffers,
+	.port_set_io = impl_node_port_set_io,
+	.port_reuse_buffer = impl_node_port_reuse_buffer,
+	.process = impl_node_process,
+};
+
+static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (spa_streq(type, SPA_TYPE_INTERFACE_Node))
+		*interface = &this->node;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < this->n_ports; i++) {
+		if (this->in_ports[i])
+			clear_buffers(this, this->in_ports[i]);
+		if (this->out_ports[i])
+			clear_buffers(this, this->out_ports[i]);
+		free(this->in_ports[i]);
+		free(this->out_ports[i]);
+	}
+	free(this->sum);
+	return 0;
+}
+
+static size_t
+impl_get_size(const struct spa_handle_factory *factory,
+	      const struct spa_dict *params)
+{
+	return sizeof(struct impl);
+}
+
+static struct port *make_port(struct impl *this, enum spa_direction direction, uint32_t id)
+{
+	struct port *port;
+
+	if ((port = calloc(1, sizeof(struct port))) == NULL)
+		return NULL;
+
+	port->direction = direction;
+	port->id = id;
+	spa_list_init(&port->queue);
+
+	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
+			SPA_PORT_CHANGE_MASK_PARAMS;
+	port->info = SPA_PORT_INFO_INIT();
+	port->info.flags = direction == SPA_DIRECTION_INPUT ? SPA_PORT_FLAG_NO_REF : 0;
+	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Meta, SPA_PARAM_INFO_READ);
+	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->info.params = port->params;
+	port->info.n_params = 5;
+
+	return port;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+	int res;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	spa_log_topic_init(this->log, &log_topic);
+
+	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
+	if (this->data_loop == NULL) {
+		spa_log_error(this->log, "a data loop is needed");
+		return -EINVAL;
+	}
+
+	this->quantum_limit = DEFAULT_QUANTUM_LIMIT;
+	this->n_ports = DEFAULT_PORTS;
+	reset_props(&this->props);
+
+	for (i = 0; info && i < info->n_items; i++) {
+		const char *k = info->items[i].key;
+		const char *s = info->items[i].value;
+		if (spa_streq(k, "clock.quantum-limit"))
+			spa_atou32(s, &this->quantum_limit, 0);
+		else if (spa_streq(k, "mix-minus.ports"))
+			spa_atou32(s, &this->n_ports, 0);
+	}
+	if (this->n_ports == 0 || this->n_ports > MAX_PORTS) {
+		spa_log_error(this->log, "%p: invalid number of ports %u (max %u)",
+				this, this->n_ports, MAX_PORTS);
+		return -EINVAL;
+	}
+
+	if ((this->sum = calloc(this->quantum_limit, sizeof(double))) == NULL)
+		return -errno;
+
+	for (i = 0; i < this->n_ports; i++) {
+		if ((this->in_ports[i] = make_port(this, SPA_DIRECTION_INPUT, i)) == NULL ||
+		    (this->out_ports[i] = make_port(this, SPA_DIRECTION_OUTPUT, i)) == NULL) {
+			res = -errno;
+			this->n_ports = i + 1;
+			impl_clear(handle);
+			return res;
+		}
+	}
+
+	spa_hook_list_init(&this->hooks);
+
+	this->node.iface = SPA_INTERFACE_INIT(
+			SPA_TYPE_INTERFACE_Node,
+			SPA_VERSION_NODE,
+			&impl_node, this);
+	this->info = SPA_NODE_INFO_INIT();
+	this->info.max_input_ports = this->n_ports;
+	this->info.max_output_ports = this->n_ports;
+	this->info.change_mask |= SPA_NODE_CHANGE_MASK_FLAGS |
+			SPA_NODE_CHANGE_MASK_PARAMS;
+	this->info.flags = SPA_NODE_FLAG_RT;
+	this->params[0] = SPA_PARAM_INFO(SPA_PARAM_PropInfo, SPA_PARAM_INFO_READ);
+	this->params[1] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
+	this->info.params = this->params;
+	this->info.n_params = 2;
+	this->info_all = this->info.change_mask;
+
+	spa_log_debug(this->log, "%p: mix-minus with %u ports", this, this->n_ports);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE_INTERFACE_Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+const struct spa_handle_factory spa_mix_minus_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	SPA_NAME_AUDIO_MIXER_MINUS,
+	NULL,
+	impl_get_size,
+	impl_init,
+	impl_enum_interface_info,
+};
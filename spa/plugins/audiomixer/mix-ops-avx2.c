@@ -19,7 +19,7 @@ mix_f32_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_REST
 	n_samples *= ops->n_channels;
 
 	if (n_src == 0)
-		memset(dst, 0, n_samples * ops->n_channels * sizeof(float));
+		memset(dst, 0, n_samples * sizeof(float));
 	else if (n_src == 1) {
 		if (dst != src[0])
 			spa_memcpy(dst, src[0], n_samples * sizeof(float));
@@ -27,35 +27,48 @@ mix_f32_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_REST
 		uint32_t i, n, unrolled;
 		const float **s = (const float **)src;
 		float *d = dst;
+		bool aligned = SPA_IS_ALIGNED(dst, 32);
+		__m256 in[4];
 
-		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 32))) {
-			unrolled = n_samples & ~31;
-			for (i = 0; i < n_src; i++) {
-				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 32))) {
-					unrolled = 0;
-					break;
-				}
-			}
-		} else
-			unrolled = 0;
+		for (i = 0; i < n_src && aligned; i++)
+			aligned = SPA_IS_ALIGNED(src[i], 32);
 
-		for (n = 0; n < unrolled; n += 32) {
-			__m256 in[4];
+		unrolled = n_samples & ~31;
 
-			in[0] = _mm256_load_ps(&s[0][n +  0]);
-			in[1] = _mm256_load_ps(&s[0][n +  8]);
-			in[2] = _mm256_load_ps(&s[0][n + 16]);
-			in[3] = _mm256_load_ps(&s[0][n + 24]);
-			for (i = 1; i < n_src; i++) {
-				in[0] = _mm256_add_ps(in[0], _mm256_load_ps(&s[i][n +  0]));
-				in[1] = _mm256_add_ps(in[1], _mm256_load_ps(&s[i][n +  8]));
-				in[2] = _mm256_add_ps(in[2], _mm256_load_ps(&s[i][n + 16]));
-				in[3] = _mm256_add_ps(in[3], _mm256_load_ps(&s[i][n + 24]));
+		if (SPA_LIKELY(aligned)) {
+			for (n = 0; n < unrolled; n += 32) {
+				in[0] = _mm256_load_ps(&s[0][n +  0]);
+				in[1] = _mm256_load_ps(&s[0][n +  8]);
+				in[2] = _mm256_load_ps(&s[0][n + 16]);
+				in[3] = _mm256_load_ps(&s[0][n + 24]);
+				for (i = 1; i < n_src; i++) {
+					in[0] = _mm256_add_ps(in[0], _mm256_load_ps(&s[i][n +  0]));
+					in[1] = _mm256_add_ps(in[1], _mm256_load_ps(&s[i][n +  8]));
+					in[2] = _mm256_add_ps(in[2], _mm256_load_ps(&s[i][n + 16]));
+					in[3] = _mm256_add_ps(in[3], _mm256_load_ps(&s[i][n + 24]));
+				}
+				_mm256_store_ps(&d[n +  0], in[0]);
+				_mm256_store_ps(&d[n +  8], in[1]);
+				_mm256_store_ps(&d[n + 16], in[2]);
+				_mm256_store_ps(&d[n + 24], in[3]);
+			}
+		} else {
+			for (n = 0; n < unrolled; n += 32) {
+				in[0] = _mm256_loadu_ps(&s[0][n +  0]);
+				in[1] = _mm256_loadu_ps(&s[0][n +  8]);
+				in[2] = _mm256_loadu_ps(&s[0][n + 16]);
+				in[3] = _mm256_loadu_ps(&s[0][n + 24]);
+				for (i = 1; i < n_src; i++) {
+					in[0] = _mm256_add_ps(in[0], _mm256_loadu_ps(&s[i][n +  0]));
+					in[1] = _mm256_add_ps(in[1], _mm256_loadu_ps(&s[i][n +  8]));
+					in[2] = _mm256_add_ps(in[2], _mm256_loadu_ps(&s[i][n + 16]));
+					in[3] = _mm256_add_ps(in[3], _mm256_loadu_ps(&s[i][n + 24]));
+				}
+				_mm256_storeu_ps(&d[n +  0], in[0]);
+				_mm256_storeu_ps(&d[n +  8], in[1]);
+				_mm256_storeu_ps(&d[n + 16], in[2]);
+				_mm256_storeu_ps(&d[n + 24], in[3]);
 			}
-			_mm256_store_ps(&d[n +  0], in[0]);
-			_mm256_store_ps(&d[n +  8], in[1]);
-			_mm256_store_ps(&d[n + 16], in[2]);
-			_mm256_store_ps(&d[n + 24], in[3]);
 		}
 		for (; n < n_samples; n++) {
 			__m128 in[1];
@@ -66,3 +79,67 @@ mix_f32_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_REST
 		}
 	}
 }
+
+void
+mix_f32_gain_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		const struct mix_gain gain[], uint32_t n_src, uint32_t n_samples)
+{
+	const float **s = (const float **)src;
+	float *d = dst, inv;
+	uint32_t i, n, unrolled;
+	const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	__m256 in[4], g[4], t[4], gs, gd;
+
+	if (n_src == 0 || n_samples == 0) {
+		memset(dst, 0, n_samples * ops->n_channels * sizeof(float));
+		return;
+	}
+	if (ops->n_channels != 1) {
+		/* ramps are per frame, only constant gains can be applied
+		 * to the interleaved samples directly */
+		for (i = 0; i < n_src; i++) {
+			if (gain[i].start != gain[i].end) {
+				mix_f32_gain_c(ops, dst, src, gain, n_src, n_samples);
+				return;
+			}
+		}
+		n_samples *= ops->n_channels;
+	}
+	inv = 1.0f / n_samples;
+	unrolled = n_samples & ~31;
+
+	for (n = 0; n < unrolled; n += 32) {
+		t[0] = _mm256_add_ps(_mm256_set1_ps((float)(n +  0)), lanes);
+		t[1] = _mm256_add_ps(_mm256_set1_ps((float)(n +  8)), lanes);
+		t[2] = _mm256_add_ps(_mm256_set1_ps((float)(n + 16)), lanes);
+		t[3] = _mm256_add_ps(_mm256_set1_ps((float)(n + 24)), lanes);
+		in[0] = in[1] = in[2] = in[3] = _mm256_setzero_ps();
+
+		for (i = 0; i < n_src; i++) {
+			gs = _mm256_set1_ps(gain[i].start);
+			if (gain[i].start == gain[i].end) {
+				g[0] = g[1] = g[2] = g[3] = gs;
+			} else {
+				gd = _mm256_set1_ps((gain[i].end - gain[i].start) * inv);
+				g[0] = _mm256_fmadd_ps(t[0], gd, gs);
+				g[1] = _mm256_fmadd_ps(t[1], gd, gs);
+				g[2] = _mm256_fmadd_ps(t[2], gd, gs);
+				g[3] = _mm256_fmadd_ps(t[3], gd, gs);
+			}
+			in[0] = _mm256_fmadd_ps(_mm256_loadu_ps(&s[i][n +  0]), g[0], in[0]);
+			in[1] = _mm256_fmadd_ps(_mm256_loadu_ps(&s[i][n +  8]), g[1], in[1]);
+			in[2] = _mm256_fmadd_ps(_mm256_loadu_ps(&s[i][n + 16]), g[2], in[2]);
+			in[3] = _mm256_fmadd_ps(_mm256_loadu_ps(&s[i][n + 24]), g[3], in[3]);
+		}
+		_mm256_storeu_ps(&d[n +  0], in[0]);
+		_mm256_storeu_ps(&d[n +  8], in[1]);
+		_mm256_storeu_ps(&d[n + 16], in[2]);
+		_mm256_storeu_ps(&d[n + 24], in[3]);
+	}
+	for (; n < n_samples; n++) {
+		float ac = 0.0f;
+		for (i = 0; i < n_src; i++)
+			ac += s[i][n] * (gain[i].start + n * ((gain[i].end - gain[i].start) * inv));
+		d[n] = ac;
+	}
+}
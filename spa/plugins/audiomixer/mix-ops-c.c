@@ -46,3 +46,30 @@ MAKE_FUNC(s24_32, int32_t, int32_t, S24_32_ACCUM, S24_32_CLAMP, true);
 MAKE_FUNC(u24_32, uint32_t, int32_t, U24_32_ACCUM, U24_32_CLAMP, false);
 MAKE_FUNC(f32, float, float, F32_ACCUM, F32_CLAMP, true);
 MAKE_FUNC(f64, double, double, F64_ACCUM, F64_CLAMP, true);
+
+void mix_f32_gain_c(struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], const struct mix_gain gain[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i, n, c, n_channels = ops->n_channels;
+	const float **s = (const float **)src;
+	float *d = dst, inv;
+
+	if (n_src == 0 || n_samples == 0) {
+		memset(dst, 0, n_samples * n_channels * sizeof(float));
+		return;
+	}
+	inv = 1.0f / n_samples;
+
+	for (n = 0; n < n_samples; n++) {
+		for (c = 0; c < n_channels; c++) {
+			uint32_t idx = n * n_channels + c;
+			float ac = 0.0f;
+			for (i = 0; i < n_src; i++) {
+				float g = gain[i].start + n * ((gain[i].end - gain[i].start) * inv);
+				ac += s[i][idx] * g;
+			}
+			d[idx] = ac;
+		}
+	}
+}
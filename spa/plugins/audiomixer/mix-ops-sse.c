@@ -28,34 +28,49 @@ mix_f32_sse(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTR
 		__m128 in[4];
 		const float **s = (const float **)src;
 		float *d = dst;
+		bool aligned = SPA_IS_ALIGNED(dst, 16);
 
-		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 16))) {
-			unrolled = n_samples & ~15;
-			for (i = 0; i < n_src; i++) {
-				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 16))) {
-					unrolled = 0;
-					break;
+		for (i = 0; i < n_src && aligned; i++)
+			aligned = SPA_IS_ALIGNED(src[i], 16);
+
+		unrolled = n_samples & ~15;
+
+		if (SPA_LIKELY(aligned)) {
+			for (n = 0; n < unrolled; n += 16) {
+				in[0] = _mm_load_ps(&s[0][n+ 0]);
+				in[1] = _mm_load_ps(&s[0][n+ 4]);
+				in[2] = _mm_load_ps(&s[0][n+ 8]);
+				in[3] = _mm_load_ps(&s[0][n+12]);
+
+				for (i = 1; i < n_src; i++) {
+					in[0] = _mm_add_ps(in[0], _mm_load_ps(&s[i][n+ 0]));
+					in[1] = _mm_add_ps(in[1], _mm_load_ps(&s[i][n+ 4]));
+					in[2] = _mm_add_ps(in[2], _mm_load_ps(&s[i][n+ 8]));
+					in[3] = _mm_add_ps(in[3], _mm_load_ps(&s[i][n+12]));
 				}
+				_mm_store_ps(&d[n+ 0], in[0]);
+				_mm_store_ps(&d[n+ 4], in[1]);
+				_mm_store_ps(&d[n+ 8], in[2]);
+				_mm_store_ps(&d[n+12], in[3]);
 			}
-		} else
-			unrolled = 0;
+		} else {
+			for (n = 0; n < unrolled; n += 16) {
+				in[0] = _mm_loadu_ps(&s[0][n+ 0]);
+				in[1] = _mm_loadu_ps(&s[0][n+ 4]);
+				in[2] = _mm_loadu_ps(&s[0][n+ 8]);
+				in[3] = _mm_loadu_ps(&s[0][n+12]);
 
-		for (n = 0; n < unrolled; n += 16) {
-			in[0] = _mm_load_ps(&s[0][n+ 0]);
-			in[1] = _mm_load_ps(&s[0][n+ 4]);
-			in[2] = _mm_load_ps(&s[0][n+ 8]);
-			in[3] = _mm_load_ps(&s[0][n+12]);
-
-			for (i = 1; i < n_src; i++) {
-				in[0] = _mm_add_ps(in[0], _mm_load_ps(&s[i][n+ 0]));
-				in[1] = _mm_add_ps(in[1], _mm_load_ps(&s[i][n+ 4]));
-				in[2] = _mm_add_ps(in[2], _mm_load_ps(&s[i][n+ 8]));
-				in[3] = _mm_add_ps(in[3], _mm_load_ps(&s[i][n+12]));
+				for (i = 1; i < n_src; i++) {
+					in[0] = _mm_add_ps(in[0], _mm_loadu_ps(&s[i][n+ 0]));
+					in[1] = _mm_add_ps(in[1], _mm_loadu_ps(&s[i][n+ 4]));
+					in[2] = _mm_add_ps(in[2], _mm_loadu_ps(&s[i][n+ 8]));
+					in[3] = _mm_add_ps(in[3], _mm_loadu_ps(&s[i][n+12]));
+				}
+				_mm_storeu_ps(&d[n+ 0], in[0]);
+				_mm_storeu_ps(&d[n+ 4], in[1]);
+				_mm_storeu_ps(&d[n+ 8], in[2]);
+				_mm_storeu_ps(&d[n+12], in[3]);
 			}
-			_mm_store_ps(&d[n+ 0], in[0]);
-			_mm_store_ps(&d[n+ 4], in[1]);
-			_mm_store_ps(&d[n+ 8], in[2]);
-			_mm_store_ps(&d[n+12], in[3]);
 		}
 		for (; n < n_samples; n++) {
 			in[0] = _mm_load_ss(&s[0][n]);
@@ -65,3 +80,67 @@ mix_f32_sse(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTR
 		}
 	}
 }
+
+void
+mix_f32_gain_sse(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		const struct mix_gain gain[], uint32_t n_src, uint32_t n_samples)
+{
+	const float **s = (const float **)src;
+	float *d = dst, inv;
+	uint32_t i, n, unrolled;
+	const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	__m128 in[4], g[4], t[4], gs, gd;
+
+	if (n_src == 0 || n_samples == 0) {
+		memset(dst, 0, n_samples * ops->n_channels * sizeof(float));
+		return;
+	}
+	if (ops->n_channels != 1) {
+		/* ramps are per frame, only constant gains can be applied
+		 * to the interleaved samples directly */
+		for (i = 0; i < n_src; i++) {
+			if (gain[i].start != gain[i].end) {
+				mix_f32_gain_c(ops, dst, src, gain, n_src, n_samples);
+				return;
+			}
+		}
+		n_samples *= ops->n_channels;
+	}
+	inv = 1.0f / n_samples;
+	unrolled = n_samples & ~15;
+
+	for (n = 0; n < unrolled; n += 16) {
+		t[0] = _mm_add_ps(_mm_set1_ps((float)(n+ 0)), lanes);
+		t[1] = _mm_add_ps(_mm_set1_ps((float)(n+ 4)), lanes);
+		t[2] = _mm_add_ps(_mm_set1_ps((float)(n+ 8)), lanes);
+		t[3] = _mm_add_ps(_mm_set1_ps((float)(n+12)), lanes);
+		in[0] = in[1] = in[2] = in[3] = _mm_setzero_ps();
+
+		for (i = 0; i < n_src; i++) {
+			gs = _mm_set1_ps(gain[i].start);
+			if (gain[i].start == gain[i].end) {
+				g[0] = g[1] = g[2] = g[3] = gs;
+			} else {
+				gd = _mm_set1_ps((gain[i].end - gain[i].start) * inv);
+				g[0] = _mm_add_ps(gs, _mm_mul_ps(t[0], gd));
+				g[1] = _mm_add_ps(gs, _mm_mul_ps(t[1], gd));
+				g[2] = _mm_add_ps(gs, _mm_mul_ps(t[2], gd));
+				g[3] = _mm_add_ps(gs, _mm_mul_ps(t[3], gd));
+			}
+			in[0] = _mm_add_ps(in[0], _mm_mul_ps(_mm_loadu_ps(&s[i][n+ 0]), g[0]));
+			in[1] = _mm_add_ps(in[1], _mm_mul_ps(_mm_loadu_ps(&s[i][n+ 4]), g[1]));
+			in[2] = _mm_add_ps(in[2], _mm_mul_ps(_mm_loadu_ps(&s[i][n+ 8]), g[2]));
+			in[3] = _mm_add_ps(in[3], _mm_mul_ps(_mm_loadu_ps(&s[i][n+12]), g[3]));
+		}
+		_mm_storeu_ps(&d[n+ 0], in[0]);
+		_mm_storeu_ps(&d[n+ 4], in[1]);
+		_mm_storeu_ps(&d[n+ 8], in[2]);
+		_mm_storeu_ps(&d[n+12], in[3]);
+	}
+	for (; n < n_samples; n++) {
+		float ac = 0.0f;
+		for (i = 0; i < n_src; i++)
+			ac += s[i][n] * (gain[i].start + n * ((gain[i].end - gain[i].start) * inv));
+		d[n] = ac;
+	}
+}
@@ -14,6 +14,9 @@
 
 typedef void (*mix_func_t) (struct mix_ops *ops, void * SPA_RESTRICT dst,
 		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t n_samples);
+typedef void (*mix_gain_func_t) (struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], const struct mix_gain gain[],
+		uint32_t n_src, uint32_t n_samples);
 
 struct mix_info {
 	uint32_t fmt;
@@ -21,21 +24,22 @@ struct mix_info {
 	uint32_t cpu_flags;
 	uint32_t stride;
 	mix_func_t process;
+	mix_gain_func_t process_gain;
 };
 
 static struct mix_info mix_table[] =
 {
 	/* f32 */
 #if defined(HAVE_AVX2)
-	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX2, 4, mix_f32_avx2 },
-	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX2, 4, mix_f32_avx2 },
+	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX2, 4, mix_f32_avx2, mix_f32_gain_avx2 },
+	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX2, 4, mix_f32_avx2, mix_f32_gain_avx2 },
 #endif
 #if defined (HAVE_SSE)
-	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_SSE, 4, mix_f32_sse },
-	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_SSE, 4, mix_f32_sse },
+	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_SSE, 4, mix_f32_sse, mix_f32_gain_sse },
+	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_SSE, 4, mix_f32_sse, mix_f32_gain_sse },
 #endif
-	{ SPA_AUDIO_FORMAT_F32, 0, 0, 4, mix_f32_c },
-	{ SPA_AUDIO_FORMAT_F32P, 0, 0, 4, mix_f32_c },
+	{ SPA_AUDIO_FORMAT_F32, 0, 0, 4, mix_f32_c, mix_f32_gain_c },
+	{ SPA_AUDIO_FORMAT_F32P, 0, 0, 4, mix_f32_c, mix_f32_gain_c },
 
 	/* f64 */
 #if defined (HAVE_SSE2)
@@ -93,6 +97,63 @@ static void impl_mix_ops_clear(struct mix_ops *ops, void * SPA_RESTRICT dst, uin
 	memset(dst, 0, n_samples * info->stride);
 }
 
+/* Wide fan-in is mixed in tiles of MIX_TILE_SIZE bytes. Inside a tile, the
+ * sources are mixed in groups of MIX_GROUP and the partial sum of the previous
+ * groups is the first source of the next group. The partial sum alternates
+ * between the destination and one temporary tile because the sources of the
+ * mixers can't alias the destination. This keeps the number of streams the
+ * prefetcher needs to follow small and the partial sum in cache. It only pays
+ * off from about MIX_TILE_MIN_SRC sources, below that the plain mixer is
+ * faster. Only used for the float formats, the others clamp after each sum. */
+#define MIX_GROUP		16u
+#define MIX_TILE_SIZE		2048u
+#define MIX_TILE_MIN_SRC	64u
+
+static void mix_tile(struct mix_ops *ops, const struct mix_info *info, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t offset, uint32_t n_samples)
+{
+	uint8_t tmp[MIX_TILE_SIZE] SPA_ALIGNED(MIX_OPS_MAX_ALIGN);
+	const void *s[MIX_GROUP];
+	void *out, *sum = NULL;
+	uint32_t i, j, n, n_groups;
+
+	/* the first group has MIX_GROUP sources, the others one less to make
+	 * room for the partial sum. Start in the buffer that makes the last
+	 * group end in dst. */
+	n_groups = 1 + (n_src - 2) / (MIX_GROUP - 1);
+	out = n_groups & 1 ? dst : tmp;
+
+	for (i = 0; i < n_src; i += n) {
+		j = 0;
+		if (sum != NULL)
+			s[j++] = sum;
+		for (n = 0; j < MIX_GROUP && i + n < n_src; n++)
+			s[j++] = SPA_PTROFF(src[i + n], offset, void);
+		info->process(ops, out, s, j, n_samples);
+
+		sum = out;
+		out = out == dst ? (void *)tmp : dst;
+	}
+}
+
+static void impl_mix_ops_process_tiled(struct mix_ops *ops, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src[], uint32_t n_src, uint32_t n_samples)
+{
+	const struct mix_info *info = ops->priv;
+	uint32_t n, chunk, tile, frame_size = info->stride * ops->n_channels;
+
+	tile = MIX_TILE_SIZE / frame_size;
+	if (n_src <= MIX_TILE_MIN_SRC || tile == 0) {
+		info->process(ops, dst, src, n_src, n_samples);
+		return;
+	}
+	for (n = 0; n < n_samples; n += chunk) {
+		chunk = SPA_MIN(tile, n_samples - n);
+		mix_tile(ops, info, SPA_PTROFF(dst, n * frame_size, void),
+				src, n_src, n * frame_size, chunk);
+	}
+}
+
 static void impl_mix_ops_free(struct mix_ops *ops)
 {
 	spa_zero(*ops);
@@ -109,7 +170,18 @@ int mix_ops_init(struct mix_ops *ops)
 	ops->priv = info;
 	ops->cpu_flags = info->cpu_flags;
 	ops->clear = impl_mix_ops_clear;
-	ops->process = info->process;
+	switch (info->fmt) {
+	case SPA_AUDIO_FORMAT_F32:
+	case SPA_AUDIO_FORMAT_F32P:
+	case SPA_AUDIO_FORMAT_F64:
+	case SPA_AUDIO_FORMAT_F64P:
+		ops->process = impl_mix_ops_process_tiled;
+		break;
+	default:
+		ops->process = info->process;
+		break;
+	}
+	ops->process_gain = info->process_gain;
 	ops->free = impl_mix_ops_free;
 
 	return 0;
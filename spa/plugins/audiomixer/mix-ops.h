@@ -97,6 +97,13 @@ static inline int24_t s32_to_s24(int32_t src)
 #define F64_ACCUM(a,b)		((a) + (b))
 #define F64_CLAMP(a)		(a)
 
+/* gain for one source, linearly ramped from start at the first sample to
+ * end after the last sample. Use start == end for a constant gain. */
+struct mix_gain {
+	float start;
+	float end;
+};
+
 struct mix_ops {
 	uint32_t fmt;
 	uint32_t n_channels;
@@ -107,6 +114,10 @@ struct mix_ops {
 			void * SPA_RESTRICT dst,
 			const void * SPA_RESTRICT src[], uint32_t n_src,
 			uint32_t n_samples);
+	void (*process_gain) (struct mix_ops *ops,
+			void * SPA_RESTRICT dst,
+			const void * SPA_RESTRICT src[], const struct mix_gain gain[],
+			uint32_t n_src, uint32_t n_samples);
 	void (*free) (struct mix_ops *ops);
 
 	const void *priv;
@@ -116,6 +127,7 @@ int mix_ops_init(struct mix_ops *ops);
 
 #define mix_ops_clear(ops,...)		(ops)->clear(ops, __VA_ARGS__)
 #define mix_ops_process(ops,...)	(ops)->process(ops, __VA_ARGS__)
+#define mix_ops_process_gain(ops,...)	(ops)->process_gain(ops, __VA_ARGS__)
 #define mix_ops_free(ops)		(ops)->free(ops)
 
 #define DEFINE_FUNCTION(name,arch) \
@@ -123,6 +135,11 @@ void mix_##name##_##arch(struct mix_ops *ops, void * SPA_RESTRICT dst,	\
 		const void * SPA_RESTRICT src[], uint32_t n_src,		\
 		uint32_t n_samples)						\
 
+#define DEFINE_GAIN_FUNCTION(name,arch) \
+void mix_##name##_gain_##arch(struct mix_ops *ops, void * SPA_RESTRICT dst,	\
+		const void * SPA_RESTRICT src[], const struct mix_gain gain[],	\
+		uint32_t n_src, uint32_t n_samples)				\
+
 #define MIX_OPS_MAX_ALIGN	32u
 
 DEFINE_FUNCTION(s8, c);
@@ -137,13 +154,16 @@ DEFINE_FUNCTION(s24_32, c);
 DEFINE_FUNCTION(u24_32, c);
 DEFINE_FUNCTION(f32, c);
 DEFINE_FUNCTION(f64, c);
+DEFINE_GAIN_FUNCTION(f32, c);
 
 #if defined(HAVE_SSE)
 DEFINE_FUNCTION(f32, sse);
+DEFINE_GAIN_FUNCTION(f32, sse);
 #endif
 #if defined(HAVE_SSE2)
 DEFINE_FUNCTION(f64, sse2);
 #endif
 #if defined(HAVE_AVX2)
 DEFINE_FUNCTION(f32, avx2);
+DEFINE_GAIN_FUNCTION(f32, avx2);
 #endif
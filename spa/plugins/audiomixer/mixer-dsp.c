@@ -19,7 +19,9 @@
 #include <spa/node/io.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/param/param.h>
+#include <spa/param/props.h>
 #include <spa/pod/filter.h>
+#include <spa/pod/parser.h>
 
 #include "mix-ops.h"
 
@@ -32,12 +34,12 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.mixer-dsp");
 #define MAX_PORTS	512
 #define MAX_ALIGN	MIX_OPS_MAX_ALIGN
 
-#define PORT_DEFAULT_VOLUME	1.0
+#define PORT_DEFAULT_VOLUME	1.0f
 #define PORT_DEFAULT_MUTE	false
 
 struct port_props {
-	double volume;
-	int32_t mute;
+	float volume;
+	bool mute;
 };
 
 static void port_props_reset(struct port_props *props)
@@ -67,6 +69,7 @@ struct port {
 	uint32_t id;
 
 	struct port_props props;
+	float gain;			/* gain reached at the end of the last cycle */
 
 	struct spa_io_buffers *io[2];
 
@@ -116,6 +119,7 @@ struct impl {
 
 	struct buffer *mix_buffers[MAX_PORTS];
 	const void *mix_datas[MAX_PORTS];
+	struct mix_gain mix_gains[MAX_PORTS];
 
 	int n_formats;
 	struct spa_audio_info format;
@@ -267,6 +271,7 @@ static int impl_node_add_port(void *object, enum spa_direction direction, uint32
 	port->id = port_id;
 
 	port_props_reset(&port->props);
+	port->gain = PORT_DEFAULT_VOLUME;
 
 	spa_list_init(&port->queue);
 	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
@@ -281,8 +286,9 @@ static int impl_node_add_port(void *object, enum spa_direction direction, uint32
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 
 	this->in_ports[port_id] = port;
 	spa_list_append(&this->port_list, &port->link);
@@ -438,6 +444,18 @@ next:
 			return 0;
 		}
 		break;
+
+	case SPA_PARAM_Props:
+		if (direction != SPA_DIRECTION_INPUT)
+			return -ENOENT;
+		if (result.index > 0)
+			return 0;
+
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Props, id,
+			SPA_PROP_volume, SPA_POD_Float(port->props.volume),
+			SPA_PROP_mute,   SPA_POD_Bool(port->props.mute));
+		break;
 	default:
 		return -ENOENT;
 	}
@@ -572,6 +590,35 @@ static int port_set_format(void *object,
 }
 
 
+static int port_set_props(struct impl *this, enum spa_direction direction,
+		uint32_t port_id, const struct spa_pod *param)
+{
+	struct port *port;
+	struct port_props *p;
+
+	if (direction != SPA_DIRECTION_INPUT)
+		return -ENOENT;
+
+	port = GET_PORT(this, direction, port_id);
+	p = &port->props;
+
+	if (param == NULL) {
+		port_props_reset(p);
+	} else {
+		spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_Props, NULL,
+			SPA_PROP_volume, SPA_POD_OPT_Float(&p->volume),
+			SPA_PROP_mute,   SPA_POD_OPT_Bool(&p->mute));
+	}
+	spa_log_debug(this->log, "%p: port %d volume:%f mute:%d", this,
+			port_id, p->volume, p->mute);
+
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	port->params[5].user++;
+	emit_port_info(this, port, false);
+	return 0;
+}
+
 static int
 impl_node_port_set_param(void *object,
 			 enum spa_direction direction, uint32_t port_id,
@@ -583,11 +630,14 @@ impl_node_port_set_param(void *object,
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
 
-	if (id == SPA_PARAM_Format) {
+	switch (id) {
+	case SPA_PARAM_Format:
 		return port_set_format(this, direction, port_id, flags, param);
-	}
-	else
+	case SPA_PARAM_Props:
+		return port_set_props(this, direction, port_id, param);
+	default:
 		return -ENOENT;
+	}
 }
 
 static int
@@ -784,8 +834,10 @@ static int impl_node_process(void *object)
 	struct buffer **buffers;
 	struct buffer *outb;
 	const void **datas;
+	struct mix_gain *gains;
 	uint32_t cycle = this->position->clock.cycle & 1;
 	struct spa_data *d;
+	bool unity = true;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
@@ -807,6 +859,7 @@ static int impl_node_process(void *object)
 
 	buffers = this->mix_buffers;
 	datas = this->mix_datas;
+	gains = this->mix_gains;
 	n_buffers = 0;
 
 	maxsize = UINT32_MAX;
@@ -816,6 +869,7 @@ static int impl_node_process(void *object)
 		struct buffer *inb;
 		struct spa_data *bd;
 		uint32_t size, offs;
+		float target;
 
 		if (inio->buffer_id >= inport->n_buffers ||
 		    inio->status != SPA_STATUS_HAVE_DATA) {
@@ -837,7 +891,16 @@ static int impl_node_process(void *object)
 				offs, size, (int)sizeof(float),
 				bd->chunk->flags);
 
-		if (!SPA_FLAG_IS_SET(bd->chunk->flags, SPA_CHUNK_FLAG_EMPTY)) {
+		/* ramp from the previous gain to the new one over this cycle */
+		target = inport->props.mute ? 0.0f : inport->props.volume;
+		gains[n_buffers].start = inport->gain;
+		gains[n_buffers].end = target;
+		inport->gain = target;
+
+		if (!SPA_FLAG_IS_SET(bd->chunk->flags, SPA_CHUNK_FLAG_EMPTY) &&
+		    (gains[n_buffers].start != 0.0f || target != 0.0f)) {
+			if (gains[n_buffers].start != 1.0f || target != 1.0f)
+				unity = false;
 			datas[n_buffers] = SPA_PTROFF(bd->data, offs, void);
 			buffers[n_buffers++] = inb;
 		}
@@ -854,7 +917,7 @@ static int impl_node_process(void *object)
 
 	d = outb->buf.datas;
 
-	if (n_buffers == 1 && SPA_FLAG_IS_SET(d[0].flags, SPA_DATA_FLAG_DYNAMIC)) {
+	if (n_buffers == 1 && unity && SPA_FLAG_IS_SET(d[0].flags, SPA_DATA_FLAG_DYNAMIC)) {
 		spa_log_trace_fp(this->log, "%p: %d passthrough", this, n_buffers);
 		*outb->buffer = *buffers[0]->buffer;
 	} else {
@@ -869,8 +932,12 @@ static int impl_node_process(void *object)
 
 		spa_log_trace_fp(this->log, "%p: %d mix %d", this, n_buffers, maxsize);
 
-		mix_ops_process(&this->ops, d[0].data,
-				datas, n_buffers, maxsize / sizeof(float));
+		if (unity)
+			mix_ops_process(&this->ops, d[0].data,
+					datas, n_buffers, maxsize / sizeof(float));
+		else
+			mix_ops_process_gain(&this->ops, d[0].data,
+					datas, gains, n_buffers, maxsize / sizeof(float));
 	}
 
 	outio->buffer_id = outb->id;
@@ -9,6 +9,7 @@
 
 extern const struct spa_handle_factory spa_audiomixer_factory;
 extern const struct spa_handle_factory spa_mixer_dsp_factory;
+extern const struct spa_handle_factory spa_mix_minus_factory;
 
 SPA_LOG_TOPIC_ENUM_DEFINE_REGISTERED;
 
@@ -25,6 +26,9 @@ int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t
 	case 1:
 		*factory = &spa_mixer_dsp_factory;
 		break;
+	case 2:
+		*factory = &spa_mix_minus_factory;
+		break;
 	default:
 		return 0;
 	}
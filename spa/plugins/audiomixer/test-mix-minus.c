@@ -0,0 +1,228 @@
+/* Spa */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+
+#include <spa/param/audio/dsp-utils.h>
+#include <spa/support/log-impl.h>
+
+#include "mix-minus.c"
+
+SPA_LOG_IMPL(logger);
+
+#define N_PORTS		3
+#define N_SAMPLES	256
+
+struct context {
+	struct spa_handle *handle;
+	struct spa_node *node;
+
+	struct spa_loop data_loop;
+	struct spa_io_position position;
+
+	struct spa_io_buffers io[2][N_PORTS];
+	struct spa_buffer buffers[2][N_PORTS];
+	struct spa_buffer *buffer_ptrs[2][N_PORTS];
+	struct spa_data datas[2][N_PORTS];
+	struct spa_chunk chunks[2][N_PORTS];
+
+	float in[N_PORTS][N_SAMPLES];
+	float out[N_PORTS][N_SAMPLES];
+
+	uint32_t props_changed;
+};
+
+static void node_info(void *data, const struct spa_node_info *info)
+{
+	struct context *ctx = data;
+	uint32_t i;
+
+	if (!SPA_FLAG_IS_SET(info->change_mask, SPA_NODE_CHANGE_MASK_PARAMS))
+		return;
+	for (i = 0; i < info->n_params; i++) {
+		if (info->params[i].id == SPA_PARAM_Props && info->params[i].user > 0)
+			ctx->props_changed++;
+	}
+}
+
+static const struct spa_node_events node_events = {
+	SPA_VERSION_NODE_EVENTS,
+	.info = node_info,
+};
+
+static int loop_locked(void *object, spa_invoke_func_t func, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	return func(object, false, seq, data, size, user_data);
+}
+
+static const struct spa_loop_methods loop_methods = {
+	SPA_VERSION_LOOP_METHODS,
+	.locked = loop_locked,
+};
+
+static void setup_context(struct context *ctx)
+{
+	struct spa_support support[2];
+	struct spa_dict_item items[2];
+	uint8_t buffer[1024];
+	struct spa_pod_builder b;
+	struct spa_audio_info_dsp info = { .format = SPA_AUDIO_FORMAT_DSP_F32 };
+	struct spa_pod *format;
+	uint32_t i, d;
+	size_t size;
+	void *iface;
+
+	ctx->data_loop.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_DataLoop,
+			SPA_VERSION_LOOP, &loop_methods, &ctx->data_loop);
+
+	support[0] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, &logger);
+	support[1] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataLoop, &ctx->data_loop);
+
+	items[0] = SPA_DICT_ITEM_INIT("clock.quantum-limit", "8192");
+	items[1] = SPA_DICT_ITEM_INIT("mix-minus.ports", SPA_STRINGIFY(N_PORTS));
+
+	size = spa_handle_factory_get_size(&spa_mix_minus_factory, NULL);
+	ctx->handle = calloc(1, size);
+	spa_assert_se(ctx->handle != NULL);
+
+	spa_assert_se(spa_handle_factory_init(&spa_mix_minus_factory, ctx->handle,
+			&SPA_DICT_INIT(items, 2), support, 2) >= 0);
+	spa_assert_se(spa_handle_get_interface(ctx->handle,
+			SPA_TYPE_INTERFACE_Node, &iface) >= 0);
+	ctx->node = iface;
+
+	ctx->position.clock.duration = N_SAMPLES;
+	spa_assert_se(spa_node_set_io(ctx->node, SPA_IO_Position,
+			&ctx->position, sizeof(ctx->position)) == 0);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	format = spa_format_audio_dsp_build(&b, SPA_PARAM_Format, &info);
+
+	for (d = 0; d < 2; d++) {
+		for (i = 0; i < N_PORTS; i++) {
+			struct spa_data *sd = &ctx->datas[d][i];
+			struct spa_buffer *sb = &ctx->buffers[d][i];
+
+			sd->type = SPA_DATA_MemPtr;
+			sd->flags = SPA_DATA_FLAG_READWRITE;
+			sd->data = d == SPA_DIRECTION_INPUT ? ctx->in[i] : ctx->out[i];
+			sd->maxsize = N_SAMPLES * sizeof(float);
+			sd->chunk = &ctx->chunks[d][i];
+			sb->n_datas = 1;
+			sb->datas = sd;
+			ctx->buffer_ptrs[d][i] = sb;
+
+			spa_assert_se(spa_node_port_set_param(ctx->node, d, i,
+					SPA_PARAM_Format, 0, format) == 0);
+			spa_assert_se(spa_node_port_use_buffers(ctx->node, d, i, 0,
+					&ctx->buffer_ptrs[d][i], 1) == 0);
+			spa_assert_se(spa_node_port_set_io(ctx->node, d, i, SPA_IO_Buffers,
+					&ctx->io[d][i], sizeof(ctx->io[d][i])) == 0);
+			ctx->io[d][i].buffer_id = SPA_ID_INVALID;
+		}
+	}
+	spa_assert_se(spa_node_send_command(ctx->node,
+			&SPA_NODE_COMMAND_INIT(SPA_NODE_COMMAND_Start)) == 0);
+}
+
+static void clean_context(struct context *ctx)
+{
+	spa_handle_clear(ctx->handle);
+	free(ctx->handle);
+}
+
+static void run_cycle(struct context *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < N_PORTS; i++) {
+		ctx->chunks[SPA_DIRECTION_INPUT][i].offset = 0;
+		ctx->chunks[SPA_DIRECTION_INPUT][i].size = N_SAMPLES * sizeof(float);
+		ctx->chunks[SPA_DIRECTION_INPUT][i].flags = 0;
+		ctx->io[SPA_DIRECTION_INPUT][i].buffer_id = 0;
+		ctx->io[SPA_DIRECTION_INPUT][i].status = SPA_STATUS_HAVE_DATA;
+		ctx->io[SPA_DIRECTION_OUTPUT][i].status = SPA_STATUS_NEED_DATA;
+	}
+	spa_node_process(ctx->node);
+
+	for (i = 0; i < N_PORTS; i++) {
+		spa_assert_se(ctx->io[SPA_DIRECTION_OUTPUT][i].status == SPA_STATUS_HAVE_DATA);
+		spa_assert_se(ctx->io[SPA_DIRECTION_OUTPUT][i].buffer_id == 0);
+		spa_assert_se(ctx->chunks[SPA_DIRECTION_OUTPUT][i].size ==
+				N_SAMPLES * sizeof(float));
+	}
+}
+
+static void check_output(struct context *ctx, const float *volumes)
+{
+	uint32_t i, j, n;
+
+	for (i = 0; i < N_PORTS; i++) {
+		for (n = 0; n < N_SAMPLES; n++) {
+			float expected = 0.0f;
+			for (j = 0; j < N_PORTS; j++) {
+				if (j != i)
+					expected += ctx->in[j][n] * volumes[j];
+			}
+			if (fabsf(ctx->out[i][n] - expected) > 1e-6f) {
+				fprintf(stderr, "port %u sample %u: %f != %f\n",
+						i, n, ctx->out[i][n], expected);
+				spa_assert_not_reached();
+			}
+		}
+	}
+}
+
+static void test_mix_minus(void)
+{
+	static struct context ctx;
+	static const float unity[N_PORTS] = { 1.0f, 1.0f, 1.0f };
+	static const float volumes[N_PORTS] = { 0.5f, 2.0f, 0.0f };
+	uint8_t buffer[1024];
+	struct spa_pod_builder b;
+	struct spa_pod *props;
+	struct spa_hook listener;
+	uint32_t i, n;
+
+	setup_context(&ctx);
+	spa_zero(listener);
+	spa_node_add_listener(ctx.node, &listener, &node_events, &ctx);
+
+	for (i = 0; i < N_PORTS; i++) {
+		for (n = 0; n < N_SAMPLES; n++)
+			ctx.in[i][n] = (float)((int)((n * (i + 3) + i * 7) % 16) - 8) / 16.0f;
+	}
+
+	run_cycle(&ctx);
+	check_output(&ctx, unity);
+
+	/* the channelVolumes are the gains of the inputs in the bus */
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	props = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_Props, SPA_PARAM_Props,
+			SPA_PROP_channelVolumes, SPA_POD_Array(sizeof(float),
+					SPA_TYPE_Float, N_PORTS, volumes));
+	spa_assert_se(spa_node_set_param(ctx.node, SPA_PARAM_Props, 0, props) == 0);
+	/* the property change is announced */
+	spa_assert_se(ctx.props_changed == 1);
+
+	run_cycle(&ctx);
+	check_output(&ctx, volumes);
+
+	spa_hook_remove(&listener);
+	clean_context(&ctx);
+}
+
+int main(int argc, char *argv[])
+{
+	test_mix_minus();
+	return 0;
+}
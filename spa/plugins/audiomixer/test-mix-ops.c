@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include <spa/debug/mem.h>
 
@@ -229,6 +230,106 @@ static void test_f32(void)
 #endif
 }
 
+static int run_gain_test(const char *name, const void *src[], const struct mix_gain gain[],
+		uint32_t n_src, const void *dst, size_t dst_size, uint32_t n_samples,
+		mix_gain_func_t mix)
+{
+	struct mix_ops ops;
+
+	ops.fmt = SPA_AUDIO_FORMAT_F32;
+	ops.n_channels = 1;
+	ops.cpu_flags = cpu_flags;
+	mix_ops_init(&ops);
+
+	fprintf(stderr, "%s\n", name);
+
+	mix(&ops, (void *)samp_out, src, gain, n_src, n_samples);
+	compare_mem(0, 0, samp_out, dst, dst_size);
+	return 0;
+}
+
+static void compare_float(const char *name, const float *m1, const float *m2, uint32_t n_samples)
+{
+	uint32_t i;
+
+	fprintf(stderr, "%s\n", name);
+	for (i = 0; i < n_samples; i++)
+		spa_assert_se(fabsf(m1[i] - m2[i]) < 1e-6f);
+}
+
+static void test_f32_gain(void)
+{
+	float out[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float in_1[] = { 1.0f, -1.0f, 0.5f, -0.5f };
+	float in_2[] = { 0.5f, -0.5f, -0.5f, 0.5f };
+	float in_3[] = { -0.5f, 1.0f, 0.5f, -0.5f };
+	float out_1[] = { 0.5f, -0.5f, 0.25f, -0.25f };
+	float out_3[] = { 0.5f, -0.625f, 0.0f, 0.125f };
+	const void *src[3] = { in_1, in_2, in_3 };
+	const struct mix_gain gain[3] = { { 0.5f, 0.5f }, { 0.0f, 1.0f }, { 0.0f, 0.0f } };
+	static float long_in[3][67], long_out[67], long_ref[67];
+	const void *long_src[3] = { long_in[0], long_in[1], long_in[2] };
+	const struct mix_gain long_gain[3] = { { 0.5f, 0.5f }, { 0.0f, 1.0f }, { 1.0f, 0.0f } };
+	uint32_t i, n;
+
+	run_gain_test("test_f32_gain_0", NULL, NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_f32_gain_c);
+	run_gain_test("test_f32_gain_1", src, gain, 1, out_1, sizeof(out_1), SPA_N_ELEMENTS(out_1), mix_f32_gain_c);
+	run_gain_test("test_f32_gain_3", src, gain, 3, out_3, sizeof(out_3), SPA_N_ELEMENTS(out_3), mix_f32_gain_c);
+
+	/* the SIMD versions must ramp like the C version */
+	for (i = 0; i < 3; i++)
+		for (n = 0; n < SPA_N_ELEMENTS(long_out); n++)
+			long_in[i][n] = (float)((int)((n * 7 + i * 3) % 16) - 8) / 8.0f;
+	mix_f32_gain_c(&(struct mix_ops) { .n_channels = 1 }, long_ref, long_src, long_gain,
+			3, SPA_N_ELEMENTS(long_ref));
+#if defined(HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE) {
+		run_gain_test("test_f32_gain_0_sse", NULL, NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_f32_gain_sse);
+		run_gain_test("test_f32_gain_3_sse", src, gain, 3, out_3, sizeof(out_3), SPA_N_ELEMENTS(out_3), mix_f32_gain_sse);
+		mix_f32_gain_sse(&(struct mix_ops) { .n_channels = 1 }, long_out, long_src, long_gain,
+				3, SPA_N_ELEMENTS(long_out));
+		compare_float("test_f32_gain_67_sse", long_out, long_ref, SPA_N_ELEMENTS(long_out));
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_gain_test("test_f32_gain_0_avx", NULL, NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_f32_gain_avx2);
+		run_gain_test("test_f32_gain_3_avx", src, gain, 3, out_3, sizeof(out_3), SPA_N_ELEMENTS(out_3), mix_f32_gain_avx2);
+		mix_f32_gain_avx2(&(struct mix_ops) { .n_channels = 1 }, long_out, long_src, long_gain,
+				3, SPA_N_ELEMENTS(long_out));
+		compare_float("test_f32_gain_67_avx", long_out, long_ref, SPA_N_ELEMENTS(long_out));
+	}
+#endif
+}
+
+static void test_f32_wide(void)
+{
+	static float in[300][N_SAMPLES], out[N_SAMPLES];
+	static const void *src[300];
+	/* an odd and an even number of groups in a tile */
+	static const uint32_t n_srcs[] = { 286, 300 };
+	uint32_t i, n, t;
+	float sum;
+
+	for (i = 0; i < SPA_N_ELEMENTS(in); i++) {
+		for (n = 0; n < N_SAMPLES; n++)
+			in[i][n] = (float)((int)((n * 5 + i * 3) % 16) - 8) / 8.0f;
+		src[i] = in[i];
+	}
+	for (t = 0; t < SPA_N_ELEMENTS(n_srcs); t++) {
+		for (n = 0; n < N_SAMPLES; n++) {
+			sum = 0.0f;
+			for (i = 0; i < n_srcs[t]; i++)
+				sum += in[i][n];
+			out[n] = sum;
+		}
+		/* goes through the tiled mixer, the sums are exact so the order
+		 * of the additions does not matter */
+		run_test("test_f32_wide", src, n_srcs[t], out, sizeof(out),
+				N_SAMPLES, impl_mix_ops_process_tiled);
+	}
+}
+
 static void test_f64(void)
 {
 	double out[] = { 0.0, 0.0, 0.0, 0.0 };
@@ -267,6 +368,8 @@ int main(int argc, char *argv[])
 	test_s24_32();
 	test_u24_32();
 	test_f32();
+	test_f32_gain();
+	test_f32_wide();
 	test_f64();
 
 	return 0;
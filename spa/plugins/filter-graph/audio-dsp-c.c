@@ -182,6 +182,24 @@ void dsp_sum_c(void *obj, float * dst,
 		dst[i] = a[i] + b[i];
 }
 
+float dsp_sum_sq_c(void *obj, const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t i;
+	float sum = 0.0f;
+	for (i = 0; i < n_samples; i++)
+		sum += src[i] * src[i];
+	return sum;
+}
+
+float dsp_abs_max_c(void *obj, const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t i;
+	float max = 0.0f;
+	for (i = 0; i < n_samples; i++)
+		max = fmaxf(max, fabsf(src[i]));
+	return max;
+}
+
 void dsp_linear_c(void *obj, float * dst,
 		const float * SPA_RESTRICT src, const float mult,
 		const float add, uint32_t n_samples)
@@ -33,6 +33,10 @@ void dsp_biquad_run_##arch (void *obj, struct biquad *bq, uint32_t n_bq, uint32_
 #define MAKE_DELAY_FUNC(arch) \
 void dsp_delay_##arch (void *obj, float *buffer, uint32_t *pos, uint32_t n_buffer, \
 		uint32_t delay, float *dst, const float *src, uint32_t n_samples, float fb, float ff)
+#define MAKE_SUM_SQ_FUNC(arch) \
+float dsp_sum_sq_##arch (void *obj, const float * SPA_RESTRICT src, uint32_t n_samples)
+#define MAKE_ABS_MAX_FUNC(arch) \
+float dsp_abs_max_##arch (void *obj, const float * SPA_RESTRICT src, uint32_t n_samples)
 
 #define MAKE_FFT_NEW_FUNC(arch) \
 void *dsp_fft_new_##arch(void *obj, uint32_t size, bool real)
@@ -66,6 +70,8 @@ MAKE_LINEAR_FUNC(c);
 MAKE_MULT_FUNC(c);
 MAKE_BIQUAD_RUN_FUNC(c);
 MAKE_DELAY_FUNC(c);
+MAKE_SUM_SQ_FUNC(c);
+MAKE_ABS_MAX_FUNC(c);
 
 MAKE_FFT_NEW_FUNC(c);
 MAKE_FFT_FREE_FUNC(c);
@@ -81,6 +87,8 @@ MAKE_MIX_GAIN_FUNC(sse);
 MAKE_SUM_FUNC(sse);
 MAKE_BIQUAD_RUN_FUNC(sse);
 MAKE_DELAY_FUNC(sse);
+MAKE_SUM_SQ_FUNC(sse);
+MAKE_ABS_MAX_FUNC(sse);
 MAKE_FFT_CMUL_FUNC(sse);
 MAKE_FFT_CMULADD_FUNC(sse);
 #endif
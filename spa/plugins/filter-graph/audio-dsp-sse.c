@@ -234,6 +234,83 @@ void dsp_sum_sse(void *obj, float *r, const float *a, const float *b, uint32_t n
 	}
 }
 
+static inline float hsum_sse(__m128 v)
+{
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+	return _mm_cvtss_f32(v);
+}
+
+static inline float hmax_sse(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 0x55));
+	return _mm_cvtss_f32(v);
+}
+
+float dsp_sum_sq_sse(void *obj, const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	__m128 in[2], acc[2];
+
+	acc[0] = acc[1] = _mm_setzero_ps();
+
+	unrolled = n_samples & ~7;
+
+	if (SPA_LIKELY(SPA_IS_ALIGNED(src, 16))) {
+		for (n = 0; n < unrolled; n += 8) {
+			in[0] = _mm_load_ps(&src[n+ 0]);
+			in[1] = _mm_load_ps(&src[n+ 4]);
+			acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(in[0], in[0]));
+			acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(in[1], in[1]));
+		}
+	} else {
+		for (n = 0; n < unrolled; n += 8) {
+			in[0] = _mm_loadu_ps(&src[n+ 0]);
+			in[1] = _mm_loadu_ps(&src[n+ 4]);
+			acc[0] = _mm_add_ps(acc[0], _mm_mul_ps(in[0], in[0]));
+			acc[1] = _mm_add_ps(acc[1], _mm_mul_ps(in[1], in[1]));
+		}
+	}
+	for (; n < n_samples; n++) {
+		in[0] = _mm_load_ss(&src[n]);
+		acc[0] = _mm_add_ss(acc[0], _mm_mul_ss(in[0], in[0]));
+	}
+	return hsum_sse(_mm_add_ps(acc[0], acc[1]));
+}
+
+float dsp_abs_max_sse(void *obj, const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	__m128 in[2], max[2];
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	max[0] = max[1] = _mm_setzero_ps();
+
+	unrolled = n_samples & ~7;
+
+	if (SPA_LIKELY(SPA_IS_ALIGNED(src, 16))) {
+		for (n = 0; n < unrolled; n += 8) {
+			in[0] = _mm_load_ps(&src[n+ 0]);
+			in[1] = _mm_load_ps(&src[n+ 4]);
+			max[0] = _mm_max_ps(max[0], _mm_andnot_ps(sign, in[0]));
+			max[1] = _mm_max_ps(max[1], _mm_andnot_ps(sign, in[1]));
+		}
+	} else {
+		for (n = 0; n < unrolled; n += 8) {
+			in[0] = _mm_loadu_ps(&src[n+ 0]);
+			in[1] = _mm_loadu_ps(&src[n+ 4]);
+			max[0] = _mm_max_ps(max[0], _mm_andnot_ps(sign, in[0]));
+			max[1] = _mm_max_ps(max[1], _mm_andnot_ps(sign, in[1]));
+		}
+	}
+	for (; n < n_samples; n++) {
+		in[0] = _mm_load_ss(&src[n]);
+		max[0] = _mm_max_ss(max[0], _mm_andnot_ps(sign, in[0]));
+	}
+	return hmax_sse(_mm_max_ps(max[0], max[1]));
+}
+
 static void dsp_biquad_run1_sse(void *obj, struct biquad *bq,
 		float *out, const float *in, uint32_t n_samples)
 {
@@ -41,6 +41,8 @@ static const struct dsp_info dsp_table[] =
 		.funcs.fft_cmul = dsp_fft_cmul_avx2,
 		.funcs.fft_cmuladd = dsp_fft_cmuladd_avx2,
 		.funcs.delay = dsp_delay_sse,
+		.funcs.sum_sq = dsp_sum_sq_sse,
+		.funcs.abs_max = dsp_abs_max_sse,
 	},
 #endif
 #if defined (HAVE_SSE)
@@ -61,6 +63,8 @@ static const struct dsp_info dsp_table[] =
 		.funcs.fft_cmul = dsp_fft_cmul_sse,
 		.funcs.fft_cmuladd = dsp_fft_cmuladd_sse,
 		.funcs.delay = dsp_delay_sse,
+		.funcs.sum_sq = dsp_sum_sq_sse,
+		.funcs.abs_max = dsp_abs_max_sse,
 	},
 #endif
 	{ 0,
@@ -80,6 +84,8 @@ static const struct dsp_info dsp_table[] =
 		.funcs.fft_cmul = dsp_fft_cmul_c,
 		.funcs.fft_cmuladd = dsp_fft_cmuladd_c,
 		.funcs.delay = dsp_delay_c,
+		.funcs.sum_sq = dsp_sum_sq_c,
+		.funcs.abs_max = dsp_abs_max_c,
 	},
 };
 
@@ -19,7 +19,7 @@ struct spa_fga_dsp {
 };
 
 struct spa_fga_dsp_methods {
-#define SPA_VERSION_FGA_DSP_METHODS		0
+#define SPA_VERSION_FGA_DSP_METHODS		1
 	uint32_t version;
 
 	void (*clear) (void *obj, float * SPA_RESTRICT dst, uint32_t n_samples);
@@ -60,6 +60,10 @@ struct spa_fga_dsp_methods {
 	void (*delay) (void *obj, float *buffer, uint32_t *pos, uint32_t n_buffer, uint32_t delay,
 			float *dst, const float *src, uint32_t n_samples,
 			float fb, float ff);
+
+	/* since version 1 */
+	float (*sum_sq) (void *obj, const float * SPA_RESTRICT src, uint32_t n_samples);
+	float (*abs_max) (void *obj, const float * SPA_RESTRICT src, uint32_t n_samples);
 };
 
 static inline void spa_fga_dsp_clear(struct spa_fga_dsp *obj, float * SPA_RESTRICT dst, uint32_t n_samples)
@@ -166,5 +170,17 @@ static inline void spa_fga_dsp_delay(struct spa_fga_dsp *obj,
 	spa_api_method_v(spa_fga_dsp, &obj->iface, delay, 0,
 			buffer, pos, n_buffer, delay, dst, src, n_samples, fb, ff);
 }
+static inline float spa_fga_dsp_sum_sq(struct spa_fga_dsp *obj,
+		const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	return spa_api_method_r(float, 0.0f, spa_fga_dsp, &obj->iface, sum_sq, 1,
+			src, n_samples);
+}
+static inline float spa_fga_dsp_abs_max(struct spa_fga_dsp *obj,
+		const float * SPA_RESTRICT src, uint32_t n_samples)
+{
+	return spa_api_method_r(float, 0.0f, spa_fga_dsp, &obj->iface, abs_max, 1,
+			src, n_samples);
+}
 
 #endif /* SPA_FGA_DSP_H */
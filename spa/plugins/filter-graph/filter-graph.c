@@ -14,7 +14,11 @@
 #include <unistd.h>
 #include <limits.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
 
+#include <spa/utils/atomic.h>
 #include <spa/utils/result.h>
 #include <spa/utils/string.h>
 #include <spa/utils/json.h>
@@ -40,6 +44,7 @@ SPA_LOG_TOPIC_DEFINE_STATIC(log_topic, "spa.filter-graph");
 
 #define MAX_HNDL 64
 #define MAX_CHANNELS SPA_AUDIO_MAX_CHANNELS
+#define MAX_THREADS 16u
 
 #define DEFAULT_RATE	48000
 
@@ -129,6 +134,8 @@ struct node {
 
 	unsigned int n_sort_deps;
 	unsigned int sorted:1;
+
+	uint32_t component;
 };
 
 struct link {
@@ -149,9 +156,28 @@ struct graph_port {
 	unsigned next:1;
 };
 
+/* run time statistics in nanoseconds, reset when the generation changes */
+struct stats {
+	uint32_t generation;
+	uint64_t count;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+};
+
 struct graph_hndl {
 	const struct spa_fga_descriptor *desc;
 	void **hndl;
+	struct node *node;
+	struct stats stats;
+};
+
+/* a set of handles that does not share any data with the other
+ * branches and can run concurrently with them */
+struct branch {
+	uint32_t first;
+	uint32_t n_hndl;
+	struct stats stats;
 };
 
 struct volume {
@@ -184,6 +210,9 @@ struct graph {
 	uint32_t n_hndl;
 	struct graph_hndl *hndl;
 
+	uint32_t n_branch;
+	struct branch *branch;
+
 	uint32_t n_control;
 	struct port **control_port;
 
@@ -235,6 +264,24 @@ struct impl {
 
 	float *silence_data;
 	float *discard_data;
+
+	uint32_t max_threads;
+	uint32_t n_workers;
+	struct worker *workers;
+	sem_t done;
+	uint32_t next_branch;
+	uint32_t n_samples;
+	unsigned int sched_synced:1;
+
+	unsigned int profile:1;
+	uint32_t generation;
+};
+
+struct worker {
+	struct impl *impl;
+	pthread_t thread;
+	sem_t wakeup;
+	bool running;
 };
 
 static inline void print_channels(char *buffer, size_t max_size, uint32_t n_positions, uint32_t *positions)
@@ -253,6 +300,114 @@ static inline void print_channels(char *buffer, size_t max_size, uint32_t n_posi
 	spa_strbuf_append(&buf, "]");
 }
 
+static inline void stats_update(struct stats *s, uint32_t generation, uint64_t val)
+{
+	if (s->generation != generation) {
+		s->generation = generation;
+		s->count = s->total = s->max = 0;
+		s->min = UINT64_MAX;
+	}
+	s->count++;
+	s->total += val;
+	s->min = SPA_MIN(s->min, val);
+	s->max = SPA_MAX(s->max, val);
+}
+
+static inline void stats_add(struct stats *s, const struct stats *o)
+{
+	if (o->count == 0)
+		return;
+	s->count += o->count;
+	s->total += o->total;
+	s->min = s->count == o->count ? o->min : SPA_MIN(s->min, o->min);
+	s->max = SPA_MAX(s->max, o->max);
+}
+
+static inline void print_stats(struct spa_strbuf *buf, const struct stats *s)
+{
+	spa_strbuf_append(buf, "\"count\": %"PRIu64", \"min\": %"PRIu64", "
+			"\"avg\": %"PRIu64", \"max\": %"PRIu64,
+			s->count, s->count ? s->min : 0,
+			s->count ? s->total / s->count : 0, s->max);
+}
+
+/* a branch entry with all numbers at their widest */
+static size_t branch_timing_size(struct graph *graph)
+{
+	return 16 + (size_t)graph->n_branch * 160;
+}
+
+/* per branch: number of handles, and run time in nanoseconds */
+static inline void print_branch_timing(char *buffer, size_t max_size, struct graph *graph)
+{
+	uint32_t i;
+	struct spa_strbuf buf;
+
+	spa_strbuf_init(&buf, buffer, max_size);
+	spa_strbuf_append(&buf, "[");
+	for (i = 0; i < graph->n_branch; i++) {
+		struct branch *b = &graph->branch[i];
+		spa_strbuf_append(&buf, "%s{ \"n_hndl\": %u, ", i ? ", " : "", b->n_hndl);
+		print_stats(&buf, b->stats.generation == graph->impl->generation ?
+				&b->stats : &(struct stats) { 0 });
+		spa_strbuf_append(&buf, " }");
+	}
+	spa_strbuf_append(&buf, "]");
+}
+
+static void strbuf_append_json_string(struct spa_strbuf *buf, const char *val)
+{
+	size_t remain = buf->maxsize - buf->pos;
+	int len = spa_json_encode_string(&buf->buffer[buf->pos], remain, val);
+
+	buf->pos += SPA_MIN(remain, (size_t)len);
+}
+
+/* an escaped string takes at most 6 bytes per character */
+static size_t node_timing_size(struct graph *graph)
+{
+	struct node *node;
+	size_t size = 16;
+
+	spa_list_for_each(node, &graph->node_list, link)
+		size += 6 * (strlen(node->name) + strlen(node->desc->desc->name)) + 256;
+	return size;
+}
+
+/* per node: number of instances and the run time of the instances in nanoseconds */
+static inline void print_node_timing(char *buffer, size_t max_size, struct graph *graph)
+{
+	struct impl *impl = graph->impl;
+	struct node *node;
+	uint32_t i;
+	struct spa_strbuf buf;
+	bool first = true;
+
+	spa_strbuf_init(&buf, buffer, max_size);
+	spa_strbuf_append(&buf, "[");
+	spa_list_for_each(node, &graph->node_list, link) {
+		struct stats s = { 0 };
+
+		if (node->disabled)
+			continue;
+
+		for (i = 0; i < graph->n_hndl; i++) {
+			struct graph_hndl *h = &graph->hndl[i];
+			if (h->node == node && h->stats.generation == impl->generation)
+				stats_add(&s, &h->stats);
+		}
+		spa_strbuf_append(&buf, "%s{ \"name\": ", first ? "" : ", ");
+		strbuf_append_json_string(&buf, node->name);
+		spa_strbuf_append(&buf, ", \"label\": ");
+		strbuf_append_json_string(&buf, node->desc->desc->name);
+		spa_strbuf_append(&buf, ", \"instances\": %u, ", node->n_hndl);
+		print_stats(&buf, &s);
+		spa_strbuf_append(&buf, " }");
+		first = false;
+	}
+	spa_strbuf_append(&buf, "]");
+}
+
 static void emit_filter_graph_info(struct impl *impl, bool full)
 {
 	uint64_t old = full ? impl->info.change_mask : 0;
@@ -263,10 +418,13 @@ static void emit_filter_graph_info(struct impl *impl, bool full)
 	if (impl->info.change_mask || full) {
 		char n_inputs[64], n_outputs[64], latency[64];
 		char n_default_inputs[64], n_default_outputs[64];
-		struct spa_dict_item items[6];
+		char n_branches[64], max_threads[64];
+		struct spa_dict_item items[10];
 		struct spa_dict dict = SPA_DICT(items, 0);
 		char in_pos[MAX_CHANNELS * 8];
 		char out_pos[MAX_CHANNELS * 8];
+		char *timing = NULL, *node_timing = NULL;
+		size_t size;
 
 		/* these are the current graph inputs/outputs */
 		snprintf(n_inputs, sizeof(n_inputs), "%d", impl->graph.n_inputs);
@@ -292,10 +450,31 @@ static void emit_filter_graph_info(struct impl *impl, bool full)
 		items[dict.n_items++] = SPA_DICT_ITEM("latency",
 				spa_dtoa(latency, sizeof(latency),
 					(graph->min_latency + graph->max_latency) / 2.0f));
+
+		snprintf(n_branches, sizeof(n_branches), "%d", graph->n_branch);
+		snprintf(max_threads, sizeof(max_threads), "%d", impl->max_threads);
+		items[dict.n_items++] = SPA_DICT_ITEM("n_branches", n_branches);
+		items[dict.n_items++] = SPA_DICT_ITEM("max-threads", max_threads);
+		if (impl->n_workers > 0 && graph->n_branch > 1) {
+			size = branch_timing_size(graph);
+			if ((timing = malloc(size)) != NULL) {
+				print_branch_timing(timing, size, graph);
+				items[dict.n_items++] = SPA_DICT_ITEM("branch.timing", timing);
+			}
+		}
+		if (impl->profile) {
+			size = node_timing_size(graph);
+			if ((node_timing = malloc(size)) != NULL) {
+				print_node_timing(node_timing, size, graph);
+				items[dict.n_items++] = SPA_DICT_ITEM("node.timing", node_timing);
+			}
+		}
 		impl->info.props = &dict;
 		spa_filter_graph_emit_info(&impl->hooks, &impl->info);
 		impl->info.props = NULL;
 		impl->info.change_mask = old;
+		free(timing);
+		free(node_timing);
 	}
 }
 static int
@@ -317,12 +496,144 @@ impl_add_listener(void *object,
 	return 0;
 }
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static inline void run_hndl(struct impl *impl, struct graph_hndl *hndl, uint32_t n_samples)
+{
+	uint64_t t;
+
+	if (SPA_LIKELY(!impl->profile)) {
+		hndl->desc->run(*hndl->hndl, n_samples);
+	} else {
+		t = get_time_ns();
+		hndl->desc->run(*hndl->hndl, n_samples);
+		stats_update(&hndl->stats, impl->generation, get_time_ns() - t);
+	}
+}
+
+static void run_branch(struct impl *impl, struct branch *b, uint32_t n_samples)
+{
+	struct graph *graph = &impl->graph;
+	uint64_t t;
+	uint32_t i;
+
+	t = get_time_ns();
+	for (i = 0; i < b->n_hndl; i++)
+		run_hndl(impl, &graph->hndl[b->first + i], n_samples);
+	stats_update(&b->stats, impl->generation, get_time_ns() - t);
+}
+
+/* run branches until all of them have been claimed, this is called from
+ * the data thread and all woken up workers */
+static void run_branches(struct impl *impl)
+{
+	struct graph *graph = &impl->graph;
+	uint32_t idx;
+
+	while ((idx = __atomic_fetch_add(&impl->next_branch, 1, __ATOMIC_ACQ_REL)) < graph->n_branch)
+		run_branch(impl, &graph->branch[idx], impl->n_samples);
+}
+
+static void *worker_thread(void *data)
+{
+	struct worker *w = data;
+	struct impl *impl = w->impl;
+
+	while (true) {
+		while (sem_wait(&w->wakeup) < 0 && errno == EINTR);
+		if (!SPA_ATOMIC_LOAD(w->running))
+			break;
+		run_branches(impl);
+		sem_post(&impl->done);
+	}
+	return NULL;
+}
+
+/* give the workers the same scheduling as the data thread */
+static void sync_worker_sched(struct impl *impl)
+{
+	struct sched_param sp;
+	uint32_t i;
+	int policy, res;
+
+	impl->sched_synced = true;
+
+	if (pthread_getschedparam(pthread_self(), &policy, &sp) != 0)
+		return;
+
+	for (i = 0; i < impl->n_workers; i++) {
+		if ((res = pthread_setschedparam(impl->workers[i].thread, policy, &sp)) != 0)
+			spa_log_warn(impl->log, "can't set worker %d scheduling: %s",
+					i, strerror(res));
+	}
+}
+
+static int start_workers(struct impl *impl)
+{
+	uint32_t i;
+	int res;
+
+	if (impl->max_threads <= 1)
+		return 0;
+
+	if (sem_init(&impl->done, 0, 0) < 0)
+		return -errno;
+
+	impl->workers = calloc(impl->max_threads - 1, sizeof(struct worker));
+	if (impl->workers == NULL) {
+		res = -errno;
+		sem_destroy(&impl->done);
+		return res;
+	}
+
+	for (i = 0; i < impl->max_threads - 1; i++) {
+		struct worker *w = &impl->workers[i];
+
+		w->impl = impl;
+		w->running = true;
+		if (sem_init(&w->wakeup, 0, 0) < 0)
+			return -errno;
+		if ((res = pthread_create(&w->thread, NULL, worker_thread, w)) != 0) {
+			sem_destroy(&w->wakeup);
+			return -res;
+		}
+		impl->n_workers++;
+	}
+	spa_log_info(impl->log, "started %d workers", impl->n_workers);
+	return 0;
+}
+
+static void stop_workers(struct impl *impl)
+{
+	uint32_t i;
+
+	for (i = 0; i < impl->n_workers; i++) {
+		struct worker *w = &impl->workers[i];
+		SPA_ATOMIC_STORE(w->running, false);
+		sem_post(&w->wakeup);
+		pthread_join(w->thread, NULL);
+		sem_destroy(&w->wakeup);
+	}
+	if (impl->workers)
+		sem_destroy(&impl->done);
+	impl->n_workers = 0;
+	free(impl->workers);
+	impl->workers = NULL;
+}
+
 static int impl_process(void *object,
 		const void *in[], void *out[], uint32_t n_samples)
 {
 	struct impl *impl = object;
 	struct graph *graph = &impl->graph;
 	uint32_t i, j, n_hndl = graph->n_hndl;
+	uint32_t n_workers = graph->n_branch > 1 ?
+		SPA_MIN(impl->n_workers, graph->n_branch - 1) : 0;
 	struct graph_port *port;
 
 	for (i = 0, j = 0; i < graph->n_inputs; i++) {
@@ -344,9 +655,23 @@ static int impl_process(void *object,
 		else
 			memset(out[i], 0, n_samples * sizeof(float));
 	}
-	for (i = 0; i < n_hndl; i++) {
-		struct graph_hndl *hndl = &graph->hndl[i];
-		hndl->desc->run(*hndl->hndl, n_samples);
+	if (n_workers == 0) {
+		for (i = 0; i < n_hndl; i++)
+			run_hndl(impl, &graph->hndl[i], n_samples);
+	} else {
+		if (SPA_UNLIKELY(!impl->sched_synced))
+			sync_worker_sched(impl);
+
+		impl->n_samples = n_samples;
+		SPA_ATOMIC_STORE(impl->next_branch, 0);
+
+		for (i = 0; i < n_workers; i++)
+			sem_post(&impl->workers[i].wakeup);
+
+		run_branches(impl);
+
+		for (i = 0; i < n_workers; i++)
+			while (sem_wait(&impl->done) < 0 && errno == EINTR);
 	}
 	return 0;
 }
@@ -1784,6 +2109,9 @@ static void unsetup_graph(struct graph *graph)
 	graph->output = NULL;
 	free(graph->hndl);
 	graph->hndl = NULL;
+	free(graph->branch);
+	graph->branch = NULL;
+	graph->n_branch = 0;
 
 	spa_list_for_each(node, &graph->node_list, link) {
 		struct descriptor *desc = node->desc;
@@ -1798,14 +2126,54 @@ static void unsetup_graph(struct graph *graph)
 	}
 }
 
+/* label all nodes with the index of the connected component they are part of,
+ * returns the number of components */
+static uint32_t find_components(struct graph *graph)
+{
+	struct node *node;
+	struct link *link;
+	uint32_t idx = 0, n_component = 0;
+	bool changed = true;
+
+	spa_list_for_each(node, &graph->node_list, link)
+		node->component = idx++;
+
+	/* propagate the lowest label over the links until stable */
+	while (changed) {
+		changed = false;
+		spa_list_for_each(link, &graph->link_list, link) {
+			struct node *out = link->output->node, *in = link->input->node;
+			if (out->component == in->component)
+				continue;
+			out->component = in->component = SPA_MIN(out->component, in->component);
+			changed = true;
+		}
+	}
+	/* and make the labels contiguous */
+	spa_list_for_each(node, &graph->node_list, link) {
+		struct node *n;
+		uint32_t c = node->component;
+
+		if (c < n_component)
+			continue;
+		spa_list_for_each(n, &graph->node_list, link) {
+			if (n->component == c)
+				n->component = n_component;
+		}
+		n_component++;
+	}
+	return n_component;
+}
+
 static int setup_graph(struct graph *graph)
 {
 	struct impl *impl = graph->impl;
-	struct node *node, *first, *last;
+	struct node *node, *first, *last, **sorted = NULL;
 	struct port *port;
 	struct graph_port *gp;
 	struct graph_hndl *gh;
 	uint32_t i, j, n, n_input, n_output, n_hndl = 0, n_out_hndl;
+	uint32_t n_component, n_sorted;
 	int res;
 	struct descriptor *desc;
 	const struct spa_fga_descriptor *d;
@@ -2019,30 +2387,60 @@ static int setup_graph(struct graph *graph)
 		}
 	}
 
+	n_component = find_components(graph);
+
 	graph->n_hndl = 0;
 	graph->hndl = calloc(graph->n_nodes * n_hndl, sizeof(struct graph_hndl));
+	graph->n_branch = 0;
+	graph->branch = calloc(n_component * n_hndl, sizeof(struct branch));
+	sorted = calloc(graph->n_nodes, sizeof(struct node *));
+	if (graph->hndl == NULL || graph->branch == NULL || sorted == NULL) {
+		res = -errno;
+		goto error;
+	}
+
 	/* order all nodes based on dependencies, first reset fields */
+	n_sorted = 0;
 	sort_reset(graph);
 	while ((node = sort_next_node(graph)) != NULL) {
 		node->n_hndl = n_hndl;
 		desc = node->desc;
-		d = desc->desc;
 
-		if (!node->disabled) {
-			for (i = 0; i < n_hndl; i++) {
-				gh = &graph->hndl[graph->n_hndl++];
-				gh->hndl = &node->hndl[i];
-				gh->desc = d;
-			}
-		}
+		sorted[n_sorted++] = node;
+
 		for (i = 0; i < desc->n_control; i++) {
 			struct port *port = &node->control_port[i];
 			port_set_control_value(port,
 				port->control_initialized ? &port->control_current : NULL);
 		}
 	}
+	/* Each instance of each connected component is a branch that does not
+	 * share data with the other branches. Group the handles per branch,
+	 * keeping the dependency order inside the branch. */
+	for (n = 0; n < n_component; n++) {
+		for (i = 0; i < n_hndl; i++) {
+			struct branch *b = &graph->branch[graph->n_branch];
+
+			b->first = graph->n_hndl;
+			for (j = 0; j < n_sorted; j++) {
+				node = sorted[j];
+				if (node->component != n || node->disabled)
+					continue;
+				gh = &graph->hndl[graph->n_hndl++];
+				gh->hndl = &node->hndl[i];
+				gh->desc = node->desc->desc;
+				gh->node = node;
+			}
+			b->n_hndl = graph->n_hndl - b->first;
+			if (b->n_hndl > 0)
+				graph->n_branch++;
+		}
+	}
+	spa_log_info(impl->log, "graph has %d branches in %d components",
+			graph->n_branch, n_component);
 	res = 0;
 error:
+	free(sorted);
 	return res;
 }
 
@@ -2282,6 +2680,17 @@ static void graph_free(struct graph *graph)
 	graph->control_port = NULL;
 }
 
+static int impl_update_info(void *object)
+{
+	struct impl *impl = object;
+
+	impl->info.change_mask |= SPA_FILTER_GRAPH_CHANGE_MASK_PROPS;
+	emit_filter_graph_info(impl, false);
+	/* start a new measurement period */
+	SPA_ATOMIC_INC(impl->generation);
+	return 0;
+}
+
 static const struct spa_filter_graph_methods impl_filter_graph = {
 	SPA_VERSION_FILTER_GRAPH_METHODS,
 	.add_listener = impl_add_listener,
@@ -2292,6 +2701,7 @@ static const struct spa_filter_graph_methods impl_filter_graph = {
 	.deactivate = impl_deactivate,
 	.reset = impl_reset,
 	.process = impl_process,
+	.update_info = impl_update_info,
 };
 
 static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
@@ -2315,6 +2725,7 @@ static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *impl = (struct impl *) handle;
 
+	stop_workers(impl);
 	graph_free(&impl->graph);
 
 	if (impl->dsp)
@@ -2348,6 +2759,7 @@ impl_init(const struct spa_handle_factory *factory,
 
 	impl = (struct impl *) handle;
 	impl->graph.impl = impl;
+	impl->generation = 1;
 
 	impl->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
 	spa_log_topic_init(impl->log, &log_topic);
@@ -2370,10 +2782,16 @@ impl_init(const struct spa_handle_factory *factory,
 			spa_atou32(s, &impl->info.n_inputs, 0);
 		if (spa_streq(k, "filter-graph.n_outputs"))
 			spa_atou32(s, &impl->info.n_outputs, 0);
+		if (spa_streq(k, "filter-graph.max-threads"))
+			spa_atou32(s, &impl->max_threads, 0);
+		if (spa_streq(k, "filter-graph.profile"))
+			impl->profile = spa_atob(s);
 	}
 	if (impl->quantum_limit == 0)
 		return -EINVAL;
 
+	impl->max_threads = SPA_CLAMP(impl->max_threads, 1u, MAX_THREADS);
+
 	impl->silence_data = calloc(impl->quantum_limit, sizeof(float));
 	if (impl->silence_data == NULL) {
 		res = -errno;
@@ -2391,6 +2809,13 @@ impl_init(const struct spa_handle_factory *factory,
 		goto error;
 	}
 
+	if ((res = start_workers(impl)) < 0) {
+		spa_log_error(impl->log, "can't start workers: %s", spa_strerror(res));
+		stop_workers(impl);
+		graph_free(&impl->graph);
+		goto error;
+	}
+
 	impl->filter_graph.iface = SPA_INTERFACE_INIT(
 			SPA_TYPE_INTERFACE_FilterGraph,
 			SPA_VERSION_FILTER_GRAPH,
@@ -0,0 +1,412 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#include "loudness.h"
+
+/* samples filtered in one go */
+#define MAX_SAMPLES	1024u
+/* the loudness is measured in 100ms sub-blocks */
+#define SUB_PER_SEC	10u
+#define MOMENTARY_SUB	4u
+#define SHORTTERM_SUB	30u
+/* histogram with 0.1 LU bins from -70 to +30 LUFS */
+#define HIST_MIN	-70.0
+#define HIST_STEP	0.1
+#define HIST_BINS	1000u
+/* true peak interpolation filter */
+#define TP_TAPS		12u
+#define TP_MAX_PHASES	4u
+
+struct loudness {
+	struct spa_fga_dsp *dsp;
+
+	uint32_t rate;
+	uint32_t n_channels;
+	float weight[LOUDNESS_MAX_CHANNELS];
+
+	/* K-weighting: a high shelf and a high pass per channel */
+	struct biquad kw[LOUDNESS_MAX_CHANNELS * 2];
+	float *buffer[LOUDNESS_MAX_CHANNELS];
+
+	uint32_t sub_samples;
+	uint32_t sub_count;
+	double sub_energy;
+
+	double *ring;
+	uint32_t ring_size;
+	uint32_t ring_pos;
+	uint32_t n_sub;
+	uint32_t window_sub;
+
+	/* number of values and their summed energy per bin */
+	uint32_t block_hist[HIST_BINS];
+	double block_energy[HIST_BINS];
+	uint32_t shortterm_hist[HIST_BINS];
+	double shortterm_energy[HIST_BINS];
+
+	float peak;
+	float true_peak;
+
+	bool do_true_peak;
+	uint32_t tp_phases;
+	float tp_coef[TP_MAX_PHASES][TP_TAPS];
+	float tp_hist[LOUDNESS_MAX_CHANNELS][TP_TAPS * 2];
+	uint32_t tp_pos;
+};
+
+static inline double energy_to_lufs(double energy)
+{
+	return energy <= 0.0 ? -HUGE_VAL : -0.691 + 10.0 * log10(energy);
+}
+
+static inline int lufs_to_bin(double lufs)
+{
+	if (lufs < HIST_MIN)
+		return -1;
+	return SPA_MIN((uint32_t)((lufs - HIST_MIN) / HIST_STEP), HIST_BINS - 1);
+}
+
+static inline double bin_to_lufs(uint32_t bin)
+{
+	return HIST_MIN + (bin + 0.5) * HIST_STEP;
+}
+
+static void set_raw(struct biquad *bq, double b0, double b1, double b2,
+		double a0, double a1, double a2)
+{
+	bq->type = BQ_RAW;
+	bq->b0 = (float)(b0 / a0);
+	bq->b1 = (float)(b1 / a0);
+	bq->b2 = (float)(b2 / a0);
+	bq->a1 = (float)(a1 / a0);
+	bq->a2 = (float)(a2 / a0);
+	bq->x1 = bq->x2 = 0.0f;
+}
+
+/* The BS.1770 pre-filter and RLB filter, recalculated for the sample rate */
+static void kweighting_init(struct loudness *l, struct biquad *bq)
+{
+	double f0, G, Q, K, Vh, Vb, a0;
+
+	f0 = 1681.974450955533;
+	G = 3.999843853973347;
+	Q = 0.7071752369554196;
+	K = tan(M_PI * f0 / l->rate);
+	Vh = pow(10.0, G / 20.0);
+	Vb = pow(Vh, 0.4996667741545416);
+	a0 = 1.0 + K / Q + K * K;
+	set_raw(&bq[0],
+			Vh + Vb * K / Q + K * K,
+			2.0 * (K * K - Vh),
+			Vh - Vb * K / Q + K * K,
+			a0,
+			2.0 * (K * K - 1.0),
+			1.0 - K / Q + K * K);
+
+	f0 = 38.13547087602444;
+	Q = 0.5003270373238773;
+	K = tan(M_PI * f0 / l->rate);
+	a0 = 1.0 + K / Q + K * K;
+	set_raw(&bq[1],
+			a0, -2.0 * a0, a0,
+			a0,
+			2.0 * (K * K - 1.0),
+			1.0 - K / Q + K * K);
+}
+
+/* windowed sinc interpolator, split in phases */
+static void true_peak_init(struct loudness *l)
+{
+	uint32_t p, k, n_taps;
+
+	if (l->rate < 96000)
+		l->tp_phases = 4;
+	else if (l->rate < 192000)
+		l->tp_phases = 2;
+	else
+		l->tp_phases = 1;
+
+	n_taps = l->tp_phases * TP_TAPS;
+	for (p = 0; p < l->tp_phases; p++) {
+		double sum = 0.0;
+		for (k = 0; k < TP_TAPS; k++) {
+			uint32_t n = k * l->tp_phases + p;
+			double x = ((double)n - (n_taps - 1) / 2.0) / l->tp_phases;
+			double w = 0.42 - 0.5 * cos(2.0 * M_PI * (n + 0.5) / n_taps) +
+				0.08 * cos(4.0 * M_PI * (n + 0.5) / n_taps);
+			double s = x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+			l->tp_coef[p][k] = (float)(s * w);
+			sum += s * w;
+		}
+		for (k = 0; k < TP_TAPS; k++)
+			l->tp_coef[p][k] = (float)(l->tp_coef[p][k] / sum);
+	}
+}
+
+struct loudness *loudness_new(struct spa_fga_dsp *dsp, uint32_t rate, uint32_t n_channels,
+		const float *weight, uint32_t window_ms)
+{
+	struct loudness *l;
+	uint32_t i;
+
+	if (n_channels > LOUDNESS_MAX_CHANNELS || rate < SUB_PER_SEC)
+		return NULL;
+
+	l = calloc(1, sizeof(*l));
+	if (l == NULL)
+		return NULL;
+
+	l->dsp = dsp;
+	l->rate = rate;
+	l->n_channels = n_channels;
+	l->sub_samples = rate / SUB_PER_SEC;
+	l->window_sub = SPA_MAX((window_ms * SUB_PER_SEC + 999) / 1000, 1u);
+	l->ring_size = SPA_MAX(l->window_sub, SHORTTERM_SUB);
+
+	l->ring = calloc(l->ring_size, sizeof(double));
+	if (l->ring == NULL)
+		goto error;
+
+	for (i = 0; i < n_channels; i++) {
+		l->weight[i] = weight[i];
+		kweighting_init(l, &l->kw[i * 2]);
+		l->buffer[i] = calloc(MAX_SAMPLES, sizeof(float));
+		if (l->buffer[i] == NULL)
+			goto error;
+	}
+	true_peak_init(l);
+
+	return l;
+error:
+	loudness_free(l);
+	return NULL;
+}
+
+void loudness_free(struct loudness *l)
+{
+	uint32_t i;
+	for (i = 0; i < l->n_channels; i++)
+		free(l->buffer[i]);
+	free(l->ring);
+	free(l);
+}
+
+void loudness_reset(struct loudness *l)
+{
+	uint32_t i;
+
+	for (i = 0; i < l->n_channels * 2; i++)
+		l->kw[i].x1 = l->kw[i].x2 = 0.0f;
+
+	l->sub_count = 0;
+	l->sub_energy = 0.0;
+	memset(l->ring, 0, l->ring_size * sizeof(double));
+	l->ring_pos = 0;
+	l->n_sub = 0;
+	memset(l->block_hist, 0, sizeof(l->block_hist));
+	memset(l->block_energy, 0, sizeof(l->block_energy));
+	memset(l->shortterm_hist, 0, sizeof(l->shortterm_hist));
+	memset(l->shortterm_energy, 0, sizeof(l->shortterm_energy));
+	l->peak = 0.0f;
+	l->true_peak = 0.0f;
+	memset(l->tp_hist, 0, sizeof(l->tp_hist));
+	l->tp_pos = 0;
+}
+
+void loudness_set_true_peak(struct loudness *l, bool enabled)
+{
+	l->do_true_peak = enabled;
+}
+
+/* mean energy of the last n sub-blocks */
+static double ring_energy(struct loudness *l, uint32_t n)
+{
+	double sum = 0.0;
+	uint32_t i, pos = l->ring_pos;
+
+	for (i = 0; i < n; i++) {
+		pos = pos == 0 ? l->ring_size - 1 : pos - 1;
+		sum += l->ring[pos];
+	}
+	return sum / n;
+}
+
+static void sub_block_done(struct loudness *l)
+{
+	double energy;
+	int bin;
+
+	l->ring[l->ring_pos] = l->sub_energy / l->sub_samples;
+	l->ring_pos = (l->ring_pos + 1) % l->ring_size;
+	l->n_sub++;
+	l->sub_energy = 0.0;
+	l->sub_count = 0;
+
+	/* gating blocks of 400ms with 75% overlap */
+	if (l->n_sub >= MOMENTARY_SUB) {
+		energy = ring_energy(l, MOMENTARY_SUB);
+		if ((bin = lufs_to_bin(energy_to_lufs(energy))) >= 0) {
+			l->block_hist[bin]++;
+			l->block_energy[bin] += energy;
+		}
+	}
+	/* short-term values for the loudness range */
+	if (l->n_sub >= SHORTTERM_SUB) {
+		energy = ring_energy(l, SHORTTERM_SUB);
+		if ((bin = lufs_to_bin(energy_to_lufs(energy))) >= 0) {
+			l->shortterm_hist[bin]++;
+			l->shortterm_energy[bin] += energy;
+		}
+	}
+}
+
+static void true_peak_run(struct loudness *l, const float *in[], uint32_t n_samples)
+{
+	uint32_t c, i, p, k, pos = 0;
+	float max = l->true_peak;
+
+	for (c = 0; c < l->n_channels; c++) {
+		const float *s = in[c];
+		float *h = l->tp_hist[c];
+
+		if (s == NULL)
+			continue;
+
+		pos = l->tp_pos;
+		for (i = 0; i < n_samples; i++) {
+			const float *w;
+
+			/* keep the history twice so that the last TP_TAPS
+			 * samples are always contiguous */
+			h[pos] = h[pos + TP_TAPS] = s[i];
+			pos = (pos + 1) % TP_TAPS;
+			w = &h[pos];
+
+			for (p = 0; p < l->tp_phases; p++) {
+				const float *coef = l->tp_coef[p];
+				float y = 0.0f;
+				for (k = 0; k < TP_TAPS; k++)
+					y += coef[k] * w[k];
+				max = fmaxf(max, fabsf(y));
+			}
+		}
+	}
+	l->tp_pos = (l->tp_pos + n_samples) % TP_TAPS;
+	l->true_peak = max;
+}
+
+void loudness_process(struct loudness *l, const float *in[], uint32_t n_samples)
+{
+	const float *src[LOUDNESS_MAX_CHANNELS];
+	float *dst[LOUDNESS_MAX_CHANNELS];
+	uint32_t c, offset = 0;
+
+	while (offset < n_samples) {
+		uint32_t chunk = SPA_MIN(n_samples - offset, MAX_SAMPLES);
+		double energy = 0.0;
+
+		chunk = SPA_MIN(chunk, l->sub_samples - l->sub_count);
+
+		/* the peaks are measured on all channels, channels without a
+		 * weight (LFE) are only left out of the loudness */
+		for (c = 0; c < l->n_channels; c++) {
+			src[c] = in[c] ? in[c] + offset : NULL;
+			dst[c] = in[c] && l->weight[c] != 0.0f ? l->buffer[c] : NULL;
+		}
+		spa_fga_dsp_biquad_run(l->dsp, l->kw, 2, 2, dst, src, l->n_channels, chunk);
+
+		for (c = 0; c < l->n_channels; c++) {
+			if (src[c] == NULL)
+				continue;
+			if (dst[c] != NULL)
+				energy += l->weight[c] * spa_fga_dsp_sum_sq(l->dsp, dst[c], chunk);
+			l->peak = fmaxf(l->peak, spa_fga_dsp_abs_max(l->dsp, src[c], chunk));
+		}
+		if (l->do_true_peak && l->tp_phases > 1)
+			true_peak_run(l, src, chunk);
+
+		l->sub_energy += energy;
+		l->sub_count += chunk;
+		if (l->sub_count >= l->sub_samples)
+			sub_block_done(l);
+
+		offset += chunk;
+	}
+}
+
+/* relative gated loudness of the histogram and the bin of the gate */
+static double hist_gated(uint32_t *hist, double *energy, double gate, uint32_t *gate_bin)
+{
+	double sum = 0.0;
+	uint64_t count = 0;
+	uint32_t i, start;
+	int bin;
+
+	for (i = 0; i < HIST_BINS; i++) {
+		sum += energy[i];
+		count += hist[i];
+	}
+	if (count == 0)
+		return -HUGE_VAL;
+
+	bin = lufs_to_bin(energy_to_lufs(sum / count) + gate);
+	start = bin < 0 ? 0 : (uint32_t)bin;
+	if (gate_bin)
+		*gate_bin = start;
+
+	sum = 0.0;
+	count = 0;
+	for (i = start; i < HIST_BINS; i++) {
+		sum += energy[i];
+		count += hist[i];
+	}
+	return count == 0 ? -HUGE_VAL : energy_to_lufs(sum / count);
+}
+
+static double loudness_range(struct loudness *l)
+{
+	uint32_t i, start = 0;
+	uint64_t count = 0, acc = 0, low, high;
+	double lo = 0.0, hi = 0.0;
+
+	if (hist_gated(l->shortterm_hist, l->shortterm_energy, -20.0, &start) == -HUGE_VAL)
+		return 0.0;
+
+	for (i = start; i < HIST_BINS; i++)
+		count += l->shortterm_hist[i];
+	if (count == 0)
+		return 0.0;
+
+	/* from the 10th to the 95th percentile */
+	low = (uint64_t)(count * 0.10);
+	high = (uint64_t)(count * 0.95);
+	for (i = start; i < HIST_BINS; i++) {
+		uint64_t next = acc + l->shortterm_hist[i];
+		if (acc <= low && low < next)
+			lo = bin_to_lufs(i);
+		if (acc <= high && high < next) {
+			hi = bin_to_lufs(i);
+			break;
+		}
+		acc = next;
+	}
+	return hi - lo;
+}
+
+void loudness_get_info(struct loudness *l, struct loudness_info *info)
+{
+	info->momentary = (float)energy_to_lufs(ring_energy(l, MOMENTARY_SUB));
+	info->shortterm = (float)energy_to_lufs(ring_energy(l, SHORTTERM_SUB));
+	info->window = (float)energy_to_lufs(ring_energy(l, l->window_sub));
+	info->global = (float)hist_gated(l->block_hist, l->block_energy, -10.0, NULL);
+	info->range = (float)loudness_range(l);
+	info->peak = l->peak;
+	info->true_peak = SPA_MAX(l->true_peak, l->peak);
+}
@@ -0,0 +1,31 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "audio-dsp.h"
+
+/* ITU-R BS.1770 / EBU R128 loudness measurement */
+
+#define LOUDNESS_MAX_CHANNELS	8
+
+struct loudness_info {
+	float momentary;	/* LUFS, 400ms window */
+	float shortterm;	/* LUFS, 3s window */
+	float global;		/* LUFS, gated integrated loudness */
+	float window;		/* LUFS, configurable window */
+	float range;		/* LU, loudness range */
+	float peak;		/* linear sample peak */
+	float true_peak;	/* linear true peak */
+};
+
+struct loudness *loudness_new(struct spa_fga_dsp *dsp, uint32_t rate, uint32_t n_channels,
+		const float *weight, uint32_t window_ms);
+void loudness_free(struct loudness *l);
+
+void loudness_reset(struct loudness *l);
+void loudness_set_true_peak(struct loudness *l, bool enabled);
+void loudness_process(struct loudness *l, const float *in[], uint32_t n_samples);
+void loudness_get_info(struct loudness *l, struct loudness_info *info);
@@ -16,6 +16,7 @@
 #include <fcntl.h>
 #include <time.h>
 
+#include <spa/utils/atomic.h>
 #include <spa/utils/json.h>
 #include <spa/utils/result.h>
 #include <spa/utils/cleanup.h>
@@ -28,10 +29,14 @@
 
 #include "biquad.h"
 #include "convolver.h"
+#include "loudness.h"
 #include "audio-dsp.h"
 
 #define MAX_RATES	32u
 
+/* biquad coefficients are interpolated in blocks of this many samples */
+#define BQ_RAMP_BLOCK	32u
+
 struct plugin {
 	struct spa_handle handle;
 	struct spa_fga_plugin plugin;
@@ -40,6 +45,14 @@ struct plugin {
 	struct spa_log *log;
 };
 
+/* the control values and the coefficients computed from them */
+struct bq_update {
+	float freq, Q, gain;
+	float b0, b1, b2;
+	float a0, a1, a2;
+	struct biquad bq;
+};
+
 struct builtin {
 	struct plugin *plugin;
 
@@ -58,6 +71,13 @@ struct builtin {
 	float a0, a1, a2;
 	float accum;
 
+	struct biquad target;
+	struct bq_update pending;
+	uint32_t pending_seq;
+	uint32_t seq;
+	uint32_t ramp;
+	uint32_t ramp_left;
+
 	int mode;
 	uint32_t count;
 	float last;
@@ -321,6 +341,7 @@ static void bq_raw_update(struct builtin *impl, float b0, float b1, float b2,
 	bq->a2 = impl->a2 * a0;
 	bq->x1 = bq->x2 = 0.0f;
 	bq->type = BQ_RAW;
+	impl->target = *bq;
 }
 
 /*
@@ -330,6 +351,7 @@ static void bq_raw_update(struct builtin *impl, float b0, float b1, float b2,
  *         { rate =  48000, b0=.., b1=.., b2=.., a0=.., a1=.., a2=.. },
  *         { rate = 192000, b0=.., b1=.., b2=.., a0=.., a1=.., a2=.. }
  *     ]
+ *     smoothing = 0.01
  * }
  */
 static void *bq_instantiate(const struct spa_fga_plugin *plugin, const struct spa_fga_descriptor * Descriptor,
@@ -353,10 +375,10 @@ static void *bq_instantiate(const struct spa_fga_plugin *plugin, const struct sp
 	impl->rate = SampleRate;
 	impl->b0 = impl->a0 = 1.0f;
 	impl->type = bq_type_from_name(Descriptor->name);
-	if (impl->type != BQ_NONE)
-		return impl;
 
 	if (config == NULL) {
+		if (impl->type != BQ_NONE)
+			return impl;
 		spa_log_error(impl->log, "biquads:bq_raw requires a config section");
 		goto error;
 	}
@@ -432,6 +454,14 @@ static void *bq_instantiate(const struct spa_fga_plugin *plugin, const struct sp
 				}
 			}
 		}
+		else if (spa_streq(key, "smoothing")) {
+			float smoothing;
+			if (spa_json_parse_float(val, len, &smoothing) <= 0) {
+				spa_log_error(impl->log, "biquads:smoothing requires a number");
+				goto error;
+			}
+			impl->ramp = (uint32_t)SPA_MAX(smoothing * SampleRate, 0.0f);
+		}
 		else {
 			spa_log_warn(impl->log, "biquads: ignoring config key: '%s'", key);
 		}
@@ -503,24 +533,113 @@ static struct spa_fga_port bq_ports[] = {
 
 };
 
-static void bq_freq_update(struct builtin *impl, int type, float freq, float Q, float gain)
+/* compute the coefficients for the current control values */
+static void bq_compute(struct builtin *impl, struct bq_update *u)
+{
+	struct biquad *bq = &u->bq;
+
+	spa_zero(*u);
+
+	if (impl->type == BQ_NONE) {
+		float a0;
+		u->b0 = impl->port[5][0];
+		u->b1 = impl->port[6][0];
+		u->b2 = impl->port[7][0];
+		u->a0 = a0 = impl->port[8][0];
+		u->a1 = impl->port[9][0];
+		u->a2 = impl->port[10][0];
+		if (a0 != 0.0f)
+			a0 = 1.0f / a0;
+		bq->b0 = u->b0 * a0;
+		bq->b1 = u->b1 * a0;
+		bq->b2 = u->b2 * a0;
+		bq->a1 = u->a1 * a0;
+		bq->a2 = u->a2 * a0;
+		bq->x1 = bq->x2 = 0.0f;
+		bq->type = BQ_RAW;
+	} else {
+		u->freq = impl->port[2][0];
+		u->Q = impl->port[3][0];
+		u->gain = impl->port[4][0];
+		biquad_set(bq, impl->type, u->freq * 2 / impl->rate, u->Q, u->gain);
+		u->b0 = bq->b0;
+		u->b1 = bq->b1;
+		u->b2 = bq->b2;
+		u->a0 = 1.0f;
+		u->a1 = bq->a1;
+		u->a2 = bq->a2;
+	}
+}
+
+static bool bq_changed(struct builtin *impl)
+{
+	if (impl->type == BQ_NONE)
+		return impl->b0 != impl->port[5][0] || impl->b1 != impl->port[6][0] ||
+			impl->b2 != impl->port[7][0] || impl->a0 != impl->port[8][0] ||
+			impl->a1 != impl->port[9][0] || impl->a2 != impl->port[10][0];
+	else
+		return impl->freq != impl->port[2][0] || impl->Q != impl->port[3][0] ||
+			impl->gain != impl->port[4][0];
+}
+
+static inline bool bq_equal(const struct biquad *a, const struct biquad *b)
+{
+	return a->b0 == b->b0 && a->b1 == b->b1 && a->b2 == b->b2 &&
+		a->a1 == b->a1 && a->a2 == b->a2;
+}
+
+/* make the new coefficients the target of the filter, the filter ramps
+ * to the target when smoothing is enabled */
+static void bq_set_target(struct builtin *impl, const struct bq_update *u, bool ramp)
 {
 	struct biquad *bq = &impl->bq;
-	impl->freq = freq;
-	impl->Q = Q;
-	impl->gain = gain;
-	biquad_set(bq, type, freq * 2 / impl->rate, Q, gain);
-	impl->port[5][0] = impl->b0 = bq->b0;
-	impl->port[6][0] = impl->b1 = bq->b1;
-	impl->port[7][0] = impl->b2 = bq->b2;
-	impl->port[8][0] = impl->a0 = 1.0f;
-	impl->port[9][0] = impl->a1 = bq->a1;
-	impl->port[10][0] = impl->a2 = bq->a2;
+
+	impl->freq = u->freq;
+	impl->Q = u->Q;
+	impl->gain = u->gain;
+	impl->b0 = u->b0;
+	impl->b1 = u->b1;
+	impl->b2 = u->b2;
+	impl->a0 = u->a0;
+	impl->a1 = u->a1;
+	impl->a2 = u->a2;
+	if (impl->type != BQ_NONE) {
+		impl->port[5][0] = impl->b0;
+		impl->port[6][0] = impl->b1;
+		impl->port[7][0] = impl->b2;
+		impl->port[8][0] = impl->a0;
+		impl->port[9][0] = impl->a1;
+		impl->port[10][0] = impl->a2;
+	}
+	impl->target = u->bq;
+	if (ramp && impl->ramp > 0) {
+		impl->ramp_left = bq_equal(bq, &u->bq) ? 0 : impl->ramp;
+		bq->type = u->bq.type;
+	} else {
+		impl->ramp_left = 0;
+		*bq = u->bq;
+	}
+}
+
+/* called from the main thread when the controls changed, precompute the
+ * coefficients so that the data thread only needs to pick them up */
+static void bq_control_changed(void *Instance)
+{
+	struct builtin *impl = Instance;
+	struct bq_update u;
+
+	bq_compute(impl, &u);
+
+	SPA_SEQ_WRITE(impl->pending_seq);
+	impl->pending = u;
+	SPA_SEQ_WRITE(impl->pending_seq);
 }
 
 static void bq_activate(void * Instance)
 {
 	struct builtin *impl = Instance;
+	struct bq_update u;
+
 	if (impl->type == BQ_NONE) {
 		impl->port[5][0] = impl->b0;
 		impl->port[6][0] = impl->b1;
@@ -529,11 +648,19 @@ static void bq_activate(void * Instance)
 		impl->port[9][0] = impl->a1;
 		impl->port[10][0] = impl->a2;
 	} else {
-		float freq = impl->port[2][0];
-		float Q = impl->port[3][0];
-		float gain = impl->port[4][0];
-		bq_freq_update(impl, impl->type, freq, Q, gain);
+		bq_compute(impl, &u);
+		bq_set_target(impl, &u, false);
 	}
+	impl->seq = SPA_SEQ_READ(impl->pending_seq);
+}
+
+static void bq_ramp_step(struct biquad *bq, const struct biquad *target, float frac)
+{
+	bq->b0 += (target->b0 - bq->b0) * frac;
+	bq->b1 += (target->b1 - bq->b1) * frac;
+	bq->b2 += (target->b2 - bq->b2) * frac;
+	bq->a1 += (target->a1 - bq->a1) * frac;
+	bq->a2 += (target->a2 - bq->a2) * frac;
 }
 
 static void bq_run(void *Instance, unsigned long samples)
@@ -542,27 +669,39 @@ static void bq_run(void *Instance, unsigned long samples)
 	struct biquad *bq = &impl->bq;
 	float *out = impl->port[0];
 	float *in = impl->port[1];
-
-	if (impl->type == BQ_NONE) {
-		float b0, b1, b2, a0, a1, a2;
-		b0 = impl->port[5][0];
-		b1 = impl->port[6][0];
-		b2 = impl->port[7][0];
-		a0 = impl->port[8][0];
-		a1 = impl->port[9][0];
-		a2 = impl->port[10][0];
-		if (impl->b0 != b0 || impl->b1 != b1 || impl->b2 != b2 ||
-		    impl->a0 != a0 || impl->a1 != a1 || impl->a2 != a2) {
-			bq_raw_update(impl, b0, b1, b2, a0, a1, a2);
+	struct bq_update u;
+	uint32_t seq1, seq2, n;
+
+	seq1 = SPA_SEQ_READ(impl->pending_seq);
+	if (seq1 != impl->seq) {
+		u = impl->pending;
+		seq2 = SPA_SEQ_READ(impl->pending_seq);
+		if (SPA_SEQ_READ_SUCCESS(seq1, seq2)) {
+			impl->seq = seq1;
+			bq_set_target(impl, &u, true);
 		}
-	} else {
-		float freq = impl->port[2][0];
-		float Q = impl->port[3][0];
-		float gain = impl->port[4][0];
-		if (impl->freq != freq || impl->Q != Q || impl->gain != gain)
-			bq_freq_update(impl, impl->type, freq, Q, gain);
 	}
-	spa_fga_dsp_biquad_run(impl->dsp, bq, 1, 0, &out, (const float **)&in, 1, samples);
+	/* controls linked to a notify port of another node change without a
+	 * control_changed call, compute the coefficients here for them */
+	if (bq_changed(impl)) {
+		bq_compute(impl, &u);
+		bq_set_target(impl, &u, true);
+	}
+
+	while (impl->ramp_left > 0 && samples > 0) {
+		n = SPA_MIN(BQ_RAMP_BLOCK, samples);
+
+		bq_ramp_step(bq, &impl->target,
+				(float)SPA_MIN(n, impl->ramp_left) / impl->ramp_left);
+		impl->ramp_left -= SPA_MIN(n, impl->ramp_left);
+
+		spa_fga_dsp_biquad_run(impl->dsp, bq, 1, 0, &out, (const float **)&in, 1, n);
+		in += n;
+		out += n;
+		samples -= n;
+	}
+	if (samples > 0)
+		spa_fga_dsp_biquad_run(impl->dsp, bq, 1, 0, &out, (const float **)&in, 1, samples);
 }
 
 /** bq_lowpass */
@@ -575,6 +714,7 @@ static const struct spa_fga_descriptor bq_lowpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -589,6 +729,7 @@ static const struct spa_fga_descriptor bq_highpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -603,6 +744,7 @@ static const struct spa_fga_descriptor bq_bandpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -617,6 +759,7 @@ static const struct spa_fga_descriptor bq_lowshelf_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -631,6 +774,7 @@ static const struct spa_fga_descriptor bq_highshelf_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -645,6 +789,7 @@ static const struct spa_fga_descriptor bq_peaking_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -659,6 +804,7 @@ static const struct spa_fga_descriptor bq_notch_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -674,6 +820,7 @@ static const struct spa_fga_descriptor bq_allpass_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -688,6 +835,7 @@ static const struct spa_fga_descriptor bq_raw_desc = {
 	.instantiate = bq_instantiate,
 	.connect_port = builtin_connect_port,
 	.activate = bq_activate,
+	.control_changed = bq_control_changed,
 	.run = bq_run,
 	.cleanup = builtin_cleanup,
 };
@@ -3246,6 +3394,295 @@ static const struct spa_fga_descriptor null_desc = {
 	.cleanup = builtin_cleanup,
 };
 
+/* loudness */
+enum {
+	LOUDNESS_IN_FL,
+	LOUDNESS_IN_FR,
+	LOUDNESS_IN_FC,
+	LOUDNESS_IN_UNUSED,
+	LOUDNESS_IN_SL,
+	LOUDNESS_IN_SR,
+	LOUDNESS_IN_DUAL_MONO,
+
+	LOUDNESS_OUT_FL,
+	LOUDNESS_OUT_FR,
+	LOUDNESS_OUT_FC,
+	LOUDNESS_OUT_UNUSED,
+	LOUDNESS_OUT_SL,
+	LOUDNESS_OUT_SR,
+	LOUDNESS_OUT_DUAL_MONO,
+
+	LOUDNESS_OUT_MOMENTARY,
+	LOUDNESS_OUT_SHORTTERM,
+	LOUDNESS_OUT_GLOBAL,
+	LOUDNESS_OUT_WINDOW,
+	LOUDNESS_OUT_RANGE,
+	LOUDNESS_OUT_PEAK,
+	LOUDNESS_OUT_TRUE_PEAK,
+
+	LOUDNESS_PORT_MAX,
+
+	LOUDNESS_CHANNELS = LOUDNESS_IN_DUAL_MONO + 1,
+};
+
+struct loudness_impl {
+	struct plugin *plugin;
+
+	struct spa_fga_dsp *dsp;
+	struct spa_log *log;
+
+	unsigned long rate;
+	float *port[LOUDNESS_PORT_MAX];
+
+	uint32_t window_ms;
+	uint32_t update_samples;
+	uint32_t update_count;
+	bool true_peak;
+
+	struct loudness *loudness;
+};
+
+static void loudness_cleanup(void * Instance)
+{
+	struct loudness_impl *impl = Instance;
+	if (impl->loudness)
+		loudness_free(impl->loudness);
+	free(impl);
+}
+
+static void *loudness_instantiate(const struct spa_fga_plugin *plugin, const struct spa_fga_descriptor * Descriptor,
+		unsigned long SampleRate, int index, const char *config)
+{
+	struct plugin *pl = SPA_CONTAINER_OF(plugin, struct plugin, plugin);
+	struct loudness_impl *impl;
+	struct spa_json it[1];
+	const char *val;
+	char key[256];
+	float max_window = 0.0f, update_rate = 10.0f;
+	bool true_peak = false;
+	int len;
+
+	if (config != NULL) {
+		if (spa_json_begin_object(&it[0], config, strlen(config)) <= 0) {
+			spa_log_error(pl->log, "loudness:config must be an object");
+			return NULL;
+		}
+
+		while ((len = spa_json_object_next(&it[0], key, sizeof(key), &val)) > 0) {
+			if (spa_streq(key, "max-window")) {
+				if (spa_json_parse_float(val, len, &max_window) <= 0) {
+					spa_log_error(pl->log, "loudness:max-window requires a number");
+					return NULL;
+				}
+			} else if (spa_streq(key, "update-rate")) {
+				if (spa_json_parse_float(val, len, &update_rate) <= 0) {
+					spa_log_error(pl->log, "loudness:update-rate requires a number");
+					return NULL;
+				}
+			} else if (spa_streq(key, "true-peak")) {
+				if (spa_json_parse_bool(val, len, &true_peak) <= 0) {
+					spa_log_error(pl->log, "loudness:true-peak requires a boolean");
+					return NULL;
+				}
+			} else {
+				spa_log_warn(pl->log, "loudness: ignoring config key: '%s'", key);
+			}
+		}
+	}
+	if (max_window <= 0.0f)
+		max_window = 0.4f;
+	if (update_rate <= 0.0f)
+		update_rate = 10.0f;
+
+	impl = calloc(1, sizeof(*impl));
+	if (impl == NULL)
+		return NULL;
+
+	impl->plugin = pl;
+	impl->dsp = pl->dsp;
+	impl->log = pl->log;
+	impl->rate = SampleRate;
+	impl->window_ms = (uint32_t)(max_window * 1000.0f);
+	impl->update_samples = SPA_MAX((uint32_t)(SampleRate / update_rate), 1u);
+	impl->true_peak = true_peak;
+	spa_log_info(impl->log, "max-window:%f update-rate:%f samples:%u true-peak:%d",
+			max_window, update_rate, impl->update_samples, true_peak);
+
+	return impl;
+}
+
+static void loudness_connect_port(void * Instance, unsigned long Port,
+                        void * DataLocation)
+{
+	struct loudness_impl *impl = Instance;
+	impl->port[Port] = DataLocation;
+}
+
+static void loudness_activate(void * Instance)
+{
+	struct loudness_impl *impl = Instance;
+	static const float weight[LOUDNESS_CHANNELS] = {
+		1.0f, 1.0f, 1.0f, 0.0f, 1.41f, 1.41f, 2.0f,
+	};
+
+	if (impl->loudness == NULL)
+		impl->loudness = loudness_new(impl->dsp, impl->rate, LOUDNESS_CHANNELS,
+				weight, impl->window_ms);
+	if (impl->loudness == NULL) {
+		spa_log_error(impl->log, "loudness: can't create meter: %m");
+		return;
+	}
+	loudness_reset(impl->loudness);
+	/* oversampling is expensive, only do it when asked for */
+	loudness_set_true_peak(impl->loudness, impl->true_peak);
+	impl->update_count = 0;
+}
+
+static void loudness_run(void * Instance, unsigned long SampleCount)
+{
+	struct loudness_impl *impl = Instance;
+	const float *in[LOUDNESS_CHANNELS];
+	struct loudness_info info;
+	uint32_t i;
+
+	for (i = 0; i < LOUDNESS_CHANNELS; i++) {
+		float *out = impl->port[LOUDNESS_OUT_FL + i];
+
+		in[i] = impl->port[LOUDNESS_IN_FL + i];
+		if (in[i] != NULL && out != NULL)
+			spa_memcpy(out, in[i], SampleCount * sizeof(float));
+	}
+	if (impl->loudness == NULL)
+		return;
+
+	loudness_process(impl->loudness, in, SampleCount);
+
+	impl->update_count += SampleCount;
+	if (impl->update_count < impl->update_samples)
+		return;
+	impl->update_count %= impl->update_samples;
+
+	loudness_get_info(impl->loudness, &info);
+
+	if (impl->port[LOUDNESS_OUT_MOMENTARY] != NULL)
+		impl->port[LOUDNESS_OUT_MOMENTARY][0] = info.momentary;
+	if (impl->port[LOUDNESS_OUT_SHORTTERM] != NULL)
+		impl->port[LOUDNESS_OUT_SHORTTERM][0] = info.shortterm;
+	if (impl->port[LOUDNESS_OUT_GLOBAL] != NULL)
+		impl->port[LOUDNESS_OUT_GLOBAL][0] = info.global;
+	if (impl->port[LOUDNESS_OUT_WINDOW] != NULL)
+		impl->port[LOUDNESS_OUT_WINDOW][0] = info.window;
+	if (impl->port[LOUDNESS_OUT_RANGE] != NULL)
+		impl->port[LOUDNESS_OUT_RANGE][0] = info.range;
+	if (impl->port[LOUDNESS_OUT_PEAK] != NULL)
+		impl->port[LOUDNESS_OUT_PEAK][0] = info.peak;
+	if (impl->port[LOUDNESS_OUT_TRUE_PEAK] != NULL)
+		impl->port[LOUDNESS_OUT_TRUE_PEAK][0] = info.true_peak;
+}
+
+static struct spa_fga_port loudness_ports[] = {
+	{ .index = LOUDNESS_IN_FL,
+	  .name = "In FL",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_IN_FR,
+	  .name = "In FR",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_IN_FC,
+	  .name = "In FC",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_IN_UNUSED,
+	  .name = "In UNUSED",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_IN_SL,
+	  .name = "In SL",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_IN_SR,
+	  .name = "In SR",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_IN_DUAL_MONO,
+	  .name = "In DUAL MONO",
+	  .flags = SPA_FGA_PORT_INPUT | SPA_FGA_PORT_AUDIO,
+	},
+
+	{ .index = LOUDNESS_OUT_FL,
+	  .name = "Out FL",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_OUT_FR,
+	  .name = "Out FR",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_OUT_FC,
+	  .name = "Out FC",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_OUT_UNUSED,
+	  .name = "Out UNUSED",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_OUT_SL,
+	  .name = "Out SL",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_OUT_SR,
+	  .name = "Out SR",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+	{ .index = LOUDNESS_OUT_DUAL_MONO,
+	  .name = "Out DUAL MONO",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_AUDIO,
+	},
+
+	{ .index = LOUDNESS_OUT_MOMENTARY,
+	  .name = "Momentary LUFS",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = LOUDNESS_OUT_SHORTTERM,
+	  .name = "Shortterm LUFS",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = LOUDNESS_OUT_GLOBAL,
+	  .name = "Global LUFS",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = LOUDNESS_OUT_WINDOW,
+	  .name = "Window LUFS",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = LOUDNESS_OUT_RANGE,
+	  .name = "Range LU",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = LOUDNESS_OUT_PEAK,
+	  .name = "Peak",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+	{ .index = LOUDNESS_OUT_TRUE_PEAK,
+	  .name = "True Peak",
+	  .flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL,
+	},
+};
+
+static const struct spa_fga_descriptor loudness_desc = {
+	.name = "loudness",
+	.flags = SPA_FGA_DESCRIPTOR_SUPPORTS_NULL_DATA,
+
+	.n_ports = SPA_N_ELEMENTS(loudness_ports),
+	.ports = loudness_ports,
+
+	.instantiate = loudness_instantiate,
+	.connect_port = loudness_connect_port,
+	.activate = loudness_activate,
+	.run = loudness_run,
+	.cleanup = loudness_cleanup,
+};
+
 static const struct spa_fga_descriptor * builtin_descriptor(unsigned long Index)
 {
 	switch(Index) {
@@ -3315,6 +3752,8 @@ static const struct spa_fga_descriptor * builtin_descriptor(unsigned long Index)
 		return &busy_desc;
 	case 32:
 		return &null_desc;
+	case 33:
+		return &loudness_desc;
 	}
 	return NULL;
 }
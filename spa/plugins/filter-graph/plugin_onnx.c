@@ -8,12 +8,15 @@
 #include <math.h>
 #include <limits.h>
 #include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include <spa/utils/result.h>
 #include <spa/utils/defs.h>
 #include <spa/utils/list.h>
 #include <spa/utils/string.h>
 #include <spa/utils/json.h>
+#include <spa/utils/atomic.h>
 #include <spa/support/log.h>
 
 #include <onnxruntime/onnxruntime_c_api.h>
@@ -22,6 +25,8 @@
 
 #define MAX_PORTS	256
 #define MAX_CTX		64
+#define MAX_BATCH	64
+#define N_SETS		2
 
 const OrtApi* ort = NULL;
 
@@ -38,6 +43,26 @@ struct plugin {
 	OrtEnv *env;
 	OrtAllocator *allocator;
 	OrtSessionOptions *session_options;
+
+	struct spa_list models;
+};
+
+/* one session per model file, shared by all descriptors and instances using it */
+struct model {
+	struct spa_list link;
+	struct plugin *p;
+	int ref;
+
+	char path[PATH_MAX];
+	OrtSession *session;
+
+	pthread_mutex_t lock;
+	struct spa_list instances;
+
+	pthread_t thread;
+	sem_t wakeup;
+	bool started;
+	int running;
 };
 
 struct tensor_info {
@@ -48,6 +73,7 @@ struct tensor_info {
 	int64_t dimensions[64];
 	size_t n_dimensions;
 	int retain;
+	bool dynamic_batch;
 #define DATA_NONE		0
 #define DATA_PORT		1
 #define DATA_CONTROL		2
@@ -64,18 +90,43 @@ struct descriptor {
 	struct plugin *p;
 
 	int blocksize;
-	OrtSession *session;
+	bool async;
+	bool batch;
+	struct model *model;
 	struct tensor_info tensors[MAX_PORTS];
 	size_t n_tensors;
+	uint32_t latency_idx;
 };
 
+#define SET_IDLE	0
+#define SET_QUEUED	1
+#define SET_DONE	2
+
 struct instance {
 	struct descriptor *desc;
+	struct spa_list link;
 
 	uint32_t rate;
 
 	OrtRunOptions *run_options;
-	OrtValue *tensor[MAX_PORTS];
+	/* in async mode, the data thread fills one set while the worker
+	 * runs the model on the other one */
+	OrtValue *tensor[N_SETS][MAX_PORTS];
+	uint32_t n_sets;
+	int state[N_SETS];
+	uint64_t seq[N_SETS];
+
+	/* data thread */
+	uint64_t submit_seq;
+	uint32_t current;
+	uint32_t filled;
+	bool dropped;
+	bool ready;
+	uint32_t overruns;
+
+	/* worker thread */
+	uint32_t last;
+	int pending;
 
 	uint32_t offset;
 	float *data[MAX_PORTS];
@@ -258,6 +309,296 @@ static int set_value(void *data, enum ONNXTensorElementDataType type, double val
 	}
 	return 0;
 }
+
+static size_t type_size(enum ONNXTensorElementDataType type)
+{
+	switch (type) {
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8:
+		return 1;
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_BOOL:
+		return sizeof(bool);
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT16:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT16:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16:
+		return 2;
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT32:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT:
+		return 4;
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT64:
+	case ONNX_TENSOR_ELEMENT_DATA_TYPE_DOUBLE:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static inline size_t tensor_bytes(struct tensor_info *ti)
+{
+	return ti->data_size * type_size(ti->type);
+}
+
+static void log_status(struct plugin *p, OrtStatus *status)
+{
+	const char* msg = ort->GetErrorMessage(status);
+	spa_log_error(p->log, "%s", msg);
+	ort->ReleaseStatus(status);
+}
+
+/* Run the model on the given set of each instance. All instances must use
+ * the same descriptor. When there is more than one instance, the tensors
+ * are stacked along their (dynamic) first dimension and the model is
+ * executed only once. */
+static int run_blocks(struct model *m, struct instance **inst, uint32_t *sets, uint32_t n_inst)
+{
+	OrtStatus *status;
+	struct descriptor *d = inst[0]->desc;
+	struct plugin *p = m->p;
+	const char *input_names[MAX_PORTS];
+	const OrtValue *inputs[MAX_PORTS];
+	const char *output_names[MAX_PORTS];
+	OrtValue *outputs[MAX_PORTS];
+	OrtValue *batch[MAX_PORTS] = { NULL, };
+	size_t n, n_inputs = 0, n_outputs = 0;
+	uint32_t b;
+	int res = 0;
+
+	/* feed back the state of the last block that was run */
+	for (b = 0; b < n_inst; b++) {
+		struct instance *i = inst[b];
+		for (n = 0; n < d->n_tensors; n++) {
+			struct tensor_info *ti = &d->tensors[n];
+			void *src, *dst;
+			if (ti->direction != SPA_DIRECTION_INPUT ||
+			    ti->data_type != DATA_TENSOR)
+				continue;
+			CHECK(ort->GetTensorMutableData(i->tensor[i->last][ti->data_index], &src));
+			CHECK(ort->GetTensorMutableData(i->tensor[sets[b]][ti->index], &dst));
+			memmove(dst, src, tensor_bytes(ti));
+		}
+	}
+
+	for (n = 0; n < d->n_tensors; n++) {
+		struct tensor_info *ti = &d->tensors[n];
+		OrtValue *t = inst[0]->tensor[sets[0]][ti->index];
+
+		if (n_inst > 1) {
+			int64_t dimensions[64];
+			size_t size = tensor_bytes(ti);
+			uint8_t *dst;
+
+			memcpy(dimensions, ti->dimensions, ti->n_dimensions * sizeof(int64_t));
+			dimensions[0] = n_inst;
+			CHECK(ort->CreateTensorAsOrtValue(p->allocator, dimensions, ti->n_dimensions,
+					ti->type, &batch[n]));
+			t = batch[n];
+
+			if (ti->direction == SPA_DIRECTION_INPUT) {
+				CHECK(ort->GetTensorMutableData(t, (void**)&dst));
+				for (b = 0; b < n_inst; b++) {
+					void *src;
+					CHECK(ort->GetTensorMutableData(inst[b]->tensor[sets[b]][ti->index], &src));
+					memcpy(dst + b * size, src, size);
+				}
+			}
+		}
+		if (ti->direction == SPA_DIRECTION_INPUT) {
+			input_names[n_inputs] = ti->name;
+			inputs[n_inputs++] = t;
+		} else {
+			output_names[n_outputs] = ti->name;
+			outputs[n_outputs++] = t;
+		}
+	}
+
+	CHECK(ort->Run(m->session, inst[0]->run_options,
+			input_names, (const OrtValue *const*)inputs, n_inputs,
+			output_names, n_outputs, (OrtValue **)outputs));
+
+	if (n_inst > 1) {
+		for (n = 0; n < d->n_tensors; n++) {
+			struct tensor_info *ti = &d->tensors[n];
+			size_t size = tensor_bytes(ti);
+			uint8_t *src;
+
+			if (ti->direction != SPA_DIRECTION_OUTPUT)
+				continue;
+
+			CHECK(ort->GetTensorMutableData(batch[n], (void**)&src));
+			for (b = 0; b < n_inst; b++) {
+				void *dst;
+				CHECK(ort->GetTensorMutableData(inst[b]->tensor[sets[b]][ti->index], &dst));
+				memcpy(dst, src + b * size, size);
+			}
+		}
+	}
+done:
+	for (n = 0; n < d->n_tensors; n++) {
+		if (batch[n])
+			ort->ReleaseValue(batch[n]);
+	}
+	for (b = 0; b < n_inst; b++)
+		inst[b]->last = sets[b];
+	return res;
+
+error_onnx:
+	log_status(p, status);
+	res = -EIO;
+	goto done;
+}
+
+/* the oldest queued set of the instance or -1 */
+static int find_queued(struct instance *i)
+{
+	int set = -1;
+	uint32_t n;
+
+	for (n = 0; n < i->n_sets; n++) {
+		if (SPA_ATOMIC_LOAD(i->state[n]) != SET_QUEUED)
+			continue;
+		if (set < 0 || i->seq[n] < i->seq[set])
+			set = n;
+	}
+	return set;
+}
+
+/* must be called with the model lock held */
+static uint32_t model_process(struct model *m)
+{
+	struct instance *i, *j;
+	struct instance *inst[MAX_BATCH];
+	uint32_t sets[MAX_BATCH];
+	uint32_t b, n_inst, count = 0;
+
+	spa_list_for_each(i, &m->instances, link)
+		i->pending = find_queued(i);
+
+	spa_list_for_each(i, &m->instances, link) {
+		if (i->pending < 0)
+			continue;
+
+		n_inst = 0;
+		inst[n_inst] = i;
+		sets[n_inst++] = i->pending;
+		i->pending = -1;
+
+		if (i->desc->batch) {
+			spa_list_for_each(j, &m->instances, link) {
+				if (n_inst >= MAX_BATCH)
+					break;
+				if (j->pending < 0 || j->desc != i->desc)
+					continue;
+				inst[n_inst] = j;
+				sets[n_inst++] = j->pending;
+				j->pending = -1;
+			}
+		}
+		run_blocks(m, inst, sets, n_inst);
+
+		for (b = 0; b < n_inst; b++)
+			SPA_ATOMIC_STORE(inst[b]->state[sets[b]], SET_DONE);
+		count += n_inst;
+	}
+	return count;
+}
+
+static void *model_worker(void *data)
+{
+	struct model *m = data;
+
+	while (true) {
+		if (sem_wait(&m->wakeup) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (!SPA_ATOMIC_LOAD(m->running))
+			break;
+
+		pthread_mutex_lock(&m->lock);
+		while (model_process(m) > 0);
+		pthread_mutex_unlock(&m->lock);
+	}
+	return NULL;
+}
+
+static int model_start(struct model *m)
+{
+	int res;
+
+	if (m->started)
+		return 0;
+
+	if (sem_init(&m->wakeup, 0, 0) < 0)
+		return -errno;
+
+	m->running = 1;
+	if ((res = pthread_create(&m->thread, NULL, model_worker, m)) != 0) {
+		spa_log_error(m->p->log, "onnx: can't create worker thread: %s",
+				strerror(res));
+		sem_destroy(&m->wakeup);
+		return -res;
+	}
+	m->started = true;
+	return 0;
+}
+
+static struct model *model_acquire(struct plugin *p, const char *path)
+{
+	OrtStatus *status;
+	struct model *m;
+
+	spa_list_for_each(m, &p->models, link) {
+		if (spa_streq(m->path, path)) {
+			m->ref++;
+			return m;
+		}
+	}
+
+	m = calloc(1, sizeof(*m));
+	if (m == NULL)
+		return NULL;
+
+	m->p = p;
+	m->ref = 1;
+	spa_scnprintf(m->path, sizeof(m->path), "%s", path);
+	spa_list_init(&m->instances);
+
+	spa_log_info(p->log, "onnx: loading model %s", path);
+	CHECK(ort->CreateSession(p->env, path, p->session_options, &m->session));
+
+	pthread_mutex_init(&m->lock, NULL);
+	spa_list_append(&p->models, &m->link);
+
+	return m;
+
+error_onnx:
+	log_status(p, status);
+	free(m);
+	errno = EINVAL;
+	return NULL;
+}
+
+static void model_release(struct model *m)
+{
+	if (--m->ref > 0)
+		return;
+
+	if (m->started) {
+		SPA_ATOMIC_STORE(m->running, 0);
+		sem_post(&m->wakeup);
+		pthread_join(m->thread, NULL);
+		sem_destroy(&m->wakeup);
+	}
+	spa_list_remove(&m->link);
+	pthread_mutex_destroy(&m->lock);
+	ort->ReleaseSession(m->session);
+	free(m);
+}
+
 /*
  * config = {
  *   blocksize = 512
@@ -277,9 +618,10 @@ static void *onnx_instantiate(const struct spa_fga_plugin *plugin, const struct
 {
 	struct descriptor *d = (struct descriptor *)desc;
 	struct plugin *p = d->p;
+	struct model *m = d->model;
 	struct instance *i;
 	OrtStatus *status;
-	size_t n, j;
+	size_t n, j, s;
 	int res;
 
 	errno = EINVAL;
@@ -290,10 +632,10 @@ static void *onnx_instantiate(const struct spa_fga_plugin *plugin, const struct
 
 	i->desc = d;
 	i->rate = SampleRate;
+	i->n_sets = d->async ? N_SETS : 1;
 
 	for (n = 0; n < d->n_tensors; n++) {
 		struct tensor_info *ti = &d->tensors[n];
-		void *data;
 
 		spa_log_debug(p->log, "%zd %s %zd", n, ti->name, ti->n_dimensions);
 		ti->data_size = 1;
@@ -304,25 +646,38 @@ static void *onnx_instantiate(const struct spa_fga_plugin *plugin, const struct
 				ti->data_size *= ti->dimensions[j];
 
 		}
-		CHECK(ort->CreateTensorAsOrtValue(p->allocator, ti->dimensions, ti->n_dimensions,
-				ti->type, &i->tensor[n]));
-		CHECK(ort->GetTensorMutableData(i->tensor[n], (void**)&data));
-
-		if (ti->data_type == DATA_PARAM_RATE) {
-			if ((res = set_value(data, ti->type, (double)i->rate)) < 0) {
-				errno = -res;
-				goto error;
+		for (s = 0; s < i->n_sets; s++) {
+			void *data;
+
+			CHECK(ort->CreateTensorAsOrtValue(p->allocator, ti->dimensions, ti->n_dimensions,
+					ti->type, &i->tensor[s][n]));
+			CHECK(ort->GetTensorMutableData(i->tensor[s][n], (void**)&data));
+			memset(data, 0, tensor_bytes(ti));
+
+			if (ti->data_type == DATA_PARAM_RATE) {
+				if ((res = set_value(data, ti->type, (double)i->rate)) < 0) {
+					errno = -res;
+					goto error;
+				}
 			}
-
 		}
 	}
+	if (d->async) {
+		pthread_mutex_lock(&m->lock);
+		spa_list_append(&m->instances, &i->link);
+		pthread_mutex_unlock(&m->lock);
+	}
 	return i;
 
 error_onnx:
-	const char* msg = ort->GetErrorMessage(status);
-	spa_log_error(p->log, "%s", msg);
-	ort->ReleaseStatus(status);
+	log_status(p, status);
 error:
+	for (s = 0; s < i->n_sets; s++) {
+		for (n = 0; n < d->n_tensors; n++) {
+			if (i->tensor[s][n])
+				ort->ReleaseValue(i->tensor[s][n]);
+		}
+	}
 	free(i);
 	return NULL;
 }
@@ -330,12 +685,33 @@ error:
 static void onnx_cleanup(void *instance)
 {
 	struct instance *i = instance;
+	struct descriptor *d = i->desc;
+	struct model *m = d->model;
+	size_t n, s;
+
+	if (d->async) {
+		/* waits for the worker to finish with our tensors */
+		pthread_mutex_lock(&m->lock);
+		spa_list_remove(&i->link);
+		pthread_mutex_unlock(&m->lock);
+	}
+	for (s = 0; s < i->n_sets; s++) {
+		for (n = 0; n < d->n_tensors; n++) {
+			if (i->tensor[s][n])
+				ort->ReleaseValue(i->tensor[s][n]);
+		}
+	}
+	if (i->overruns > 0)
+		spa_log_info(d->p->log, "onnx: %u blocks dropped, worker too slow",
+				i->overruns);
 	free(i);
 }
 
 static void onnx_free(const struct spa_fga_descriptor *desc)
 {
 	struct descriptor *d = (struct descriptor*)desc;
+	if (d->model)
+		model_release(d->model);
 	free((char*)d->desc.name);
 	free(d->desc.ports);
 	free(d);
@@ -353,90 +729,166 @@ static void move_samples(float *dst, uint32_t dst_offs, float *src, uint32_t src
 		SPA_PTROFF(src, src_offs * sizeof(float), void), n_samples * sizeof(float));
 }
 
-static void onnx_run(void *instance, unsigned long SampleCount)
+/* Copy the port data into the input tensors of set. At the start of a block,
+ * the retained samples are taken from the last filled set. */
+static int fill_inputs(struct instance *i, uint32_t set, uint32_t offset,
+		uint32_t pos, uint32_t chunk)
 {
 	OrtStatus *status;
-	struct instance *i = instance;
 	struct descriptor *d = i->desc;
-	struct plugin *p = d->p;
-	const char *input_names[MAX_PORTS];
-	const OrtValue *inputs[MAX_PORTS];
-	const char *output_names[MAX_PORTS];
-	OrtValue *outputs[MAX_PORTS];
-	size_t n, n_inputs = 0, n_outputs = 0;
-	float *data;
-	uint32_t offset = i->offset, blocksize = d->blocksize;
+	size_t n;
+	float *data, *prev;
 
-	while (SampleCount > 0) {
-		uint32_t chunk = SPA_MIN(SampleCount, blocksize - offset);
-		uint32_t next_offset;
+	for (n = 0; n < d->n_tensors; n++) {
+		struct tensor_info *ti = &d->tensors[n];
+		if (ti->direction != SPA_DIRECTION_INPUT ||
+		    ti->data_type != DATA_PORT)
+			continue;
 
-		for (n = 0; n < d->n_tensors; n++) {
-			struct tensor_info *ti = &d->tensors[n];
-			if (ti->direction == SPA_DIRECTION_INPUT) {
-				input_names[n_inputs] = ti->name;
-				inputs[n_inputs++] = i->tensor[ti->index];
+		CHECK(ort->GetTensorMutableData(i->tensor[set][ti->index], (void**)&data));
 
-				if (ti->data_type == DATA_PORT) {
-					CHECK(ort->GetTensorMutableData(i->tensor[ti->index], (void**)&data));
+		if (ti->retain > 0 && offset == 0) {
+			CHECK(ort->GetTensorMutableData(i->tensor[i->filled][ti->index], (void**)&prev));
+			move_samples(data, 0, prev, ti->data_size - ti->retain, ti->retain);
+		}
+		move_samples(data, ti->retain + offset, i->data[ti->data_index], pos, chunk);
+	}
+	return 0;
 
-					if (ti->retain > 0 && offset == 0)
-						move_samples(data, 0, data, ti->data_size - ti->retain, ti->retain);
+error_onnx:
+	log_status(d->p, status);
+	return -EIO;
+}
 
-					move_samples(data, ti->retain + offset,
-							i->data[ti->data_index], offset, chunk);
-				}
-				else if (ti->data_type == DATA_TENSOR) {
-					if (offset == 0) {
-						void *src, *dst;
-						CHECK(ort->GetTensorMutableData(i->tensor[ti->data_index], &src));
-						CHECK(ort->GetTensorMutableData(i->tensor[ti->index], &dst));
-						move_samples(dst, 0, src, 0, ti->data_size);
-					}
-				}
+/* Copy the output tensors of set to the ports, or silence when the
+ * set has no valid output. Controls are only copied when requested. */
+static int copy_outputs(struct instance *i, uint32_t set, bool valid, bool controls,
+		uint32_t offset, uint32_t pos, uint32_t chunk)
+{
+	OrtStatus *status;
+	struct descriptor *d = i->desc;
+	size_t n;
+	float *data;
+
+	for (n = 0; n < d->n_tensors; n++) {
+		struct tensor_info *ti = &d->tensors[n];
+		float *dst = i->data[ti->data_index];
+
+		if (ti->direction != SPA_DIRECTION_OUTPUT || dst == NULL)
+			continue;
+
+		if (ti->data_type == DATA_CONTROL) {
+			if (valid && controls) {
+				CHECK(ort->GetTensorMutableData(i->tensor[set][ti->index], (void**)&data));
+				if (data)
+					dst[0] = data[0];
+			}
+		}
+		else if (ti->data_type == DATA_PORT) {
+			if (valid) {
+				CHECK(ort->GetTensorMutableData(i->tensor[set][ti->index], (void**)&data));
+				move_samples(dst, pos, data, offset, chunk);
 			} else {
-				output_names[n_outputs] = ti->name;
-				outputs[n_outputs++] = i->tensor[ti->index];
+				memset(&dst[pos], 0, chunk * sizeof(float));
 			}
 		}
+	}
+	return 0;
+
+error_onnx:
+	log_status(d->p, status);
+	return -EIO;
+}
+
+static void onnx_run_sync(struct instance *i, unsigned long SampleCount)
+{
+	struct descriptor *d = i->desc;
+	uint32_t offset = i->offset, blocksize = d->blocksize, pos = 0, set = 0;
+
+	while (SampleCount > 0) {
+		uint32_t chunk = SPA_MIN(SampleCount, blocksize - offset);
+		uint32_t next_offset;
+
+		fill_inputs(i, set, offset, pos, chunk);
+
 		if (offset + chunk >= blocksize) {
-			CHECK(ort->Run(d->session, i->run_options,
-					input_names, (const OrtValue *const*)inputs, n_inputs,
-					output_names, n_outputs, (OrtValue **)outputs));
+			run_blocks(d->model, &i, &set, 1);
 			next_offset = 0;
 		} else {
 			next_offset = offset + chunk;
 		}
+		/* controls are only updated after a run */
+		copy_outputs(i, set, true, next_offset == 0, offset, pos, chunk);
 
-		for (n = 0; n < d->n_tensors; n++) {
-			struct tensor_info *ti = &d->tensors[n];
-			if (ti->direction != SPA_DIRECTION_OUTPUT)
-				continue;
+		SampleCount -= chunk;
+		pos += chunk;
+		offset = next_offset;
+	}
+	i->offset = offset;
+}
 
-			if (ti->data_type == DATA_CONTROL) {
-				if (next_offset == 0) {
-					float *src, *dst;
-					CHECK(ort->GetTensorMutableData(i->tensor[ti->index], (void**)&src));
-					dst = i->data[ti->data_index];
-					if (src && dst)
-						dst[0] = src[0];
-				}
-			}
-			else if (ti->data_type == DATA_PORT) {
-				CHECK(ort->GetTensorMutableData(i->tensor[ti->index], (void**)&data));
-				move_samples(i->data[ti->data_index], offset, data, offset, chunk);
+/* The data thread fills one set while the worker runs the model on the other
+ * set. The output of a set is played while the set is being filled again, which
+ * adds 2 blocks of latency. When the worker is late with a set, the block is
+ * dropped and silence is produced. */
+static void onnx_run_async(struct instance *i, unsigned long SampleCount)
+{
+	struct descriptor *d = i->desc;
+	struct model *m = d->model;
+	uint32_t offset = i->offset, blocksize = d->blocksize, pos = 0;
+	uint32_t set = i->current;
+
+	while (SampleCount > 0) {
+		uint32_t chunk = SPA_MIN(SampleCount, blocksize - offset);
+
+		if (offset == 0) {
+			int state = SPA_ATOMIC_LOAD(i->state[set]);
+			i->dropped = state == SET_QUEUED;
+			i->ready = state == SET_DONE;
+			if (i->dropped)
+				i->overruns++;
+		}
+		if (!i->dropped)
+			fill_inputs(i, set, offset, pos, chunk);
+
+		copy_outputs(i, set, i->ready, true, offset, pos, chunk);
+
+		if (offset + chunk >= blocksize) {
+			if (!i->dropped) {
+				i->seq[set] = ++i->submit_seq;
+				i->filled = set;
+				SPA_ATOMIC_STORE(i->state[set], SET_QUEUED);
+				sem_post(&m->wakeup);
 			}
+			set = (set + 1) % N_SETS;
+			offset = 0;
+		} else {
+			offset += chunk;
 		}
 		SampleCount -= chunk;
-		offset = next_offset;
+		pos += chunk;
 	}
+	i->current = set;
 	i->offset = offset;
-	return;
+}
 
-error_onnx:
-	const char* msg = ort->GetErrorMessage(status);
-	spa_log_error(p->log, "%s", msg);
-	ort->ReleaseStatus(status);
+static void onnx_activate(void *instance)
+{
+	struct instance *i = instance;
+	struct descriptor *d = i->desc;
+
+	if (d->async && i->data[d->latency_idx] != NULL)
+		i->data[d->latency_idx][0] = N_SETS * d->blocksize;
+}
+
+static void onnx_run(void *instance, unsigned long SampleCount)
+{
+	struct instance *i = instance;
+
+	if (i->desc->async)
+		onnx_run_async(i, SampleCount);
+	else
+		onnx_run_sync(i, SampleCount);
 }
 
 static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, const char *name)
@@ -444,6 +896,7 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 	OrtStatus *status;
 	struct plugin *p = (struct plugin *)plugin;
 	struct descriptor *desc;
+	OrtSession *session;
 	size_t i, j, n_inputs, n_outputs;
 	OrtTypeInfo *tinfo;
 	const OrtTensorTypeAndShapeInfo *tt;
@@ -472,16 +925,18 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 	desc->desc.cleanup = onnx_cleanup;
 	desc->desc.free = onnx_free;
 	desc->desc.connect_port = onnx_connect_port;
+	desc->desc.activate = onnx_activate;
 	desc->desc.run = onnx_run;
 
 	desc->desc.name = strdup(name);
 	desc->desc.flags = 0;
 
-	spa_log_info(p->log, "onnx: loading model %s", path);
-	CHECK(ort->CreateSession(p->env, path, p->session_options, &desc->session));
+	if ((desc->model = model_acquire(p, path)) == NULL)
+		goto error;
+	session = desc->model->session;
 
-	CHECK(ort->SessionGetInputCount(desc->session, &n_inputs));
-	CHECK(ort->SessionGetOutputCount(desc->session, &n_outputs));
+	CHECK(ort->SessionGetInputCount(session, &n_inputs));
+	CHECK(ort->SessionGetOutputCount(session, &n_outputs));
 
 	spa_log_info(p->log, "found %zd input and %zd output tensors", n_inputs, n_outputs);
 
@@ -491,9 +946,9 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 
 		ti->index = i;
 		ti->direction = SPA_DIRECTION_INPUT;
-		CHECK(ort->SessionGetInputName(desc->session, i, p->allocator, (char**)&ti->name));
+		CHECK(ort->SessionGetInputName(session, i, p->allocator, (char**)&ti->name));
 
-		CHECK(ort->SessionGetInputTypeInfo(desc->session, i, &tinfo));
+		CHECK(ort->SessionGetInputTypeInfo(session, i, &tinfo));
 		CHECK(ort->CastTypeInfoToTensorInfo(tinfo, &tt));
 
 		CHECK(ort->GetTensorElementType(tt, &ti->type));
@@ -504,6 +959,7 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 			goto error;
 		}
 		CHECK(ort->GetDimensions(tt, ti->dimensions, ti->n_dimensions));
+		ti->dynamic_batch = ti->n_dimensions > 0 && ti->dimensions[0] < 0;
 
 		spa_log_debug(p->log, "%zd %s %zd", i, ti->name, ti->n_dimensions);
 		for (j = 0; j < ti->n_dimensions; j++) {
@@ -516,9 +972,9 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 
 		ti->index = i + n_inputs;
 		ti->direction = SPA_DIRECTION_OUTPUT;
-		CHECK(ort->SessionGetOutputName(desc->session, i, p->allocator, (char**)&ti->name));
+		CHECK(ort->SessionGetOutputName(session, i, p->allocator, (char**)&ti->name));
 
-		CHECK(ort->SessionGetOutputTypeInfo(desc->session, i, &tinfo));
+		CHECK(ort->SessionGetOutputTypeInfo(session, i, &tinfo));
 		CHECK(ort->CastTypeInfoToTensorInfo(tinfo, &tt));
 
 		CHECK(ort->GetTensorElementType(tt, &ti->type));
@@ -529,6 +985,7 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 			goto error;
 		}
 		CHECK(ort->GetDimensions(tt, ti->dimensions, ti->n_dimensions));
+		ti->dynamic_batch = ti->n_dimensions > 0 && ti->dimensions[0] < 0;
 
 		spa_log_debug(p->log, "%zd %s %zd", i, ti->name, ti->n_dimensions);
 		for (j = 0; j < ti->n_dimensions; j++) {
@@ -547,6 +1004,20 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 				goto error;
 			}
 		}
+		else if (spa_streq(key, "async")) {
+			if (spa_json_parse_bool(val, len, &desc->async) <= 0) {
+				spa_log_error(p->log, "onnx:async requires a boolean");
+				errno = EINVAL;
+				goto error;
+			}
+		}
+		else if (spa_streq(key, "batch")) {
+			if (spa_json_parse_bool(val, len, &desc->batch) <= 0) {
+				spa_log_error(p->log, "onnx:batch requires a boolean");
+				errno = EINVAL;
+				goto error;
+			}
+		}
 		else if (spa_streq(key, "input-tensors")) {
 			if (!spa_json_is_object(val, len)) {
 				spa_log_error(p->log, "onnx: %s expects an object", key);
@@ -567,7 +1038,35 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 		}
 	}
 
-	desc->desc.ports = calloc(desc->n_tensors, sizeof(struct spa_fga_port));
+	if (desc->blocksize <= 0) {
+		spa_log_error(p->log, "onnx: invalid blocksize %d", desc->blocksize);
+		errno = EINVAL;
+		goto error;
+	}
+	if (desc->batch) {
+		/* instances are stacked in the first dimension, it must be
+		 * dynamic in the model and 1 for each instance */
+		for (i = 0; i < desc->n_tensors; i++) {
+			struct tensor_info *ti = &desc->tensors[i];
+			if (!ti->dynamic_batch || ti->dimensions[0] != 1) {
+				spa_log_warn(p->log, "onnx: tensor %s can't be batched, "
+						"disabling batching", ti->name);
+				desc->batch = false;
+				break;
+			}
+		}
+		/* batching happens in the worker thread */
+		desc->async = true;
+	}
+	if (desc->async && model_start(desc->model) < 0) {
+		errno = EIO;
+		goto error;
+	}
+
+	/* one extra port for the latency */
+	desc->desc.ports = calloc(desc->n_tensors + 1, sizeof(struct spa_fga_port));
+	if (desc->desc.ports == NULL)
+		goto error;
 	desc->desc.n_ports = 0;
 
 	/* make ports */
@@ -596,12 +1095,21 @@ static const struct spa_fga_descriptor *onnx_plugin_make_desc(void *plugin, cons
 		ti->data_index = desc->desc.n_ports;
 
 		desc->desc.n_ports++;
-		if (desc->desc.n_ports > MAX_PORTS) {
+		/* the latency port of async mode also needs a slot */
+		if (desc->desc.n_ports + (desc->async ? 1 : 0) > MAX_PORTS) {
 			spa_log_error(p->log, "too many ports");
-			errno = -ENOSPC;
+			errno = ENOSPC;
 			goto error;
 		}
 	}
+	if (desc->async) {
+		struct spa_fga_port *fp = &desc->desc.ports[desc->desc.n_ports];
+		fp->index = desc->desc.n_ports;
+		fp->name = "latency";
+		fp->flags = SPA_FGA_PORT_OUTPUT | SPA_FGA_PORT_CONTROL;
+		fp->hint = SPA_FGA_HINT_LATENCY;
+		desc->latency_idx = desc->desc.n_ports++;
+	}
 	return &desc->desc;
 
 error_onnx:
@@ -610,8 +1118,6 @@ error_onnx:
 	ort->ReleaseStatus(status);
 
 error:
-	if (desc->session)
-		ort->ReleaseSession(desc->session);
 	onnx_free(&desc->desc);
 	return NULL;
 }
@@ -702,6 +1208,7 @@ impl_init(const struct spa_handle_factory *factory,
 	impl = (struct plugin *) handle;
 
 	impl->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	spa_list_init(&impl->models);
 
 	for (i = 0; info && i < info->n_items; i++) {
 		const char *k = info->items[i].key;
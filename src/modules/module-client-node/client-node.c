@@ -850,7 +850,7 @@ do_port_use_buffers(struct impl *impl,
 
 		mb[i].buffer = &b->buffer;
 		mb[i].mem_id = m->id;
-		mb[i].offset = SPA_PTRDIFF(baseptr, mem->map->ptr);
+		mb[i].offset = SPA_PTRDIFF(baseptr, mem->map->ptr) + mem->map->offset;
 		mb[i].size = SPA_PTRDIFF(endptr, baseptr);
 		spa_log_debug(impl->log, "%p: buffer %d %d %d %d", impl, i, mb[i].mem_id,
 				mb[i].offset, mb[i].size);
@@ -1370,7 +1370,8 @@ static int add_area(struct impl *impl)
 	area = pw_mempool_alloc(impl->context_pool,
 			PW_MEMBLOCK_FLAG_READWRITE |
 			PW_MEMBLOCK_FLAG_SEAL |
-			PW_MEMBLOCK_FLAG_MAP,
+			PW_MEMBLOCK_FLAG_MAP |
+			(impl->context->settings.mem_allow_mlock ? PW_MEMBLOCK_FLAG_RT : 0),
 			SPA_DATA_MemFd, size);
 	if (area == NULL)
                 return -errno;
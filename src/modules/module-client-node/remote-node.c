@@ -178,6 +178,38 @@ static struct mix *create_mix(struct node_data *data, struct pw_impl_port *port,
 	return mix;
 }
 
+/* memory used from the data loop is prefaulted and, when allowed, locked */
+static inline uint32_t rt_map_flags(struct node_data *data)
+{
+	return PW_MEMMAP_FLAG_READWRITE |
+		(data->allow_mlock ? PW_MEMMAP_FLAG_RT : PW_MEMMAP_FLAG_POPULATE);
+}
+
+static uint64_t get_lock_failures(struct node_data *data)
+{
+	struct pw_mempool_stats stats;
+
+	if (pw_mempool_get_stats(data->pool, &stats) < 0)
+		return 0;
+	return stats.lock_failures;
+}
+
+static void check_mlock(struct node_data *data, uint64_t failures)
+{
+	struct pw_mempool_stats stats;
+
+	if (mlock_warned || pw_mempool_get_stats(data->pool, &stats) < 0 ||
+	    stats.lock_failures == failures)
+		return;
+
+	pw_log(data->warn_mlock ? SPA_LOG_LEVEL_WARN : SPA_LOG_LEVEL_DEBUG,
+			"Failed to mlock memory, locked %" PRIu64 " of %" PRIu64 " bytes: "
+			"This is not a problem but for best performance, "
+			"consider increasing RLIMIT_MEMLOCK or mem.lock-budget",
+			stats.locked_total, stats.lock_budget);
+	mlock_warned = true;
+}
+
 static int client_node_transport(void *_data,
 			int readfd, int writefd, uint32_t mem_id, uint32_t offset, uint32_t size)
 {
@@ -188,7 +220,7 @@ static int client_node_transport(void *_data,
 	clean_transport(data);
 
 	data->activation = pw_mempool_map_id(data->pool, mem_id,
-				PW_MEMMAP_FLAG_READWRITE, offset, size, NULL);
+				rt_map_flags(data), offset, size, NULL);
 	if (data->activation == NULL) {
 		pw_log_warn("remote-node %p: can't map activation: %m", proxy);
 		return -errno;
@@ -418,7 +450,7 @@ client_node_set_io(void *_data,
 		size = 0;
 	} else {
 		mm = pw_mempool_map_id(data->pool, memid,
-				PW_MEMMAP_FLAG_READWRITE, offset, size, tag);
+				rt_map_flags(data), offset, size, tag);
 		if (mm == NULL) {
 			pw_log_warn("can't map memory id %u: %m", memid);
 			res = -errno;
@@ -594,7 +626,8 @@ client_node_port_use_buffers(void *_data,
 	uint32_t i, j;
 	struct spa_buffer *b, **bufs;
 	struct mix *mix;
-	int res, prot;
+	uint64_t lock_failures;
+	int res;
 
 	mix = find_mix(data, direction, port_id, mix_id);
 	if (mix == NULL) {
@@ -605,7 +638,7 @@ client_node_port_use_buffers(void *_data,
 	if (n_buffers > MAX_BUFFERS)
 		return -ENOSPC;
 
-	prot = PW_MEMMAP_FLAG_READWRITE;
+	lock_failures = get_lock_failures(data);
 
 	/* clear previous buffers */
 	clear_buffers(data, mix);
@@ -618,7 +651,8 @@ client_node_port_use_buffers(void *_data,
 		struct pw_memmap *mm;
 
 		mm = pw_mempool_map_id(data->pool, buffers[i].mem_id,
-				prot, buffers[i].offset, buffers[i].size, NULL);
+				rt_map_flags(data), buffers[i].offset,
+				buffers[i].size, NULL);
 		if (mm == NULL) {
 			res = -errno;
 			goto error_exit_cleanup;
@@ -632,17 +666,6 @@ client_node_port_use_buffers(void *_data,
 		bid->id = i;
 		bid->mem = mm;
 
-		if (data->allow_mlock && mlock(mm->ptr, mm->size) < 0)
-			if (errno != ENOMEM || !mlock_warned) {
-				pw_log(data->warn_mlock ? SPA_LOG_LEVEL_WARN : SPA_LOG_LEVEL_DEBUG,
-						"Failed to mlock memory %p %u: %s",
-						mm->ptr, mm->size,
-						errno == ENOMEM ?
-						"This is not a problem but for best performance, "
-						"consider increasing RLIMIT_MEMLOCK" : strerror(errno));
-				mlock_warned |= errno == ENOMEM;
-			}
-
 		size = sizeof(struct spa_buffer);
 		for (j = 0; j < buffers[i].buffer->n_metas; j++)
 			size += sizeof(struct spa_meta);
@@ -711,6 +734,7 @@ client_node_port_use_buffers(void *_data,
 		}
 		bufs[i] = b;
 	}
+	check_mlock(data, lock_failures);
 
 	if ((res = pw_impl_port_use_buffers(mix->port, &mix->mix, flags, bufs, n_buffers)) < 0)
 		goto error_exit_cleanup;
@@ -765,7 +789,7 @@ client_node_port_set_io(void *_data,
 	}
 	else {
 		mm = pw_mempool_map_id(data->pool, memid,
-				PW_MEMMAP_FLAG_READWRITE, offset, size, tag);
+				rt_map_flags(data), offset, size, tag);
 		if (mm == NULL) {
 			pw_log_warn("can't map memory id %u: %m", memid);
 			res = -errno;
@@ -815,7 +839,7 @@ client_node_set_activation(void *_data,
 		size = 0;
 	} else {
 		mm = pw_mempool_map_id(data->pool, memid,
-				PW_MEMMAP_FLAG_READWRITE, offset, size, NULL);
+				rt_map_flags(data), offset, size, NULL);
 		if (mm == NULL) {
 			res = -errno;
 			goto error_exit;
@@ -53,6 +53,14 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * - `filter.graph = []`: a description of the filter graph to run, see below
  * - `capture.props = {}`: properties to be passed to the input stream
  * - `playback.props = {}`: properties to be passed to the output stream
+ * - `filter-graph.max-threads`: the maximum number of threads used to process
+ *                   the graph, default 1. Independent branches of the graph, such
+ *                   as the per-channel copies of a mono graph or unconnected
+ *                   subgraphs, are then processed concurrently.
+ * - `filter-graph.profile`: measure the run time of each node in the graph, default
+ *                   false. The minimum, average and maximum run time of the nodes
+ *                   in nanoseconds is published every second in the
+ *                   `filter-graph.node.timing` property of the streams.
  *
  * ## Filter graph description
  *
@@ -246,6 +254,30 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * We refer to https://arachnoid.com/BiQuadDesigner/index.html for an explanation of
  * the controls.
  *
+ * By default, new coefficients are applied at the start of the next cycle and the
+ * filter state is cleared. With the `smoothing` config key, the filter keeps its
+ * state and the coefficients are interpolated to the new values over the given
+ * number of seconds. The coefficients are computed from the controls outside of the
+ * processing thread when they are changed with the node properties. Controls that are
+ * linked to a notify port are computed in the processing thread when they change.
+ *
+ *\code{.unparsed}
+ * filter.graph = {
+ *     nodes = [
+ *         {
+ *             type   = builtin
+ *             name   = ...
+ *             label  = bq_peaking
+ *             config = {
+ *                 smoothing = 0.01
+ *             }
+ *             ...
+ *         }
+ *     }
+ *     ...
+ * }
+ *\endcode
+ *
  * The following labels can be used:
  *
  * - `bq_lowpass` a lowpass filter.
@@ -691,6 +723,49 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * The `null` plugin has one data input "In" and one control input "Control" that
  * simply discards the data.
  *
+ * ### Loudness
+ *
+ * The `loudness` plugin measures the loudness of a signal according to
+ * ITU-R BS.1770 and EBU R128 without external dependencies. It has the same
+ * ports as the `ebur128` filter from the EBUR128 plugin (See below) and can be
+ * used as a replacement for it.
+ *
+ * The channels are K-weighted and summed with the BS.1770 channel weights before
+ * the loudness is calculated, so that "Momentary LUFS", "Shortterm LUFS" and
+ * "Global LUFS" are measured over all connected channels together. The
+ * integrated loudness and the loudness range are calculated with 0.1 LU
+ * histograms and keep the complete history. "True Peak" is measured by
+ * oversampling the signal 4 times (2 times for rates of 96000 and higher) and is
+ * only calculated when enabled with the `true-peak` config key.
+ *
+ * The node has an optional `config` section with extra configuration:
+ *
+ *\code{.unparsed}
+ * filter.graph = {
+ *     nodes = [
+ *         {
+ *             type   = builtin
+ *             name   = ...
+ *             label  = loudness
+ *             config = {
+ *                 max-window = 0.4
+ *                 update-rate = 10.0
+ *                 true-peak = false
+ *             }
+ *             ...
+ *         }
+ *     }
+ *     ...
+ * }
+ *\endcode
+ *
+ * - `max-window` the window in (float) seconds used for "Window LUFS". It is
+ *                rounded up to 100ms. Default 0.4
+ * - `update-rate` how many times per second the output control ports are
+ *                 updated. Default 10.0
+ * - `true-peak` oversample to measure "True Peak". When disabled, it contains the
+ *               sample peak. Default false
+ *
  * ## SOFA filters
  *
  * There is an optional `sofa` type available (when compiled with `libmysofa`).
@@ -938,6 +1013,8 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  *             label = {
  *                 filename = "..."
  *                 blocksize = 512
+ *                 #async = false
+ *                 #batch = false
  *                 input-tensors = {
  *                     "<name>" = {
  *                         dimensions = [ ... ]
@@ -966,6 +1043,17 @@ extern struct spa_handle_factory spa_filter_graph_factory;
  * - `filename` the ONNX model to load. It must point to an existing onnx file.
  * - `blocksize` the number of samples to give to the model. This depends on the model
  *               and the input/output tensor sizes.
+ * - `async` run the model in a separate thread instead of the processing thread. The
+ *           samples are accumulated in blocks of `blocksize` and the model is run on
+ *           the previous block while the next one is filled. This adds 2 * `blocksize`
+ *           samples of latency, which is reported on the `latency` output control port.
+ *           When the model can't keep up, the block is dropped and silence is produced.
+ *           Default false.
+ * - `batch` run the blocks of all filters using the same label in one model call.
+ *           This requires that the first dimension of all tensors is dynamic in the
+ *           model and configured to 1. This implies `async`. Default false.
+ *
+ * All filters that use the same model file share one ONNX session.
  * - `input-tensors` an object of input tensors of the model and how they should be
  *                   used. Unlisted tensors will not be used.
  * - `output-tensors` an object of output tensors of the model and how they should be
@@ -1246,6 +1334,8 @@ struct impl {
 
 	struct spa_latency_info latency[2];
 	struct spa_process_latency_info process_latency;
+
+	struct spa_source *profile_timer;
 };
 
 static void capture_destroy(void *d)
@@ -1785,6 +1875,26 @@ static void copy_position(struct spa_audio_info_raw *dst, const struct spa_audio
 	}
 }
 
+static void update_timing(struct impl *impl, const char *key, const char *value)
+{
+	char name[64];
+	struct spa_dict_item items[1];
+
+	snprintf(name, sizeof(name), "filter-graph.%s", key);
+	items[0] = SPA_DICT_ITEM(name, value);
+
+	if (impl->capture)
+		pw_stream_update_properties(impl->capture, &SPA_DICT_INIT_ARRAY(items));
+	if (impl->playback)
+		pw_stream_update_properties(impl->playback, &SPA_DICT_INIT_ARRAY(items));
+}
+
+static void profile_timeout(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	spa_filter_graph_update_info(impl->graph);
+}
+
 static void graph_info(void *object, const struct spa_filter_graph_info *info)
 {
 	struct impl *impl = object;
@@ -1797,7 +1907,11 @@ static void graph_info(void *object, const struct spa_filter_graph_info *info)
 	for (i = 0; props && i < props->n_items; i++) {
 		const char *k = props->items[i].key;
 		const char *s = props->items[i].value;
-		pw_log_info("%s %s", k, s);
+		if (spa_streq(k, "node.timing") || spa_streq(k, "branch.timing")) {
+			update_timing(impl, k, s);
+			continue;
+		}
+		pw_log_debug("%s %s", k, s);
 		if (spa_streq(k, "latency")) {
 			double latency;
 			if (spa_atod(s, &latency)) {
@@ -1895,6 +2009,10 @@ static const struct pw_proxy_events core_proxy_events = {
 
 static void impl_destroy(struct impl *impl)
 {
+	if (impl->profile_timer)
+		pw_loop_destroy_source(pw_context_get_main_loop(impl->context),
+				impl->profile_timer);
+
 	/* disconnect both streams before destroying any of them */
 	if (impl->capture)
 		pw_stream_disconnect(impl->capture);
@@ -2118,6 +2236,15 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 
 	setup_streams(impl);
 
+	if (pw_properties_get_bool(props, "filter-graph.profile", false)) {
+		struct pw_loop *loop = pw_context_get_main_loop(impl->context);
+		struct timespec value = { 1, 0 }, interval = { 1, 0 };
+
+		impl->profile_timer = pw_loop_add_timer(loop, profile_timeout, impl);
+		if (impl->profile_timer != NULL)
+			pw_loop_update_timer(loop, impl->profile_timer, &value, &interval, false);
+	}
+
 	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
 
 	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_props));
@@ -76,6 +76,8 @@
  *     #pulse.default.format   = F32
  *     #pulse.default.position = [ FL FR ]
  *     #pulse.idle.timeout     = 0
+ *     #pulse.enable-shm       = true
+ *     #pulse.io-threads       = 0
  * }
  *
  * pulse.properties.rules = [
@@ -247,6 +249,23 @@
  * save battery power. When the client resumes, it will unpause again.
  * A value of 0 disables this feature.
  *
+ *\code{.unparsed}
+ *     pulse.enable-shm = true
+ *\endcode
+ *
+ * Let local clients of the same user send playback data in shared memory
+ * instead of through the socket. Only memfd pools that can be sealed against
+ * shrinking are used, clients that don't support memfd, sandboxed clients and
+ * clients with a custom client.access always use the socket.
+ *
+ *\code{.unparsed}
+ *     pulse.io-threads = 0
+ *\endcode
+ *
+ * Read the client sockets on this many I/O threads, each thread serving a share
+ * of the clients. The commands are still handled on the main loop. A value of
+ * 0 reads all clients on the main loop.
+ *
  * ## Command execution
  *
  * As part of the server startup sequence, a set of commands can be executed.
@@ -5,8 +5,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <spa/utils/defs.h>
 #include <spa/utils/hook.h>
@@ -21,12 +23,14 @@
 #include "commands.h"
 #include "defs.h"
 #include "internal.h"
+#include "io-shard.h"
 #include "log.h"
 #include "manager.h"
 #include "message.h"
 #include "operation.h"
 #include "pending-sample.h"
 #include "server.h"
+#include "shm.h"
 #include "stream.h"
 
 PW_LOG_TOPIC_EXTERN(pulse_conn);
@@ -46,6 +50,7 @@ struct client *client_new(struct server *server)
 	client->connect_tag = SPA_ID_INVALID;
 
 	pw_map_init(&client->streams, 16, 16);
+	pw_array_init(&client->shm_pools, 4 * sizeof(struct shm_pool));
 	spa_list_init(&client->out_messages);
 	spa_list_init(&client->operations);
 	spa_list_init(&client->pending_samples);
@@ -111,6 +116,8 @@ void client_disconnect(struct client *client)
 
 	pw_map_for_each(&client->streams, client_free_stream, client);
 
+	io_shard_remove_client(client);
+
 	if (client->source) {
 		pw_loop_destroy_source(impl->main_loop, client->source);
 		client->source = NULL;
@@ -143,8 +150,12 @@ void client_free(struct client *client)
 	if (client->message)
 		message_free(client->message, false, false);
 
+	client_close_fds(client);
+	shm_pools_clear(client);
+
 	spa_list_consume(msg, &client->out_messages, link)
 		message_free(msg, true, false);
+	free(client->out_events);
 
 	spa_list_consume(o, &client->operations, link)
 		operation_free(o);
@@ -180,6 +191,15 @@ void client_update_routes(struct client *client, const char *key, const char *va
 	client_emit_routes_changed(client);
 }
 
+void client_close_fds(struct client *client)
+{
+	uint32_t i;
+
+	for (i = 0; i < client->n_fds; i++)
+		close(client->fds[i]);
+	client->n_fds = 0;
+}
+
 int client_queue_message(struct client *client, struct message *msg)
 {
 	struct impl *impl = client->impl;
@@ -193,10 +213,12 @@ int client_queue_message(struct client *client, struct message *msg)
 		goto error;
 	}
 
-	if (msg->length == 0) {
+	/* record data has no storage, it is sent from the ring of the stream */
+	if (msg->length == 0 && msg->type != MESSAGE_TYPE_SHM_RELEASE) {
 		res = 0;
 		goto error;
-	} else if (msg->length > msg->allocated) {
+	} else if (msg->length > msg->allocated &&
+		   msg->type != MESSAGE_TYPE_RECORD_DATA) {
 		res = -ENOMEM;
 		goto error;
 	}
@@ -219,6 +241,60 @@ error:
 	return res;
 }
 
+static ssize_t send_credentials(int fd, struct iovec *iov, size_t n_iov)
+{
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = n_iov,
+	};
+#ifdef SCM_CREDENTIALS
+	union {
+		struct cmsghdr hdr;
+		uint8_t buf[CMSG_SPACE(sizeof(struct ucred))];
+	} cmsg;
+	struct ucred *ucred;
+
+	spa_zero(cmsg);
+	cmsg.hdr.cmsg_level = SOL_SOCKET;
+	cmsg.hdr.cmsg_type = SCM_CREDENTIALS;
+	cmsg.hdr.cmsg_len = CMSG_LEN(sizeof(struct ucred));
+
+	ucred = (struct ucred *) CMSG_DATA(&cmsg.hdr);
+	ucred->pid = getpid();
+	ucred->uid = getuid();
+	ucred->gid = getgid();
+
+	msg.msg_control = &cmsg;
+	msg.msg_controllen = sizeof(cmsg);
+#endif
+	return sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static ssize_t send_iov(int fd, struct iovec *iov, size_t n_iov)
+{
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = n_iov,
+	};
+	return sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static void client_message_sent(struct client *client, struct message *m)
+{
+	if (m->channel == SPA_ID_INVALID &&
+	    m->type != MESSAGE_TYPE_SHM_RELEASE &&
+	    pw_log_topic_custom_enabled(SPA_LOG_LEVEL_INFO, pulse_conn))
+		message_dump(SPA_LOG_LEVEL_INFO, ">>", m);
+
+	/* the data is sent, the stream can reuse that part of the ring */
+	if (m->type == MESSAGE_TYPE_RECORD_DATA)
+		spa_ringbuffer_read_update(&m->u.record.stream->ring,
+				m->u.record.index + m->length);
+
+	message_free(m, true, false);
+	client->out_index = 0;
+}
+
 static int client_try_flush_messages(struct client *client)
 {
 	pw_log_trace("client %p: flushing", client);
@@ -228,33 +304,49 @@ static int client_try_flush_messages(struct client *client)
 	while (!spa_list_is_empty(&client->out_messages)) {
 		struct message *m = spa_list_first(&client->out_messages, struct message, link);
 		struct descriptor desc;
-		const void *data;
-		size_t size;
-
-		if (client->out_index < sizeof(desc)) {
-			desc.length = htonl(m->length);
-			desc.channel = htonl(m->channel);
-			desc.offset_hi = 0;
-			desc.offset_lo = 0;
-			desc.flags = 0;
-
-			data = SPA_PTROFF(&desc, client->out_index, void);
-			size = sizeof(desc) - client->out_index;
-		} else if (client->out_index < m->length + sizeof(desc)) {
-			uint32_t idx = client->out_index - sizeof(desc);
-			data = m->data + idx;
-			size = m->length - idx;
-		} else {
-			if (m->channel == SPA_ID_INVALID &&
-			    pw_log_topic_custom_enabled(SPA_LOG_LEVEL_INFO, pulse_conn))
-				message_dump(SPA_LOG_LEVEL_INFO, ">>", m);
-			message_free(m, true, false);
-			client->out_index = 0;
+		struct iovec iov[3];
+		uint32_t i, n_iov = 0, skip;
+
+		if (client->out_index >= sizeof(desc) + m->length) {
+			client_message_sent(client, m);
 			continue;
 		}
 
+		desc.length = htonl(m->length);
+		desc.channel = htonl(m->channel);
+		desc.offset_hi = 0;
+		desc.offset_lo = 0;
+		desc.flags = 0;
+
+		if (m->type == MESSAGE_TYPE_SHM_RELEASE) {
+			desc.offset_hi = htonl(m->u.shm_release.block_id);
+			desc.flags = htonl(FLAG_SHMRELEASE);
+		}
+
+		/* send the header and the payload in one go, record data is
+		 * sent straight from the ring of the stream */
+		iov[n_iov++] = (struct iovec) { &desc, sizeof(desc) };
+		if (m->type == MESSAGE_TYPE_RECORD_DATA)
+			n_iov += stream_get_record_iov(m->u.record.stream,
+					m->u.record.index, m->length, &iov[n_iov]);
+		else if (m->length > 0)
+			iov[n_iov++] = (struct iovec) { m->data, m->length };
+
+		/* skip what was sent before */
+		skip = client->out_index;
+		for (i = 0; i < n_iov && skip >= iov[i].iov_len; i++)
+			skip -= iov[i].iov_len;
+		iov[i].iov_base = SPA_PTROFF(iov[i].iov_base, skip, void);
+		iov[i].iov_len -= skip;
+
 		while (true) {
-			ssize_t sent = send(client->source->fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+			ssize_t sent;
+
+			/* libpulse only enables shm when the server is the same user */
+			if (client->out_index == 0 && m->type == MESSAGE_TYPE_CREDENTIALS)
+				sent = send_credentials(client->source->fd, &iov[i], n_iov - i);
+			else
+				sent = send_iov(client->source->fd, &iov[i], n_iov - i);
 			if (sent < 0) {
 				int res = -errno;
 				if (res == -EINTR)
@@ -300,18 +392,33 @@ static bool drop_from_out_queue(struct client *client, struct message *m)
 	return true;
 }
 
+static struct spa_list *get_event_bucket(struct client *client, uint32_t facility, uint32_t index)
+{
+	uint32_t i, hash;
+
+	if (client->out_events == NULL) {
+		client->out_events = calloc(1u << SUBSCRIBE_EVENT_BUCKETS_BITS, sizeof(struct spa_list));
+		if (client->out_events == NULL)
+			return NULL;
+		for (i = 0; i < 1u << SUBSCRIBE_EVENT_BUCKETS_BITS; i++)
+			spa_list_init(&client->out_events[i]);
+	}
+	hash = ((index << 4) | facility) * 2654435761u;
+	return &client->out_events[hash >> (32 - SUBSCRIBE_EVENT_BUCKETS_BITS)];
+}
+
 /* returns true if an event with the (mask, event, index) triplet should be dropped because it is redundant */
-static bool client_prune_subscribe_events(struct client *client, uint32_t facility, uint32_t type, uint32_t index)
+static bool client_prune_subscribe_events(struct client *client, struct spa_list *bucket,
+		uint32_t facility, uint32_t type, uint32_t index)
 {
 	struct message *m, *t;
 
 	if (type == SUBSCRIPTION_EVENT_NEW)
 		return false;
 
-	/* NOTE: reverse iteration */
-	spa_list_for_each_safe_reverse(m, t, &client->out_messages, link) {
-		if (m->type != MESSAGE_TYPE_SUBSCRIPTION_EVENT)
-			continue;
+	/* NOTE: reverse iteration, the bucket has the queued events in the
+	 * same order as the out queue */
+	spa_list_for_each_safe_reverse(m, t, bucket, u.subscription_event.link) {
 		if ((m->u.subscription_event.event & SUBSCRIPTION_EVENT_FACILITY_MASK) != facility)
 			continue;
 		if (m->u.subscription_event.index != index)
@@ -379,7 +486,11 @@ int client_queue_subscribe_event(struct client *client, uint32_t facility, uint3
 			subscription_event_type_to_string(type), type,
 			index);
 
-	if (client_prune_subscribe_events(client, facility, type, index))
+	struct spa_list *bucket = get_event_bucket(client, facility, index);
+	if (bucket == NULL)
+		return -errno;
+
+	if (client_prune_subscribe_events(client, bucket, facility, type, index))
 		return 0;
 
 	struct message *reply = message_alloc(client->impl, -1, 0);
@@ -391,6 +502,8 @@ int client_queue_subscribe_event(struct client *client, uint32_t facility, uint3
 	reply->type = MESSAGE_TYPE_SUBSCRIPTION_EVENT;
 	reply->u.subscription_event.event = event;
 	reply->u.subscription_event.index = index;
+	/* message_free() removes it from the bucket again */
+	spa_list_append(bucket, &reply->u.subscription_event.link);
 
 	message_put(reply,
 		TAG_U32, COMMAND_SUBSCRIBE_EVENT,
@@ -10,12 +10,16 @@
 
 #include <spa/utils/list.h>
 #include <spa/utils/hook.h>
+#include <pipewire/array.h>
 #include <pipewire/map.h>
 
+#include "defs.h"
+
 struct impl;
 struct server;
 struct message;
 struct spa_source;
+struct client_io;
 struct pw_properties;
 struct pw_core;
 struct pw_manager;
@@ -39,6 +43,7 @@ struct client {
 	const char *name; /* owned by `client::props` */
 
 	struct spa_source *source;
+	struct client_io *io;			/**< reader on an I/O thread, see io-shard.h */
 
 	uint32_t version;
 
@@ -75,9 +80,14 @@ struct client {
 	uint32_t out_index;
 	struct descriptor desc;
 	struct message *message;
+	int fds[MAX_FDS];			/**< fds received with the current frame */
+	uint32_t n_fds;
+
+	struct pw_array shm_pools;		/**< shm pools of the client, see shm.h */
 
 	struct pw_map streams;
 	struct spa_list out_messages;
+	struct spa_list *out_events;		/**< queued subscription events, hashed by facility and index */
 
 	struct spa_list operations;
 
@@ -86,6 +96,9 @@ struct client {
 	unsigned int disconnect:1;
 	unsigned int new_msg_since_last_flush:1;
 	unsigned int authenticated:1;
+	unsigned int shm_allowed:1;		/**< same user and not sandboxed */
+	unsigned int shm:1;			/**< client sends shm blocks */
+	unsigned int memfd:1;			/**< client registers memfd pools */
 
 	struct pw_manager_object *prev_default_sink;
 	struct pw_manager_object *prev_default_source;
@@ -108,6 +121,7 @@ void client_disconnect(struct client *client);
 void client_free(struct client *client);
 int client_queue_message(struct client *client, struct message *msg);
 int client_flush_messages(struct client *client);
+void client_close_fds(struct client *client);
 int client_queue_subscribe_event(struct client *client, uint32_t facility, uint32_t type, uint32_t index);
 
 void client_update_routes(struct client *client, const char *key, const char *value);
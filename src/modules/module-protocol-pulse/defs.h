@@ -23,6 +23,8 @@
 #define FRAME_SIZE_MAX_ALLOW (1024*1024*16)
 
 #define PROTOCOL_FLAG_MASK	0xffff0000u
+#define PROTOCOL_FLAG_SHM	0x80000000u
+#define PROTOCOL_FLAG_MEMFD	0x40000000u
 #define PROTOCOL_VERSION_MASK	0x0000ffffu
 #define PROTOCOL_VERSION	35
 
@@ -33,13 +35,21 @@
 #define MAX_BUFFERS     4u
 
 #define MAXLENGTH		(4u*1024*1024) /* 4MB */
+#define MIN_BUFFER_SIZE		(64u*1024) /* initial ringbuffer size, grows up to MAXLENGTH */
+
+#define MAX_FDS			8u
+#define MAX_SHM_POOLS		16u
+#define SHM_POOL_SIZE_MAX	(1024*1024*64)
 
 #define SCACHE_ENTRY_SIZE_MAX	(1024*1024*16)
 
+#define SUBSCRIBE_EVENT_BUCKETS_BITS	8u
+
 #define MODULE_INDEX_MASK	0xfffffffu
 #define MODULE_FLAG		(1u << 29)
 
 #define STREAM_CREATE_TIMEOUT	(35 * SPA_NSEC_PER_SEC)
+#define SAMPLE_PLAYER_IDLE_TIMEOUT	(10 * SPA_NSEC_PER_SEC)
 
 #define DEFAULT_SINK		"@DEFAULT_SINK@"
 #define DEFAULT_SOURCE		"@DEFAULT_SOURCE@"
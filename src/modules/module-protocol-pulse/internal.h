@@ -36,6 +36,8 @@ struct defs {
 	struct channel_map channel_map;
 	uint32_t quantum_limit;
 	uint32_t idle_timeout;
+	bool enable_shm;
+	uint32_t io_threads;
 };
 
 struct stats {
@@ -44,6 +46,8 @@ struct stats {
 	uint32_t n_accumulated;
 	uint32_t accumulated;
 	uint32_t sample_cache;
+	uint32_t n_stream_buffers;
+	uint64_t stream_buffers;
 };
 
 struct impl {
@@ -66,7 +70,13 @@ struct impl {
 	struct pw_map samples;
 	struct pw_map modules;
 
+	struct spa_list sample_players;
+
 	struct spa_list free_messages;
+
+	struct io_shard **io_shards;
+	uint32_t n_io_shards;
+
 	struct defs defs;
 	struct stats stat;
 };
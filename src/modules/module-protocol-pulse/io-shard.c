@@ -0,0 +1,502 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <spa/utils/atomic.h>
+#include <spa/utils/defs.h>
+#include <spa/utils/result.h>
+#include <pipewire/log.h>
+#include <pipewire/loop.h>
+#include <pipewire/thread-loop.h>
+
+#include "client.h"
+#include "defs.h"
+#include "internal.h"
+#include "io-shard.h"
+#include "log.h"
+#include "server.h"
+#include "utils.h"
+
+/* a client stops being read when this many frames or bytes are waiting for
+ * the main loop */
+#define MAX_PENDING_FRAMES	64u
+#define MAX_PENDING_SIZE	(4u * 1024u * 1024u)
+
+struct io_shard {
+	struct impl *impl;
+	uint32_t index;
+	struct pw_thread_loop *thread;
+	struct pw_loop *loop;
+	uint32_t n_clients;
+
+	/* statistics, updated in the main loop */
+	uint64_t n_frames;
+	uint64_t n_bytes;
+	uint64_t wait_total;	/* frame complete until handled in the main loop */
+	uint64_t wait_max;
+	uint64_t handle_total;	/* time spent handling the frames */
+	uint64_t handle_max;
+};
+
+/* a frame, read in the I/O thread and passed to the main loop when
+ * complete. The main loop takes the data and the fds. */
+struct io_frame {
+	struct descriptor desc;
+	uint64_t time;
+	uint32_t length;
+	uint32_t n_fds;
+	int fds[MAX_FDS];
+	void *data;
+};
+
+struct client_io {
+	struct io_shard *shard;
+	struct client *client;		/* main loop only, NULL when removed */
+	int ref;			/* one for the client and one per event */
+	int fd;
+
+	/* frames read but not yet handled by the main loop */
+	uint32_t n_pending;
+	uint32_t pending_size;
+	int throttled;			/* SPA_IO_IN is removed from the source */
+
+	/* owned by the I/O thread */
+	struct spa_source *source;
+	uint32_t in_index;
+	struct io_frame frame;
+};
+
+struct io_event {
+	struct client_io *io;
+	struct io_frame frame;		/* no data for errors */
+	int res;
+};
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void close_fds(int *fds, uint32_t *n_fds)
+{
+	uint32_t i;
+	for (i = 0; i < *n_fds; i++)
+		close(fds[i]);
+	*n_fds = 0;
+}
+
+static void frame_clear(struct io_frame *f)
+{
+	close_fds(f->fds, &f->n_fds);
+	free(f->data);
+	f->data = NULL;
+}
+
+static void io_unref(struct client_io *io)
+{
+	if (SPA_ATOMIC_DEC(io->ref) == 0)
+		free(io);
+}
+
+static bool io_over_limit(struct client_io *io)
+{
+	return SPA_ATOMIC_LOAD(io->n_pending) >= MAX_PENDING_FRAMES ||
+		SPA_ATOMIC_LOAD(io->pending_size) >= MAX_PENDING_SIZE;
+}
+
+/* I/O thread */
+static void io_update_reading(struct client_io *io, bool reading)
+{
+	if (io->source == NULL)
+		return;
+	pw_loop_update_io(io->shard->loop, io->source,
+			SPA_IO_ERR | SPA_IO_HUP | (reading ? SPA_IO_IN : 0));
+}
+
+/* I/O thread */
+static int do_io_resume(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct client_io *io = user_data;
+
+	if (SPA_ATOMIC_XCHG(io->throttled, 0))
+		io_update_reading(io, true);
+	io_unref(io);
+	return 0;
+}
+
+/* main loop, a frame was handled */
+static void io_frame_done(struct client_io *io, uint32_t length)
+{
+	__atomic_sub_fetch(&io->pending_size, length, __ATOMIC_SEQ_CST);
+	SPA_ATOMIC_DEC(io->n_pending);
+
+	if (SPA_ATOMIC_LOAD(io->throttled) && !io_over_limit(io)) {
+		SPA_ATOMIC_INC(io->ref);
+		if (pw_loop_invoke(io->shard->loop, do_io_resume, 0, NULL, 0, false, io) < 0)
+			io_unref(io);
+	}
+}
+
+/* I/O thread, stop reading when the main loop has too much to handle */
+static bool io_throttle(struct client_io *io)
+{
+	if (!io_over_limit(io))
+		return false;
+
+	SPA_ATOMIC_STORE(io->throttled, 1);
+	/* io_frame_done might have missed the flag, check again */
+	if (!io_over_limit(io) && SPA_ATOMIC_XCHG(io->throttled, 0))
+		return false;
+
+	pw_log_debug("client_io %p: throttled, %u frames %u bytes pending", io,
+			SPA_ATOMIC_LOAD(io->n_pending), SPA_ATOMIC_LOAD(io->pending_size));
+	io_update_reading(io, false);
+	return true;
+}
+
+/* main loop */
+static int do_io_event(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	const struct io_event *ev = data;
+	struct client_io *io = ev->io;
+	struct client *client = io->client;
+	struct io_frame f = ev->frame;
+	int res = ev->res;
+
+	if (client != NULL && f.data != NULL)
+		io_frame_done(io, f.length);
+
+	if (client == NULL || client->disconnect) {
+		frame_clear(&f);
+		goto done;
+	}
+
+	client->ref++;
+
+	if (f.data != NULL) {
+		struct io_shard *shard = io->shard;
+		uint64_t now = get_time_ns(), wait, handle;
+
+		/* the client owns the data and the fds now */
+		res = server_handle_frame(client, &f.desc, f.data, f.fds, f.n_fds);
+
+		wait = now - f.time;
+		handle = get_time_ns() - now;
+		shard->n_frames++;
+		shard->n_bytes += f.length;
+		shard->wait_total += wait;
+		shard->wait_max = SPA_MAX(shard->wait_max, wait);
+		shard->handle_total += handle;
+		shard->handle_max = SPA_MAX(shard->handle_max, handle);
+
+		if (res >= 0 && !client->disconnect && client->new_msg_since_last_flush)
+			res = client_flush_messages(client);
+	}
+	if (res < 0)
+		server_client_error(client, res);
+
+	client_unref(client);
+done:
+	io_unref(io);
+	return 0;
+}
+
+/* I/O thread */
+static int queue_event(struct client_io *io, const struct io_frame *frame, int res)
+{
+	struct impl *impl = io->shard->impl;
+	struct io_event ev = {
+		.io = io,
+		.res = res,
+	};
+
+	if (frame != NULL) {
+		ev.frame = *frame;
+		__atomic_add_fetch(&io->pending_size, frame->length, __ATOMIC_SEQ_CST);
+		SPA_ATOMIC_INC(io->n_pending);
+	}
+
+	SPA_ATOMIC_INC(io->ref);
+	res = pw_loop_invoke(impl->main_loop, do_io_event, 0, &ev, sizeof(ev), false, NULL);
+	if (res < 0) {
+		SPA_ATOMIC_DEC(io->ref);
+		if (frame != NULL) {
+			__atomic_sub_fetch(&io->pending_size, frame->length, __ATOMIC_SEQ_CST);
+			SPA_ATOMIC_DEC(io->n_pending);
+		}
+		return res;
+	}
+	return 0;
+}
+
+static void io_stop(struct client_io *io)
+{
+	if (io->source) {
+		pw_loop_destroy_source(io->shard->loop, io->source);
+		io->source = NULL;
+	}
+	frame_clear(&io->frame);
+}
+
+static int io_read(struct client_io *io)
+{
+	struct io_frame *f = &io->frame;
+	size_t size;
+	void *data;
+	int res;
+
+	if (io->in_index < sizeof(f->desc)) {
+		data = SPA_PTROFF(&f->desc, io->in_index, void);
+		size = sizeof(f->desc) - io->in_index;
+	} else {
+		uint32_t idx = io->in_index - sizeof(f->desc);
+		data = SPA_PTROFF(f->data, idx, void);
+		size = f->length - idx;
+	}
+
+	while (true) {
+		ssize_t r = recv_fds(io->fd, data, size, f->fds, &f->n_fds, MAX_FDS);
+
+		if (r == 0)
+			return -EPIPE;
+		else if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		io->in_index += r;
+		break;
+	}
+
+	if (io->in_index == sizeof(f->desc)) {
+		/* check the header before allocating the payload. The main
+		 * loop checks the shm flags again, we don't know if the client
+		 * can use shm. */
+		if ((res = server_check_descriptor(&f->desc, true)) != 0) {
+			if (res < 0)
+				return res;
+			/* a frame without payload that needs no handling */
+			close_fds(f->fds, &f->n_fds);
+			io->in_index = 0;
+			return 0;
+		}
+		f->length = ntohl(f->desc.length);
+		if ((f->data = malloc(f->length)) == NULL)
+			return -errno;
+	} else if (io->in_index == sizeof(f->desc) + f->length) {
+		io->in_index = 0;
+		f->time = get_time_ns();
+
+		if ((res = queue_event(io, f, 0)) < 0) {
+			frame_clear(f);
+			return res;
+		}
+		/* the main loop owns the data and the fds now */
+		f->data = NULL;
+		f->n_fds = 0;
+	}
+	return 0;
+}
+
+static void on_io_data(void *data, int fd, uint32_t mask)
+{
+	struct client_io *io = data;
+	int res;
+
+	if (mask & SPA_IO_HUP) {
+		res = -EPIPE;
+		goto error;
+	}
+	if (mask & SPA_IO_ERR) {
+		res = -EIO;
+		goto error;
+	}
+	if (mask & SPA_IO_IN) {
+		while (true) {
+			if (io->in_index == 0 && io_throttle(io))
+				break;
+			res = io_read(io);
+			if (res < 0) {
+				if (res != -EAGAIN && res != -EWOULDBLOCK)
+					goto error;
+				break;
+			}
+		}
+	}
+	return;
+
+error:
+	/* stop reading, the main loop disconnects the client */
+	io_stop(io);
+	if ((res = queue_event(io, NULL, res)) < 0)
+		pw_log_warn("client_io %p: can't queue error: %s", io, spa_strerror(res));
+}
+
+static int do_io_add(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct client_io *io = user_data;
+
+	io->source = pw_loop_add_io(io->shard->loop, io->fd,
+			SPA_IO_ERR | SPA_IO_HUP | SPA_IO_IN,
+			false, on_io_data, io);
+	return io->source ? 0 : -errno;
+}
+
+static int do_io_remove(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	io_stop(user_data);
+	return 0;
+}
+
+int io_shard_add_client(struct client *client)
+{
+	struct impl *impl = client->impl;
+	struct io_shard *shard = NULL;
+	struct client_io *io;
+	uint32_t i;
+	int res;
+
+	/* use the thread with the least clients */
+	for (i = 0; i < impl->n_io_shards; i++) {
+		if (shard == NULL || impl->io_shards[i]->n_clients < shard->n_clients)
+			shard = impl->io_shards[i];
+	}
+	if (shard == NULL)
+		return -ENOTSUP;
+
+	io = calloc(1, sizeof(*io));
+	if (io == NULL)
+		return -errno;
+
+	io->shard = shard;
+	io->client = client;
+	io->ref = 1;
+	io->fd = client->source->fd;
+
+	if ((res = pw_loop_invoke(shard->loop, do_io_add, 0, NULL, 0, true, io)) < 0) {
+		free(io);
+		return res;
+	}
+	shard->n_clients++;
+	client->io = io;
+
+	pw_log_debug("client %p: reading on I/O thread %u", client, shard->index);
+	return 0;
+}
+
+void io_shard_remove_client(struct client *client)
+{
+	struct client_io *io = client->io;
+
+	if (io == NULL)
+		return;
+
+	client->io = NULL;
+	io->client = NULL;
+	io->shard->n_clients--;
+
+	/* after this, the thread does not use the socket anymore. Events that
+	 * are still queued for the main loop are dropped. */
+	pw_loop_invoke(io->shard->loop, do_io_remove, 0, NULL, 0, true, io);
+	io_unref(io);
+}
+
+int io_shards_init(struct impl *impl, uint32_t n_shards)
+{
+	uint32_t i;
+	int res;
+
+	if (n_shards == 0)
+		return 0;
+
+	impl->io_shards = calloc(n_shards, sizeof(struct io_shard *));
+	if (impl->io_shards == NULL)
+		return -errno;
+
+	for (i = 0; i < n_shards; i++) {
+		struct io_shard *shard;
+		char name[32];
+
+		if ((shard = calloc(1, sizeof(*shard))) == NULL)
+			goto error_errno;
+
+		shard->impl = impl;
+		shard->index = i;
+		impl->io_shards[impl->n_io_shards++] = shard;
+
+		snprintf(name, sizeof(name), "pulse-io-%u", i);
+		if ((shard->thread = pw_thread_loop_new(name, NULL)) == NULL)
+			goto error_errno;
+		shard->loop = pw_thread_loop_get_loop(shard->thread);
+
+		if ((res = pw_thread_loop_start(shard->thread)) < 0)
+			goto error;
+	}
+	pw_log_info("%p: reading clients on %u I/O threads", impl, n_shards);
+	return 0;
+
+error_errno:
+	res = -errno;
+error:
+	pw_log_error("%p: can't start I/O threads: %s", impl, spa_strerror(res));
+	io_shards_clear(impl);
+	return res;
+}
+
+void io_shards_clear(struct impl *impl)
+{
+	uint32_t i;
+
+	for (i = 0; i < impl->n_io_shards; i++) {
+		struct io_shard *shard = impl->io_shards[i];
+
+		if (shard->thread) {
+			pw_thread_loop_stop(shard->thread);
+			pw_thread_loop_destroy(shard->thread);
+		}
+		free(shard);
+	}
+	free(impl->io_shards);
+	impl->io_shards = NULL;
+	impl->n_io_shards = 0;
+}
+
+void io_shards_dump(struct impl *impl, FILE *f)
+{
+	uint32_t i;
+
+	fputc('[', f);
+	for (i = 0; i < impl->n_io_shards; i++) {
+		struct io_shard *shard = impl->io_shards[i];
+		uint64_t n = SPA_MAX(shard->n_frames, 1u) * SPA_NSEC_PER_USEC;
+
+		fprintf(f, "%s{\"index\":%u,\"clients\":%u,\"frames\":%" PRIu64
+				",\"bytes\":%" PRIu64
+				",\"wait-avg-usec\":%" PRIu64 ",\"wait-max-usec\":%" PRIu64
+				",\"handle-avg-usec\":%" PRIu64 ",\"handle-max-usec\":%" PRIu64 "}",
+				i == 0 ? "" : ",", shard->index, shard->n_clients,
+				shard->n_frames, shard->n_bytes,
+				shard->wait_total / n,
+				shard->wait_max / (uint64_t)SPA_NSEC_PER_USEC,
+				shard->handle_total / n,
+				shard->handle_max / (uint64_t)SPA_NSEC_PER_USEC);
+	}
+	fputc(']', f);
+}
@@ -0,0 +1,25 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef PULSE_SERVER_IO_SHARD_H
+#define PULSE_SERVER_IO_SHARD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct impl;
+struct client;
+
+/* Client sockets are read and split into frames on a number of I/O threads,
+ * each thread serves a shard of the clients. Complete frames are handled on
+ * the main loop, which also writes the replies. */
+int io_shards_init(struct impl *impl, uint32_t n_shards);
+void io_shards_clear(struct impl *impl);
+
+int io_shard_add_client(struct client *client);
+void io_shard_remove_client(struct client *client);
+
+void io_shards_dump(struct impl *impl, FILE *f);
+
+#endif /* PULSE_SERVER_IO_SHARD_H */
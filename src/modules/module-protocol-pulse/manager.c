@@ -44,6 +44,15 @@ struct object_info {
 	void (*destroy) (struct object *object);
 };
 
+#define MAX_CACHE	2u
+
+/* an encoded reply, valid until the object or an object it refers to changes */
+struct object_cache {
+	uint32_t key;
+	uint32_t size;
+	void *data;
+};
+
 struct object_data {
 	struct spa_list link;
 	struct object *object;
@@ -66,6 +75,9 @@ struct object {
 	struct spa_hook object_listener;
 
 	struct spa_list data_list;
+
+	struct object_cache cache[MAX_CACHE];
+	uint32_t cache_next;
 };
 
 static int core_sync(struct manager *m)
@@ -143,6 +155,15 @@ static struct object *find_object_by_id(struct manager *m, uint32_t id)
 	return NULL;
 }
 
+static void object_cache_clear(struct object *o)
+{
+	uint32_t i;
+	for (i = 0; i < MAX_CACHE; i++) {
+		free(o->cache[i].data);
+		spa_zero(o->cache[i]);
+	}
+}
+
 static void object_update_params(struct object *o)
 {
 	struct pw_manager_param *p, *t;
@@ -159,6 +180,9 @@ static void object_update_params(struct object *o)
 		}
 	}
 
+	if (!spa_list_is_empty(&o->pending_list))
+		object_cache_clear(o);
+
 	spa_list_consume(p, &o->pending_list, link) {
 		spa_list_remove(&p->link);
 		if (p->param == NULL) {
@@ -176,6 +200,43 @@ static void object_reset_params(struct object *o)
 		o->this.params[i].user = 0;
 }
 
+/* drop the cached replies of the objects that refer to @o: nodes of a device,
+ * client or module and the nodes at both ends of a link */
+static void object_cache_clear_related(struct manager *m, struct object *o)
+{
+	struct object *t;
+	const char *key = NULL;
+	uint32_t id, related[2] = { SPA_ID_INVALID, SPA_ID_INVALID };
+
+	if (spa_streq(o->this.type, PW_TYPE_INTERFACE_Device))
+		key = PW_KEY_DEVICE_ID;
+	else if (spa_streq(o->this.type, PW_TYPE_INTERFACE_Client))
+		key = PW_KEY_CLIENT_ID;
+	else if (spa_streq(o->this.type, PW_TYPE_INTERFACE_Module))
+		key = PW_KEY_MODULE_ID;
+	else if (spa_streq(o->this.type, PW_TYPE_INTERFACE_Link) && o->this.props != NULL) {
+		pw_properties_fetch_uint32(o->this.props, PW_KEY_LINK_OUTPUT_NODE, &related[0]);
+		pw_properties_fetch_uint32(o->this.props, PW_KEY_LINK_INPUT_NODE, &related[1]);
+	} else if (spa_streq(o->this.type, PW_TYPE_INTERFACE_Node) && o->this.props != NULL) {
+		/* the card info has the latency offsets of the nodes */
+		pw_properties_fetch_uint32(o->this.props, PW_KEY_DEVICE_ID, &related[0]);
+	} else
+		return;
+
+	spa_list_for_each(t, &m->this.object_list, this.link) {
+		if (t == o)
+			continue;
+		if (key == NULL) {
+			if (t->this.id == related[0] || t->this.id == related[1])
+				object_cache_clear(t);
+		} else if (t->this.props != NULL &&
+		    pw_properties_fetch_uint32(t->this.props, key, &id) == 0 &&
+		    id == o->this.id) {
+			object_cache_clear(t);
+		}
+	}
+}
+
 static void object_data_free(struct object_data *d)
 {
 	spa_list_remove(&d->link);
@@ -198,6 +259,7 @@ static void object_destroy(struct object *o)
 	clear_params(&o->pending_list, SPA_ID_INVALID);
 	spa_list_consume(d, &o->data_list, link)
 		object_data_free(d);
+	object_cache_clear(o);
 	free(o);
 }
 
@@ -219,6 +281,8 @@ static void client_event_info(void *data, const struct pw_client_info *info)
 	if (info == NULL)
 		return;
 
+	object_cache_clear(o);
+
 	if (info->change_mask & PW_CLIENT_CHANGE_MASK_PROPS)
 		changed++;
 
@@ -260,6 +324,8 @@ static void module_event_info(void *data, const struct pw_module_info *info)
 	if (info == NULL)
 		return;
 
+	object_cache_clear(o);
+
 	if (info->change_mask & PW_MODULE_CHANGE_MASK_PROPS)
 		changed++;
 
@@ -302,6 +368,8 @@ static void device_event_info(void *data, const struct pw_device_info *info)
 	if (info == NULL)
 		return;
 
+	object_cache_clear(o);
+
 	o->this.n_params = info->n_params;
 	o->this.params = info->params;
 
@@ -426,6 +494,8 @@ static void node_event_info(void *data, const struct pw_node_info *info)
 	if (info == NULL)
 		return;
 
+	object_cache_clear(o);
+
 	o->this.n_params = info->n_params;
 	o->this.params = info->params;
 
@@ -664,6 +734,7 @@ static void registry_event_global_remove(void *data, uint32_t id)
 		return;
 
 	o->this.removing = true;
+	object_cache_clear_related(m, o);
 
 	if (!o->this.creating) {
 		o->this.change_mask = ~0;
@@ -703,9 +774,12 @@ static void on_core_done(void *data, uint32_t id, int seq)
 		spa_list_for_each(o, &m->this.object_list, this.link) {
 			if (o->this.creating) {
 				o->this.creating = false;
+				object_cache_clear_related(m, o);
 				manager_emit_added(m, &o->this);
 				o->changed = 0;
 			} else if (o->changed > 0) {
+				object_cache_clear(o);
+				object_cache_clear_related(m, o);
 				manager_emit_updated(m, &o->this);
 				o->changed = 0;
 			}
@@ -926,6 +1000,61 @@ void *pw_manager_object_get_data(struct pw_manager_object *obj, const char *id)
 	return d ? SPA_PTROFF(d, sizeof(*d), void) : NULL;
 }
 
+const void *pw_manager_object_get_cache(struct pw_manager_object *obj, uint32_t key, size_t *size)
+{
+	struct object *o = SPA_CONTAINER_OF(obj, struct object, this);
+	uint32_t i;
+
+	for (i = 0; i < MAX_CACHE; i++) {
+		if (o->cache[i].data != NULL && o->cache[i].key == key) {
+			*size = o->cache[i].size;
+			return o->cache[i].data;
+		}
+	}
+	return NULL;
+}
+
+int pw_manager_object_set_cache(struct pw_manager_object *obj, uint32_t key,
+		const void *data, size_t size)
+{
+	struct object *o = SPA_CONTAINER_OF(obj, struct object, this);
+	struct object_cache *c = NULL;
+	void *copy;
+	uint32_t i;
+
+	if (size == 0 || size > UINT32_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < MAX_CACHE; i++) {
+		if (o->cache[i].data == NULL || o->cache[i].key == key) {
+			c = &o->cache[i];
+			break;
+		}
+	}
+	if (c == NULL) {
+		c = &o->cache[o->cache_next];
+		o->cache_next = (o->cache_next + 1) % MAX_CACHE;
+	}
+	if ((copy = malloc(size)) == NULL)
+		return -errno;
+	memcpy(copy, data, size);
+
+	free(c->data);
+	c->key = key;
+	c->size = size;
+	c->data = copy;
+	return 0;
+}
+
+void pw_manager_clear_cache(struct pw_manager *manager)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o;
+
+	spa_list_for_each(o, &m->this.object_list, this.link)
+		object_cache_clear(o);
+}
+
 int pw_manager_sync(struct pw_manager *manager)
 {
 	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
@@ -110,6 +110,13 @@ void *pw_manager_object_get_data(struct pw_manager_object *obj, const char *key)
 void *pw_manager_object_add_temporary_data(struct pw_manager_object *o, const char *key,
 		size_t size, uint64_t lifetime_nsec);
 
+/* encoded replies of an object, dropped when the object or an object that
+ * it refers to changes */
+const void *pw_manager_object_get_cache(struct pw_manager_object *o, uint32_t key, size_t *size);
+int pw_manager_object_set_cache(struct pw_manager_object *o, uint32_t key,
+		const void *data, size_t size);
+void pw_manager_clear_cache(struct pw_manager *manager);
+
 bool pw_manager_object_is_client(struct pw_manager_object *o);
 bool pw_manager_object_is_module(struct pw_manager_object *o);
 bool pw_manager_object_is_card(struct pw_manager_object *o);
@@ -20,10 +20,15 @@
 #include "client.h"
 #include "collect.h"
 #include "defs.h"
+#include "internal.h"
+#include "io-shard.h"
 #include "log.h"
 #include "manager.h"
 #include "module.h"
 #include "message-handler.h"
+#include "server.h"
+#include "shm.h"
+#include "stream.h"
 
 static int bluez_card_object_message_handler(struct client *client, struct pw_manager_object *o, const char *message, const char *params, FILE *response)
 {
@@ -175,6 +180,49 @@ static int core_object_bluetooth_headset_autoswitch(struct client *client, const
 	}
 }
 
+static int core_object_memory(struct client *client, FILE *response)
+{
+	struct impl *impl = client->impl;
+	struct server *s;
+	bool first = true;
+
+	fprintf(response, "{\"stream-buffers\":%u,\"stream-buffers-size\":%" PRIu64
+			",\"sample-cache-size\":%u,\"clients\":[",
+			impl->stat.n_stream_buffers, impl->stat.stream_buffers,
+			impl->stat.sample_cache);
+
+	spa_list_for_each(s, &impl->servers, link) {
+		struct client *c;
+		spa_list_for_each(c, &s->clients, link) {
+			union pw_map_item *item;
+			struct shm_pool *pool;
+			uint32_t n_streams = 0;
+			uint64_t buffers = 0, shm = 0;
+			char name[256];
+
+			pw_array_for_each(item, &c->streams.items) {
+				struct stream *st = item->data;
+				if (pw_map_item_is_free(item))
+					continue;
+				n_streams++;
+				buffers += st->buffer_size;
+			}
+			pw_array_for_each(pool, &c->shm_pools)
+				shm += pool->size;
+
+			if (spa_json_encode_string(name, sizeof(name),
+					c->name ? c->name : "") >= (int)sizeof(name))
+				snprintf(name, sizeof(name), "\"\"");
+			fprintf(response, "%s{\"name\":%s,\"streams\":%u,\"buffers-size\":%" PRIu64
+					",\"shm-size\":%" PRIu64 "}",
+					first ? "" : ",", name, n_streams, buffers, shm);
+			first = false;
+		}
+	}
+	fprintf(response, "]}");
+	return 0;
+}
+
 static int core_object_message_handler(struct client *client, struct pw_manager_object *o, const char *message, const char *params, FILE *response)
 {
 	pw_log_debug(": core %p object message:'%s' params:'%s'", o, message, params);
@@ -187,6 +235,8 @@ static int core_object_message_handler(struct client *client, struct pw_manager_
 				"  list-handlers                  		show available object handlers\n"
 				"  pipewire-pulse:malloc-info     		show malloc_info\n"
 				"  pipewire-pulse:malloc-trim     		run malloc_trim\n"
+				"  pipewire-pulse:memory          		show stream buffer memory per client\n"
+				"  pipewire-pulse:io-stats        		show I/O thread statistics\n"
 				"  pipewire-pulse:log-level       		update log level with <params>\n"
 				"  pipewire-pulse:list-modules    		list all module names\n"
 				"  pipewire-pulse:describe-module 		describe module info for <params>\n"
@@ -215,6 +265,10 @@ static int core_object_message_handler(struct client *client, struct pw_manager_
 		int res = malloc_trim(0);
 		fprintf(response, "%d", res);
 #endif
+	} else if (spa_streq(message, "pipewire-pulse:memory")) {
+		return core_object_memory(client, response);
+	} else if (spa_streq(message, "pipewire-pulse:io-stats")) {
+		io_shards_dump(client->impl, response);
 	} else if (spa_streq(message, "pipewire-pulse:log-level")) {
 		int res = pw_log_set_level_string(params);
 		fprintf(response, "%d", res);
@@ -651,6 +651,21 @@ int message_put(struct message *m, ...)
 	return 0;
 }
 
+int message_put_raw(struct message *m, const void *data, uint32_t size)
+{
+	if (m == NULL)
+		return -EINVAL;
+
+	if (ensure_size(m, size) > 0)
+		memcpy(m->data + m->length, data, size);
+	m->length += size;
+
+	if (m->length > m->allocated)
+		return -ENOMEM;
+
+	return 0;
+}
+
 int message_dump(enum spa_log_level level, const char *prefix, struct message *m)
 {
 	int res;
@@ -857,10 +872,40 @@ struct message *message_alloc(struct impl *impl, uint32_t channel, uint32_t size
 	return msg;
 }
 
+/* make a message of the \a size bytes in \a data, which was allocated with
+ * malloc. The message owns the data, also when this fails. */
+struct message *message_alloc_data(struct impl *impl, uint32_t channel, void *data, uint32_t size)
+{
+	struct message *msg;
+
+	if ((msg = calloc(1, sizeof(*msg))) == NULL) {
+		free(data);
+		return NULL;
+	}
+	pw_log_trace("new message %p with data size:%d", msg, size);
+	msg->impl = impl;
+	msg->impl->stat.n_allocated++;
+	msg->impl->stat.n_accumulated++;
+	msg->impl->stat.allocated += size;
+	msg->impl->stat.accumulated += size;
+
+	msg->type = MESSAGE_TYPE_UNSPECIFIED;
+	msg->channel = channel;
+	msg->data = data;
+	msg->allocated = size;
+	msg->length = size;
+
+	return msg;
+}
+
 void message_free(struct message *msg, bool dequeue, bool destroy)
 {
 	if (dequeue)
 		spa_list_remove(&msg->link);
+	if (msg->type == MESSAGE_TYPE_SUBSCRIPTION_EVENT) {
+		spa_list_remove(&msg->u.subscription_event.link);
+		msg->type = MESSAGE_TYPE_UNSPECIFIED;
+	}
 
 	if (msg->impl->stat.allocated > MAX_ALLOCATED || msg->allocated > MAX_SIZE)
 		destroy = true;
@@ -12,10 +12,14 @@
 #include <spa/support/log.h>
 
 struct impl;
+struct stream;
 
 enum message_type {
 	MESSAGE_TYPE_UNSPECIFIED,
 	MESSAGE_TYPE_SUBSCRIPTION_EVENT,
+	MESSAGE_TYPE_CREDENTIALS,	/* sent with the credentials of the server */
+	MESSAGE_TYPE_SHM_RELEASE,	/* release of a shm block of the client */
+	MESSAGE_TYPE_RECORD_DATA,	/* data is sent from the ring of a record stream */
 };
 
 struct message {
@@ -30,9 +34,17 @@ struct message {
 	enum message_type type;
 	union {
 		struct {
+			struct spa_list link;	/* in the client out_events bucket */
 			uint32_t event;
 			uint32_t index;
 		} subscription_event;
+		struct {
+			uint32_t block_id;
+		} shm_release;
+		struct {
+			struct stream *stream;
+			uint32_t index;		/* ring index of the data */
+		} record;
 	} u;
 };
 
@@ -59,9 +71,11 @@ enum {
 };
 
 struct message *message_alloc(struct impl *impl, uint32_t channel, uint32_t size);
+struct message *message_alloc_data(struct impl *impl, uint32_t channel, void *data, uint32_t size);
 void message_free(struct message *msg, bool dequeue, bool destroy);
 int message_get(struct message *m, ...);
 int message_put(struct message *m, ...);
+int message_put_raw(struct message *m, const void *data, uint32_t size);
 int message_dump(enum spa_log_level level, const char *prefix, struct message *m);
 
 #endif /* PULSE_SERVER_MESSAGE_H */
@@ -42,6 +42,7 @@
 #include "extension.h"
 #include "format.h"
 #include "internal.h"
+#include "io-shard.h"
 #include "manager.h"
 #include "message.h"
 #include "message-handler.h"
@@ -51,7 +52,9 @@
 #include "quirks.h"
 #include "reply.h"
 #include "sample.h"
+#include "sample-play.h"
 #include "server.h"
+#include "shm.h"
 #include "stream.h"
 #include "utils.h"
 #include "volume.h"
@@ -66,6 +69,8 @@
 #define DEFAULT_FORMAT		"F32"
 #define DEFAULT_POSITION	"[ FL FR ]"
 #define DEFAULT_IDLE_TIMEOUT	"0"
+#define DEFAULT_ENABLE_SHM	"true"
+#define DEFAULT_IO_THREADS	"0"
 
 #define MAX_FORMATS	32
 /* The max amount of data we send in one block when capturing. In PulseAudio this
@@ -113,7 +118,7 @@ void broadcast_subscribe_event(struct impl *impl, uint32_t facility, uint32_t ty
 static int do_command_auth(struct client *client, uint32_t command, uint32_t tag, struct message *m)
 {
 	struct message *reply;
-	uint32_t version;
+	uint32_t version, flags = 0;
 	const void *cookie;
 	size_t len;
 
@@ -128,22 +133,60 @@ static int do_command_auth(struct client *client, uint32_t command, uint32_t tag
 	if (len != NATIVE_COOKIE_LENGTH)
 		return -EINVAL;
 
-	if ((version & PROTOCOL_VERSION_MASK) >= 13)
+	if ((version & PROTOCOL_VERSION_MASK) >= 13) {
+		flags = version & PROTOCOL_FLAG_MASK;
 		version &= PROTOCOL_VERSION_MASK;
+	}
 
 	client->version = version;
 	client->authenticated = true;
 
-	pw_log_info("client:%p AUTH tag:%u version:%d", client, tag, version);
+	/* only memfd pools can be sealed against shrinking, clients that
+	 * would use POSIX shm send their data through the socket */
+	client->memfd = client->impl->defs.enable_shm && client->shm_allowed &&
+		version >= 31 && SPA_FLAG_IS_SET(flags, PROTOCOL_FLAG_SHM) &&
+		SPA_FLAG_IS_SET(flags, PROTOCOL_FLAG_MEMFD);
+	client->shm = client->memfd;
+
+	pw_log_info("client:%p AUTH tag:%u version:%d shm:%d memfd:%d", client, tag,
+			version, client->shm, client->memfd);
 
 	reply = reply_new(client, tag);
+	if (client->shm)
+		reply->type = MESSAGE_TYPE_CREDENTIALS;
 	message_put(reply,
-			TAG_U32, PROTOCOL_VERSION,
+			TAG_U32, PROTOCOL_VERSION |
+				(client->shm ? PROTOCOL_FLAG_SHM : 0) |
+				(client->memfd ? PROTOCOL_FLAG_MEMFD : 0),
 			TAG_INVALID);
 
 	return client_queue_message(client, reply);
 }
 
+static int do_register_memfd_shmid(struct client *client, uint32_t command, uint32_t tag, struct message *m)
+{
+	uint32_t shm_id;
+	int res;
+
+	if (message_get(m,
+			TAG_U32, &shm_id,
+			TAG_INVALID) < 0)
+		return -EPROTO;
+
+	if (!client->memfd || client->n_fds != 1)
+		return -EPROTO;
+
+	pw_log_info("[%s] REGISTER_MEMFD_SHMID tag:%u shm_id:%u", client->name, tag, shm_id);
+
+	/* the fd is closed after the packet, we keep the mapping */
+	if ((res = shm_pool_register_memfd(client, shm_id, client->fds[0])) < 0) {
+		pw_log_warn("[%s] can't register memfd shm_id:%u: %s", client->name,
+				shm_id, spa_strerror(res));
+		return res;
+	}
+	return 0;
+}
+
 static int reply_set_client_name(struct client *client, uint32_t tag)
 {
 	struct pw_manager *manager = client->manager;
@@ -237,6 +280,12 @@ static int send_object_event(struct client *client, struct pw_manager_object *o,
 	return 0;
 }
 
+static bool has_temporary_move_target(struct pw_manager_object *o)
+{
+	struct temporary_move_data *d = pw_manager_object_get_data(o, "temporary_move_data");
+	return d != NULL && d->peer_index != SPA_ID_INVALID;
+}
+
 static uint32_t get_temporary_move_target(struct client *client, struct pw_manager_object *o)
 {
 	struct temporary_move_data *d;
@@ -567,13 +616,16 @@ static int reply_create_playback_stream(struct stream *stream, struct pw_manager
 	uint32_t missing, peer_index;
 	const char *peer_name;
 	uint64_t lat_usec;
-
-	stream->buffer = calloc(1, MAXLENGTH);
-	if (stream->buffer == NULL)
-		return -errno;
+	int res;
 
 	lat_usec = set_playback_buffer_attr(stream, &stream->attr);
 
+	/* room for the target latency and a request, the buffer grows
+	 * when the client queues more, up to the maxlength */
+	if ((res = stream_alloc_buffer(stream,
+			(stream->attr.tlength + stream->attr.minreq) * 2)) < 0)
+		return res;
+
 	missing = stream_pop_missing(stream);
 	stream->index = id_to_index(manager, stream->id);
 	stream->lat_usec = lat_usec;
@@ -724,13 +776,13 @@ static int reply_create_record_stream(struct stream *stream, struct pw_manager_o
 	const char *peer_name, *name;
 	uint32_t peer_index;
 	uint64_t lat_usec;
-
-	stream->buffer = calloc(1, MAXLENGTH);
-	if (stream->buffer == NULL)
-		return -errno;
+	int res;
 
 	lat_usec = set_record_buffer_attr(stream, &stream->attr);
 
+	if ((res = stream_alloc_buffer(stream, stream->attr.fragsize * 4)) < 0)
+		return res;
+
 	stream->index = id_to_index(manager, stream->id);
 	stream->lat_usec = lat_usec;
 
@@ -1052,6 +1104,9 @@ static int do_set_client_name(struct client *client, uint32_t command, uint32_t
 	}
 
 	client_update_quirks(client);
+	/* the quirks are applied to the cached replies */
+	if (client->manager)
+		pw_manager_clear_cache(client->manager);
 
 	client->name = pw_properties_get(client->props, PW_KEY_APP_NAME);
 	pw_log_info("[%s] %s tag:%d", client->name,
@@ -1288,6 +1343,7 @@ struct process_data {
 	struct pw_time pwt;
 	uint32_t read_inc;
 	uint32_t write_inc;
+	uint32_t dropped;
 	uint32_t underrun_for;
 	uint32_t playing_for;
 	uint32_t minreq;
@@ -1302,7 +1358,6 @@ do_process_done(struct spa_loop *loop,
 {
 	struct stream *stream = user_data;
 	struct client *client = stream->client;
-	struct impl *impl = client->impl;
 	const struct process_data *pd = data;
 	uint32_t index, towrite;
 	int32_t avail;
@@ -1336,6 +1391,7 @@ do_process_done(struct spa_loop *loop,
 		if (pd->idle) {
 			if (!stream->is_idle) {
 				stream->idle_time = stream->timestamp;
+				stream_trim_buffer(stream);
 			} else if (!stream->is_paused &&
 			    stream->idle_timeout_sec > 0 &&
 			    stream->timestamp - stream->idle_time >
@@ -1350,12 +1406,33 @@ do_process_done(struct spa_loop *loop,
 
 		stream_send_request(stream);
 	} else {
-		struct message *msg;
+		int res;
+
 		stream->write_index += pd->write_inc;
 
+		/* the data thread dropped data because the ring was full of
+		 * unsent data, warn once for each overrun */
+		if ((pd->dropped > 0) != stream->is_overrun) {
+			stream->is_overrun = pd->dropped > 0;
+			if (stream->is_overrun)
+				pw_log_warn("%p: [%s] overrun, dropping record data write:%"PRIu64,
+						stream, client->name, stream->write_index);
+		}
+
 		avail = spa_ringbuffer_get_read_index(&stream->ring, &index);
 
+		/* the client is not keeping up, make room for more data */
+		if (avail > 0 && (uint32_t)avail <= stream->buffer_size &&
+		    (uint32_t)avail > stream->buffer_size / 2)
+			stream_ensure_buffer(stream, avail * 2);
+
 		if (!spa_list_is_empty(&client->out_messages)) {
+			/* queued record data is sent from the ring and the data
+			 * thread does not overwrite it, copy it out before the
+			 * ring fills up and new data is dropped */
+			if (avail > 0 && (uint32_t)avail > stream->buffer_size / 2)
+				stream_detach_record_data(stream);
+
 			pw_log_debug("%p: [%s] pending read:%u avail:%d",
 					stream, client->name, index, avail);
 			return 0;
@@ -1367,14 +1444,16 @@ do_process_done(struct spa_loop *loop,
 			pw_log_warn("%p: [%s] underrun read:%u avail:%d",
 					stream, client->name, index, avail);
 		} else {
-			if ((uint32_t)avail > stream->attr.maxlength) {
+			uint32_t max = SPA_MIN(stream->attr.maxlength, stream->buffer_size);
+			if ((uint32_t)avail > max) {
 				uint32_t skip = avail - stream->attr.fragsize;
 				/* overrun, catch up to latest fragment and send it */
 				pw_log_warn("%p: [%s] overrun recover read:%u avail:%d max:%u skip:%u",
-					stream, client->name, index, avail, stream->attr.maxlength, skip);
+					stream, client->name, index, avail, max, skip);
 				index += skip;
 				stream->read_index += skip;
 				avail = stream->attr.fragsize;
+				spa_ringbuffer_read_update(&stream->ring, index);
 			}
 			pw_log_trace("avail:%d index:%u", avail, index);
 
@@ -1383,22 +1462,13 @@ do_process_done(struct spa_loop *loop,
 				towrite = SPA_MIN(towrite, stream->attr.fragsize);
 				towrite = SPA_ROUND_DOWN(towrite, stream->frame_size);
 
-				msg = message_alloc(impl, stream->channel, towrite);
-				if (msg == NULL)
-					return -errno;
-
-				spa_ringbuffer_read_data(&stream->ring,
-						stream->buffer, MAXLENGTH,
-						index % MAXLENGTH,
-						msg->data, towrite);
-
-				client_queue_message(client, msg);
+				if ((res = stream_queue_record_data(stream, index, towrite)) < 0)
+					return res;
 
 				index += towrite;
 				avail -= towrite;
 				stream->read_index += towrite;
 			}
-			spa_ringbuffer_read_update(&stream->ring, index);
 		}
 	}
 	return 0;
@@ -1461,8 +1531,8 @@ static void stream_process(void *data)
 				if (avail > 0) {
 					avail = SPA_MIN((uint32_t)avail, size);
 					spa_ringbuffer_read_data(&stream->ring,
-						stream->buffer, MAXLENGTH,
-						index % MAXLENGTH,
+						stream->buffer, stream->buffer_size,
+						index % stream->buffer_size,
 						p, avail);
 					empty = false;
 				}
@@ -1476,23 +1546,23 @@ static void stream_process(void *data)
 			pw_log_debug("%p: [%s] underrun read:%u avail:%d max:%u",
 					stream, client->name, index, avail, minreq);
 		} else {
-			if (avail > (int32_t)stream->attr.maxlength) {
-				uint32_t skip = avail - stream->attr.maxlength;
+			uint32_t max = SPA_MIN(stream->attr.maxlength, stream->buffer_size);
+			if (avail > (int32_t)max) {
+				uint32_t skip = avail - max;
 				/* overrun, reported by other side, here we skip
 				 * ahead to the oldest data. */
 				pw_log_debug("%p: [%s] overrun read:%u avail:%d max:%u skip:%u",
-						stream, client->name, index, avail,
-						stream->attr.maxlength, skip);
+						stream, client->name, index, avail, max, skip);
 				index += skip;
 				pd.read_inc = skip;
-				avail = stream->attr.maxlength;
+				avail = max;
 			}
 			size = SPA_MIN(d->maxsize, (uint32_t)avail);
 			size = SPA_MIN(size, minreq);
 
 			spa_ringbuffer_read_data(&stream->ring,
-					stream->buffer, MAXLENGTH,
-					index % MAXLENGTH,
+					stream->buffer, stream->buffer_size,
+					index % stream->buffer_size,
 					p, size);
 
 			index += size;
@@ -1526,12 +1596,24 @@ static void stream_process(void *data)
 					stream, client->name, index, filled,
 					size, stream->attr.maxlength);
 		}
+		if (filled >= 0 && (uint32_t)filled + size > stream->buffer_size) {
+			/* the unread data can still be queued for sending
+			 * from the ring, only write what fits and drop the rest */
+			uint32_t avail = (uint32_t)filled < stream->buffer_size ?
+				SPA_ROUND_DOWN(stream->buffer_size - filled,
+						stream->frame_size) : 0;
+			pw_log_trace_fp("%p: [%s] overrun write:%u filled:%d size:%u drop:%u",
+					stream, client->name, index, filled,
+					size, size - avail);
+			pd.dropped = size - avail;
+			size = avail;
+		}
 
 		spa_ringbuffer_write_data(&stream->ring,
-				stream->buffer, MAXLENGTH,
-				index % MAXLENGTH,
+				stream->buffer, stream->buffer_size,
+				index % stream->buffer_size,
 				SPA_PTROFF(p, offs, void),
-				SPA_MIN(size, MAXLENGTH));
+				SPA_MIN(size, stream->buffer_size));
 
 		index += size;
 		pd.write_inc = size;
@@ -2344,9 +2426,8 @@ static int do_create_upload_stream(struct client *client, uint32_t command, uint
 
 	stream->props = props;
 
-	stream->buffer = calloc(1, MAXLENGTH);
-	if (stream->buffer == NULL)
-		goto error_errno;
+	if ((res = stream_alloc_buffer(stream, length)) < 0)
+		goto error;
 
 	reply = reply_new(client, tag);
 	message_put(reply,
@@ -2402,49 +2483,39 @@ static int do_finish_upload_stream(struct client *client, uint32_t command, uint
 			client->name, commands[command].name, tag,
 			channel, name);
 
-	struct sample *old = find_sample(impl, SPA_ID_INVALID, name);
-	if (old == NULL || old->ref > 1) {
-		sample = calloc(1, sizeof(*sample));
-		if (sample == NULL)
-			goto error_errno;
+	sample = calloc(1, sizeof(*sample));
+	if (sample == NULL)
+		goto error_errno;
 
-		if (old != NULL) {
-			sample->index = old->index;
-			spa_assert_se(pw_map_insert_at(&impl->samples, sample->index, sample) == 0);
+	sample->ref = 1;
+	sample->index = SPA_ID_INVALID;
+	sample->impl = impl;
+	sample->name = name;
 
-			old->index = SPA_ID_INVALID;
-			sample_unref(old);
-		} else {
-			sample->index = pw_map_insert_new(&impl->samples, sample);
-			if (sample->index == SPA_ID_INVALID)
-				goto error_errno;
-		}
-	} else {
-		pw_properties_free(old->props);
-		free(old->buffer);
-		impl->stat.sample_cache -= old->length;
+	/* convert before replacing the old sample, it stays when this fails */
+	if ((res = sample_set_data(sample, &stream->ss, &stream->map,
+					stream->buffer, stream->attr.maxlength)) < 0)
+		goto error_free;
 
-		sample = old;
-	}
+	struct sample *old = find_sample(impl, SPA_ID_INVALID, name);
+	if (old != NULL) {
+		sample->index = old->index;
+		spa_assert_se(pw_map_insert_at(&impl->samples, sample->index, sample) == 0);
 
-	if (old != NULL)
+		old->index = SPA_ID_INVALID;
+		sample_unref(old);
 		event = SUBSCRIPTION_EVENT_CHANGE;
-	else
+	} else {
+		sample->index = pw_map_insert_new(&impl->samples, sample);
+		if (sample->index == SPA_ID_INVALID) {
+			res = -errno;
+			goto error_free;
+		}
 		event = SUBSCRIPTION_EVENT_NEW;
+	}
 
-	sample->ref = 1;
-	sample->impl = impl;
-	sample->name = name;
 	sample->props = stream->props;
-	sample->ss = stream->ss;
-	sample->map = stream->map;
-	sample->buffer = stream->buffer;
-	sample->length = stream->attr.maxlength;
-
-	impl->stat.sample_cache += sample->length;
-
 	stream->props = NULL;
-	stream->buffer = NULL;
 	stream_free(stream);
 
 	broadcast_subscribe_event(impl,
@@ -2454,9 +2525,11 @@ static int do_finish_upload_stream(struct client *client, uint32_t command, uint
 
 	return reply_simple_ack(client, tag);
 
+error_free:
+	sample_unref(sample);
+	goto error;
 error_errno:
 	res = -errno;
-	free(sample);
 	goto error;
 error_invalid:
 	res = -EINVAL;
@@ -4230,6 +4303,35 @@ static int fill_source_output_info(struct client *client, struct message *m,
 	return 0;
 }
 
+/* Use the encoded reply of the object when it did not change since the last
+ * request. The cache is per client, so the version and quirks of the client
+ * are part of it. */
+static int fill_info_cached(struct client *client, struct message *m,
+		struct pw_manager_object *o, uint32_t key,
+		int (*fill_func) (struct client *client, struct message *m, struct pw_manager_object *o))
+{
+	const void *data;
+	uint32_t offset = m->length;
+	size_t size;
+	bool cache;
+	int res;
+
+	/* temporary move targets are only reported to the client that
+	 * made the move */
+	cache = key != SPA_ID_INVALID && !has_temporary_move_target(o);
+
+	if (cache && (data = pw_manager_object_get_cache(o, key, &size)) != NULL)
+		return message_put_raw(m, data, size);
+
+	if ((res = fill_func(client, m, o)) < 0)
+		return res;
+
+	if (cache && m->length > offset && m->length <= m->allocated)
+		pw_manager_object_set_cache(o, key, m->data + offset, m->length - offset);
+
+	return res;
+}
+
 static int do_get_info(struct client *client, uint32_t command, uint32_t tag, struct message *m)
 {
 	struct impl *impl = client->impl;
@@ -4239,6 +4341,7 @@ static int do_get_info(struct client *client, uint32_t command, uint32_t tag, st
 	struct pw_manager_object *o;
 	struct selector sel;
 	int (*fill_func) (struct client *client, struct message *m, struct pw_manager_object *o) = NULL;
+	uint32_t cache_key = SPA_ID_INVALID;
 
 	spa_zero(sel);
 
@@ -4271,24 +4374,29 @@ static int do_get_info(struct client *client, uint32_t command, uint32_t tag, st
 		sel.type = pw_manager_object_is_card;
 		sel.key = PW_KEY_DEVICE_NAME;
 		fill_func = fill_card_info;
+		cache_key = COMMAND_GET_CARD_INFO;
 		break;
 	case COMMAND_GET_SINK_INFO:
 		sel.type = pw_manager_object_is_sink;
 		sel.key = PW_KEY_NODE_NAME;
 		fill_func = fill_sink_info;
+		cache_key = COMMAND_GET_SINK_INFO;
 		break;
 	case COMMAND_GET_SOURCE_INFO:
 		sel.type = pw_manager_object_is_source_or_monitor;
 		sel.key = PW_KEY_NODE_NAME;
 		fill_func = fill_source_info;
+		cache_key = COMMAND_GET_SOURCE_INFO;
 		break;
 	case COMMAND_GET_SINK_INPUT_INFO:
 		sel.type = pw_manager_object_is_sink_input;
 		fill_func = fill_sink_input_info;
+		cache_key = COMMAND_GET_SINK_INPUT_INFO;
 		break;
 	case COMMAND_GET_SOURCE_OUTPUT_INFO:
 		sel.type = pw_manager_object_is_source_output;
 		fill_func = fill_source_output_info;
+		cache_key = COMMAND_GET_SOURCE_OUTPUT_INFO;
 		break;
 	}
 	if (sel.key) {
@@ -4317,7 +4425,7 @@ static int do_get_info(struct client *client, uint32_t command, uint32_t tag, st
 	if (o == NULL)
 		goto error_noentity;
 
-	if ((res = fill_func(client, reply, o)) < 0)
+	if ((res = fill_info_cached(client, reply, o, cache_key, fill_func)) < 0)
 		goto error;
 
 	return client_queue_message(client, reply);
@@ -4435,13 +4543,14 @@ static int do_get_sample_info_list(struct client *client, uint32_t command, uint
 struct info_list_data {
 	struct client *client;
 	struct message *reply;
+	uint32_t cache_key;
 	int (*fill_func) (struct client *client, struct message *m, struct pw_manager_object *o);
 };
 
 static int do_list_info(void *data, struct pw_manager_object *object)
 {
 	struct info_list_data *info = data;
-	info->fill_func(info->client, info->reply, object);
+	fill_info_cached(info->client, info->reply, object, info->cache_key, info->fill_func);
 	return 0;
 }
 
@@ -4464,6 +4573,7 @@ static int do_get_info_list(struct client *client, uint32_t command, uint32_t ta
 
 	spa_zero(info);
 	info.client = client;
+	info.cache_key = SPA_ID_INVALID;
 
 	switch (command) {
 	case COMMAND_GET_CLIENT_INFO_LIST:
@@ -4474,18 +4584,23 @@ static int do_get_info_list(struct client *client, uint32_t command, uint32_t ta
 		break;
 	case COMMAND_GET_CARD_INFO_LIST:
 		info.fill_func = fill_card_info;
+		info.cache_key = COMMAND_GET_CARD_INFO;
 		break;
 	case COMMAND_GET_SINK_INFO_LIST:
 		info.fill_func = fill_sink_info;
+		info.cache_key = COMMAND_GET_SINK_INFO;
 		break;
 	case COMMAND_GET_SOURCE_INFO_LIST:
 		info.fill_func = fill_source_info;
+		info.cache_key = COMMAND_GET_SOURCE_INFO;
 		break;
 	case COMMAND_GET_SINK_INPUT_INFO_LIST:
 		info.fill_func = fill_sink_input_info;
+		info.cache_key = COMMAND_GET_SINK_INPUT_INFO;
 		break;
 	case COMMAND_GET_SOURCE_OUTPUT_INFO_LIST:
 		info.fill_func = fill_source_output_info;
+		info.cache_key = COMMAND_GET_SOURCE_OUTPUT_INFO;
 		break;
 	default:
 		return -ENOTSUP;
@@ -5375,7 +5490,7 @@ const struct command commands[COMMAND_MAX] =
 
 	/* Supported since protocol v31 (9.0)
 	 * BOTH DIRECTIONS */
-	COMMAND(REGISTER_MEMFD_SHMID, do_error_access),
+	COMMAND(REGISTER_MEMFD_SHMID, do_register_memfd_shmid, COMMAND_ACCESS_WITHOUT_MANAGER),
 
 	/* Supported since protocol v35 (15.0) */
 	COMMAND(SEND_OBJECT_MESSAGE, do_send_object_message),
@@ -5414,6 +5529,9 @@ static void impl_clear(struct impl *impl)
 	spa_list_consume(c, &impl->cleanup_clients, link)
 		client_free(c);
 
+	sample_players_clear(impl);
+	io_shards_clear(impl);
+
 	spa_list_consume(msg, &impl->free_messages, link)
 		message_free(msg, true, true);
 
@@ -5537,6 +5655,8 @@ static void load_defaults(struct defs *def, struct pw_properties *props)
 	parse_format(props, "pulse.default.format", DEFAULT_FORMAT, &def->sample_spec);
 	parse_position(props, "pulse.default.position", DEFAULT_POSITION, &def->channel_map);
 	parse_uint32(props, "pulse.idle.timeout", DEFAULT_IDLE_TIMEOUT, &def->idle_timeout);
+	parse_bool(props, "pulse.enable-shm", DEFAULT_ENABLE_SHM, &def->enable_shm);
+	parse_uint32(props, "pulse.io-threads", DEFAULT_IO_THREADS, &def->io_threads);
 	def->sample_spec.channels = def->channel_map.channels;
 	def->quantum_limit = 8192;
 }
@@ -5561,6 +5681,7 @@ struct pw_protocol_pulse *pw_protocol_pulse_new(struct pw_context *context,
 	spa_list_init(&impl->servers);
 	pw_map_init(&impl->samples, 16, 16);
 	pw_map_init(&impl->modules, 16, 16);
+	spa_list_init(&impl->sample_players);
 	spa_list_init(&impl->cleanup_clients);
 	spa_list_init(&impl->free_messages);
 
@@ -5620,6 +5741,9 @@ struct pw_protocol_pulse *pw_protocol_pulse_new(struct pw_context *context,
 	load_defaults(&impl->defs, props);
 	impl->props = spa_steal_ptr(props);
 
+	if ((res = io_shards_init(impl, impl->defs.io_threads)) < 0)
+		goto error_free;
+
 	pw_context_add_listener(context, &impl->context_listener,
 			&context_events, impl);
 	impl->context = context;
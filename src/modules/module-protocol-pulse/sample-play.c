@@ -10,12 +10,15 @@
 #include <spa/node/io.h>
 #include <spa/param/audio/raw.h>
 #include <spa/pod/builder.h>
+#include <spa/utils/atomic.h>
 #include <spa/utils/hook.h>
+#include <spa/utils/string.h>
 #include <pipewire/context.h>
 #include <pipewire/core.h>
 #include <pipewire/log.h>
 #include <pipewire/properties.h>
 #include <pipewire/stream.h>
+#include <pipewire/work-queue.h>
 
 #include "defs.h"
 #include "format.h"
@@ -24,153 +27,293 @@
 #include "sample-play.h"
 #include "internal.h"
 
-static void sample_play_stream_state_changed(void *data, enum pw_stream_state old,
-					     enum pw_stream_state state, const char *error)
+struct sample_player {
+	struct spa_list link;
+	struct impl *impl;
+	struct pw_core *core;
+	char *role;
+	char *target;
+	struct sample_spec ss;
+	struct channel_map map;
+	uint32_t stride;
+
+	struct pw_stream *stream;
+	struct spa_hook listener;
+	struct pw_loop *data_loop;
+	struct spa_source *drained;
+	struct pw_timer timer;
+	uint32_t id;
+
+	struct spa_list plays;
+	uint32_t n_plays;
+
+	/* data thread */
+	struct spa_list voices;
+
+	unsigned int streaming:1;
+	unsigned int failed:1;
+};
+
+static void player_destroy(struct sample_player *pl)
+{
+	struct impl *impl = pl->impl;
+
+	pw_log_info("%p: destroy sample player id:%u", pl, pl->id);
+
+	spa_list_remove(&pl->link);
+	pw_timer_queue_cancel(&pl->timer);
+
+	if (pl->stream) {
+		spa_hook_remove(&pl->listener);
+		pw_stream_destroy(pl->stream);
+	}
+	pw_loop_destroy_source(impl->main_loop, pl->drained);
+
+	free(pl->role);
+	free(pl->target);
+	free(pl);
+}
+
+static void player_idle_timeout(void *user_data)
 {
-	struct sample_play *p = data;
+	struct sample_player *pl = user_data;
+
+	if (pl->n_plays == 0)
+		player_destroy(pl);
+}
+
+/* called when the last sample stopped playing. Keep the player around for a
+ * while so that the next sample can play without creating a stream. */
+static void player_release(struct sample_player *pl)
+{
+	struct impl *impl = pl->impl;
+
+	if (!pl->failed)
+		pw_stream_set_active(pl->stream, false);
+
+	pw_timer_queue_cancel(&pl->timer);
+	pw_timer_queue_add(impl->timer_queue, &pl->timer, NULL,
+			pl->failed ? 0 : SAMPLE_PLAYER_IDLE_TIMEOUT,
+			player_idle_timeout, pl);
+}
+
+static void play_ready(struct sample_play *p)
+{
+	if (p->ready || p->done)
+		return;
+
+	p->ready = true;
+	p->id = p->player->id;
+	sample_play_emit_ready(p, p->id);
+}
+
+static void play_done(struct sample_play *p, int res)
+{
+	if (p->done)
+		return;
+
+	p->done = true;
+	pw_timer_queue_cancel(&p->timer);
+	sample_play_emit_done(p, res);
+}
+
+static void player_stream_state_changed(void *data, enum pw_stream_state old,
+					enum pw_stream_state state, const char *error)
+{
+	struct sample_player *pl = data;
+	struct sample_play *p, *t;
 
 	switch (state) {
 	case PW_STREAM_STATE_UNCONNECTED:
 	case PW_STREAM_STATE_ERROR:
-		pw_timer_queue_cancel(&p->timer);
-		sample_play_emit_done(p, -EIO);
+		if (pl->failed)
+			break;
+		pw_log_info("%p: sample player failed: %s", pl, error);
+		pl->failed = true;
+		spa_list_for_each_safe(p, t, &pl->plays, link)
+			play_done(p, -EIO);
+		if (pl->n_plays == 0)
+			player_release(pl);
 		break;
 	case PW_STREAM_STATE_PAUSED:
-		p->id = pw_stream_get_node_id(p->stream);
-		sample_play_emit_ready(p, p->id);
+		pl->streaming = false;
+		pl->id = pw_stream_get_node_id(pl->stream);
+		spa_list_for_each_safe(p, t, &pl->plays, link)
+			play_ready(p);
 		break;
 	case PW_STREAM_STATE_STREAMING:
-		pw_timer_queue_cancel(&p->timer);
+		pl->streaming = true;
+		spa_list_for_each(p, &pl->plays, link)
+			pw_timer_queue_cancel(&p->timer);
 		break;
 	default:
 		break;
 	}
 }
 
-static void sample_play_start_timeout(void *user_data)
+/* the stream is destroyed with the core of the client */
+static void player_stream_destroy(void *data)
 {
-	struct sample_play *p = user_data;
+	struct sample_player *pl = data;
+	struct sample_play *p, *t;
 
-	pw_log_info("timeout on sample %s", p->sample->name);
+	spa_hook_remove(&pl->listener);
+	pl->stream = NULL;
+	pl->failed = true;
 
-	if (p->stream)
-		pw_stream_set_active(p->stream, false);
-	sample_play_emit_done(p, -ETIMEDOUT);
+	spa_list_for_each_safe(p, t, &pl->plays, link)
+		play_done(p, -EIO);
+	if (pl->n_plays == 0)
+		player_destroy(pl);
 }
 
-static void sample_play_stream_destroy(void *data)
+static void player_stream_process(void *data)
 {
-	struct sample_play *p = data;
-
-	pw_log_info("destroy %s", p->sample->name);
-
-	spa_hook_remove(&p->listener);
-	p->stream = NULL;
-
-	sample_unref(p->sample);
-	p->sample = NULL;
-}
-
-static void sample_play_stream_process(void *data)
-{
-	struct sample_play *p = data;
-	struct sample *s = p->sample;
+	struct sample_player *pl = data;
+	struct sample_play *p, *t;
 	struct pw_buffer *b;
 	struct spa_buffer *buf;
-	uint32_t size;
-	uint8_t *d;
+	uint32_t i, size, n_samples;
+	bool drained = false;
+	float *d;
 
-	if (p->offset >= s->length) {
-		pw_stream_flush(p->stream, true);
-		return;
-	}
-
-	size = s->length - p->offset;
-
-	if ((b = pw_stream_dequeue_buffer(p->stream)) == NULL) {
+	if ((b = pw_stream_dequeue_buffer(pl->stream)) == NULL) {
 		pw_log_warn("out of buffers: %m");
 		return;
 	}
 
 	buf = b->buffer;
-	if ((d = buf->datas[0].data) == NULL)
+	if ((d = buf->datas[0].data) == NULL) {
+		pw_stream_queue_buffer(pl->stream, b);
 		return;
+	}
 
-	size = SPA_MIN(size, buf->datas[0].maxsize);
+	size = buf->datas[0].maxsize;
 	if (b->requested)
-		size = SPA_MIN(size, b->requested * p->stride);
-
-	memcpy(d, s->buffer + p->offset, size);
-
-	p->offset += size;
+		size = SPA_MIN(size, b->requested * pl->stride);
+	size -= size % pl->stride;
+	n_samples = size / sizeof(float);
+
+	memset(d, 0, size);
+
+	spa_list_for_each_safe(p, t, &pl->voices, voice_link) {
+		const struct sample *s = p->sample;
+		const float *src = SPA_PTROFF(s->buffer, p->offset, const float);
+		uint32_t n = SPA_MIN(n_samples, (s->length - p->offset) / sizeof(float));
+
+		for (i = 0; i < n; i++)
+			d[i] += src[i];
+
+		p->offset += n * sizeof(float);
+		if (p->offset >= s->length) {
+			spa_list_remove(&p->voice_link);
+			p->mixing = false;
+			SPA_ATOMIC_STORE(p->drained, 1);
+			drained = true;
+		}
+	}
 
 	buf->datas[0].chunk->offset = 0;
-	buf->datas[0].chunk->stride = p->stride;
+	buf->datas[0].chunk->stride = pl->stride;
 	buf->datas[0].chunk->size = size;
 
-	pw_stream_queue_buffer(p->stream, b);
+	pw_stream_queue_buffer(pl->stream, b);
+
+	if (drained)
+		pw_loop_signal_event(pl->impl->main_loop, pl->drained);
 }
 
-static void sample_play_stream_drained(void *data)
+static const struct pw_stream_events player_stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.destroy = player_stream_destroy,
+	.state_changed = player_stream_state_changed,
+	.process = player_stream_process,
+};
+
+static void on_player_drained(void *data, uint64_t count)
 {
-	struct sample_play *p = data;
+	struct sample_player *pl = data;
+	struct sample_play *p, *t;
 
-	sample_play_emit_done(p, 0);
+	spa_list_for_each_safe(p, t, &pl->plays, link) {
+		if (SPA_ATOMIC_LOAD(p->drained))
+			play_done(p, 0);
+	}
 }
 
-static const struct pw_stream_events sample_play_stream_events = {
-	PW_VERSION_STREAM_EVENTS,
-	.state_changed = sample_play_stream_state_changed,
-	.destroy = sample_play_stream_destroy,
-	.process = sample_play_stream_process,
-	.drained = sample_play_stream_drained,
-};
+static struct sample_player *find_player(struct impl *impl, struct pw_core *core,
+		const char *role, const char *target, const struct sample *sample)
+{
+	struct sample_player *pl;
+
+	spa_list_for_each(pl, &impl->sample_players, link) {
+		if (pl->failed ||
+		    pl->core != core ||
+		    !spa_streq(pl->role, role) ||
+		    !spa_streq(pl->target, target) ||
+		    pl->ss.rate != sample->ss.rate ||
+		    pl->ss.channels != sample->ss.channels ||
+		    memcmp(pl->map.map, sample->map.map,
+			    pl->map.channels * sizeof(uint32_t)) != 0)
+			continue;
+		return pl;
+	}
+	return NULL;
+}
 
-struct sample_play *sample_play_new(struct pw_core *core,
-				    struct sample *sample, struct pw_properties *props,
-				    size_t user_data_size)
+/* the player stream gets the properties of the first play, the plays that
+ * share it have the same client, role and target */
+static struct sample_player *player_new(struct impl *impl, struct pw_core *core,
+		const struct sample *sample, const struct pw_properties *play_props)
 {
-	struct sample_play *p;
+	struct sample_player *pl;
 	uint8_t buffer[1024];
 	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
 	const struct spa_pod *params[1];
 	uint32_t n_params = 0;
+	struct pw_properties *props;
+	const char *str;
 	int res;
 
-	p = calloc(1, sizeof(*p) + user_data_size);
-	if (p == NULL) {
+	pl = calloc(1, sizeof(*pl));
+	if (pl == NULL)
+		return NULL;
+
+	pl->impl = impl;
+	pl->core = core;
+	if ((str = pw_properties_get(play_props, PW_KEY_MEDIA_ROLE)) != NULL)
+		pl->role = strdup(str);
+	if ((str = pw_properties_get(play_props, PW_KEY_TARGET_OBJECT)) != NULL)
+		pl->target = strdup(str);
+	pl->ss = sample->ss;
+	pl->map = sample->map;
+	pl->stride = sample_spec_frame_size(&pl->ss);
+	pl->id = SPA_ID_INVALID;
+	spa_list_init(&pl->plays);
+	spa_list_init(&pl->voices);
+
+	pl->drained = pw_loop_add_event(impl->main_loop, on_player_drained, pl);
+	if (pl->drained == NULL) {
 		res = -errno;
 		goto error_free;
 	}
 
-	p->context = pw_core_get_context(core);
-	p->main_loop = pw_context_get_main_loop(p->context);
-	spa_hook_list_init(&p->hooks);
-	p->user_data = SPA_PTROFF(p, sizeof(struct sample_play), void);
-
-	pw_properties_update(props, &sample->props->dict);
-
-	p->stream = pw_stream_new(core, sample->name, props);
-	props = NULL;
-	if (p->stream == NULL) {
+	if ((props = pw_properties_copy(play_props)) == NULL) {
 		res = -errno;
-		goto error_free;
+		goto error_source;
 	}
-
-	/* safe to increment the reference count here because it will be decreased
-	   by the stream's 'destroy' event handler, which will be called
-	   (even if `pw_stream_connect()` fails) */
-	p->sample = sample_ref(sample);
-	p->stride = sample_spec_frame_size(&sample->ss);
-
-	pw_stream_add_listener(p->stream,
-			&p->listener,
-			&sample_play_stream_events, p);
+	pl->stream = pw_stream_new(core, sample->name, props);
+	if (pl->stream == NULL) {
+		res = -errno;
+		goto error_source;
+	}
+	pw_stream_add_listener(pl->stream, &pl->listener,
+			&player_stream_events, pl);
 
 	params[n_params++] = format_build_param(&b, SPA_PARAM_EnumFormat,
-			&sample->ss, &sample->map);
+			&pl->ss, &pl->map);
 
-	res = pw_stream_connect(p->stream,
+	res = pw_stream_connect(pl->stream,
 			PW_DIRECTION_OUTPUT,
 			PW_ID_ANY,
 			PW_STREAM_FLAG_AUTOCONNECT |
@@ -178,33 +321,148 @@ struct sample_play *sample_play_new(struct pw_core *core,
 			PW_STREAM_FLAG_RT_PROCESS,
 			params, n_params);
 	if (res < 0)
-		goto error_cleanup;
+		goto error_stream;
+
+	pl->data_loop = pw_stream_get_data_loop(pl->stream);
+	spa_list_append(&impl->sample_players, &pl->link);
+
+	pw_log_info("%p: new sample player role:%s target:%s rate:%u channels:%u", pl,
+			pl->role, pl->target, pl->ss.rate, pl->ss.channels);
+
+	return pl;
+
+error_stream:
+	spa_hook_remove(&pl->listener);
+	pw_stream_destroy(pl->stream);
+error_source:
+	pw_loop_destroy_source(impl->main_loop, pl->drained);
+error_free:
+	free(pl->role);
+	free(pl->target);
+	free(pl);
+	errno = -res;
+	return NULL;
+}
+
+static int do_add_voice(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct sample_play *p = user_data;
+
+	spa_list_append(&p->player->voices, &p->voice_link);
+	p->mixing = true;
+	return 0;
+}
+
+static int do_remove_voice(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct sample_play *p = user_data;
+
+	if (p->mixing) {
+		spa_list_remove(&p->voice_link);
+		p->mixing = false;
+	}
+	return 0;
+}
+
+static void sample_play_start_timeout(void *user_data)
+{
+	struct sample_play *p = user_data;
+
+	pw_log_info("timeout on sample %s", p->sample->name);
+
+	play_done(p, -ETIMEDOUT);
+}
+
+static void do_sample_play_ready(void *obj, void *data, int res, uint32_t id)
+{
+	play_ready(obj);
+}
+
+struct sample_play *sample_play_new(struct pw_core *core,
+				    struct sample *sample, struct pw_properties *props,
+				    size_t user_data_size)
+{
+	struct impl *impl = sample->impl;
+	struct sample_player *pl;
+	struct sample_play *p;
+	int res;
+
+	pw_properties_update(props, &sample->props->dict);
+
+	/* plays go through the core of their client so that its policy and
+	 * permissions apply */
+	pl = find_player(impl, core, pw_properties_get(props, PW_KEY_MEDIA_ROLE),
+			pw_properties_get(props, PW_KEY_TARGET_OBJECT), sample);
+	if (pl == NULL) {
+		pl = player_new(impl, core, sample, props);
+		if (pl == NULL) {
+			res = -errno;
+			goto error_free;
+		}
+	}
+
+	p = calloc(1, sizeof(*p) + user_data_size);
+	if (p == NULL) {
+		res = -errno;
+		if (pl->n_plays == 0)
+			player_release(pl);
+		goto error_free;
+	}
+
+	p->player = pl;
+	p->sample = sample_ref(sample);
+	p->id = SPA_ID_INVALID;
+	spa_hook_list_init(&p->hooks);
+	p->user_data = SPA_PTROFF(p, sizeof(struct sample_play), void);
+
+	spa_list_append(&pl->plays, &p->link);
+	if (pl->n_plays++ == 0) {
+		pw_timer_queue_cancel(&pl->timer);
+		pw_stream_set_active(pl->stream, true);
+	}
+
+	pw_loop_invoke(pl->data_loop, do_add_voice, 0, NULL, 0, true, p);
+
+	/* the listeners are added after we return */
+	if (pl->id != SPA_ID_INVALID)
+		pw_work_queue_add(impl->work_queue, p, 0, do_sample_play_ready, NULL);
 
 	/* Time out if we don't get a link; same timeout as for normal streams */
-	pw_timer_queue_add(sample->impl->timer_queue, &p->timer, NULL,
-			STREAM_CREATE_TIMEOUT, sample_play_start_timeout, p);
+	if (!pl->streaming)
+		pw_timer_queue_add(impl->timer_queue, &p->timer, NULL,
+				STREAM_CREATE_TIMEOUT, sample_play_start_timeout, p);
+
+	pw_log_info("play sample %s on player %p id:%u", sample->name, pl, pl->id);
 
+	pw_properties_free(props);
 	return p;
 
-error_cleanup:
-	pw_stream_destroy(p->stream);
 error_free:
 	pw_properties_free(props);
-	free(p);
 	errno = -res;
 	return NULL;
 }
 
 void sample_play_destroy(struct sample_play *p)
 {
-	if (p->stream)
-		pw_stream_destroy(p->stream);
-
-	spa_hook_list_clean(&p->hooks);
+	struct sample_player *pl = p->player;
+	struct impl *impl = pl->impl;
 
+	pw_work_queue_cancel(impl->work_queue, p, SPA_ID_INVALID);
 	pw_timer_queue_cancel(&p->timer);
 
+	pw_loop_invoke(pl->data_loop, do_remove_voice, 0, NULL, 0, true, p);
+
+	spa_list_remove(&p->link);
+	spa_hook_list_clean(&p->hooks);
+
+	sample_unref(p->sample);
 	free(p);
+
+	if (--pl->n_plays == 0)
+		player_release(pl);
 }
 
 void sample_play_add_listener(struct sample_play *p, struct spa_hook *listener,
@@ -212,3 +470,11 @@ void sample_play_add_listener(struct sample_play *p, struct spa_hook *listener,
 {
 	spa_hook_list_append(&p->hooks, listener, events, data);
 }
+
+void sample_players_clear(struct impl *impl)
+{
+	struct sample_player *pl;
+
+	spa_list_consume(pl, &impl->sample_players, link)
+		player_destroy(pl);
+}
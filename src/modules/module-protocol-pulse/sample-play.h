@@ -13,11 +13,10 @@
 
 #include <pipewire/pipewire.h>
 
+struct impl;
 struct sample;
 struct pw_core;
-struct pw_loop;
-struct pw_stream;
-struct pw_context;
+struct sample_player;
 struct pw_properties;
 
 struct sample_play_events {
@@ -32,19 +31,26 @@ struct sample_play_events {
 #define sample_play_emit_ready(p,i) spa_hook_list_call(&p->hooks, struct sample_play_events, ready, 0, i)
 #define sample_play_emit_done(p,r) spa_hook_list_call(&p->hooks, struct sample_play_events, done, 0, r)
 
+/* A sample play is a voice in a sample player. There is one player stream
+ * per client core, media role, target sink and sample format, it mixes all
+ * the samples that are playing on it. */
 struct sample_play {
 	struct spa_list link;
+	struct sample_player *player;
 	struct sample *sample;
-	struct pw_stream *stream;
 	uint32_t id;
-	struct spa_hook listener;
-	struct pw_context *context;
-	struct pw_loop *main_loop;
-	uint32_t offset;
-	uint32_t stride;
 	struct spa_hook_list hooks;
 	struct pw_timer timer;
 	void *user_data;
+
+	/* data thread */
+	struct spa_list voice_link;
+	uint32_t offset;
+	bool mixing;
+	int drained;
+
+	unsigned int ready:1;
+	unsigned int done:1;
 };
 
 struct sample_play *sample_play_new(struct pw_core *core,
@@ -56,4 +62,6 @@ void sample_play_destroy(struct sample_play *p);
 void sample_play_add_listener(struct sample_play *p, struct spa_hook *listener,
 			      const struct sample_play_events *events, void *data);
 
+void sample_players_clear(struct impl *impl);
+
 #endif /* PULSER_SERVER_SAMPLE_PLAY_H */
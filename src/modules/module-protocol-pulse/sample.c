@@ -2,29 +2,222 @@
 /* SPDX-FileCopyrightText: Copyright © 2020 Wim Taymans */
 /* SPDX-License-Identifier: MIT */
 
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <spa/buffer/buffer.h>
+#include <spa/param/audio/raw.h>
+#include <pipewire/context.h>
 #include <pipewire/log.h>
 #include <pipewire/map.h>
+#include <pipewire/mem.h>
 #include <pipewire/properties.h>
 
 #include "internal.h"
 #include "log.h"
 #include "sample.h"
 
-void sample_free(struct sample *sample)
+static inline uint32_t read_le(const uint8_t *s, uint32_t size)
+{
+	uint32_t i, v = 0;
+	for (i = 0; i < size; i++)
+		v |= (uint32_t)s[i] << (8 * i);
+	return v;
+}
+
+static inline uint32_t read_be(const uint8_t *s, uint32_t size)
+{
+	uint32_t i, v = 0;
+	for (i = 0; i < size; i++)
+		v = (v << 8) | s[i];
+	return v;
+}
+
+static inline float bits_to_f32(uint32_t v)
+{
+	float f;
+	memcpy(&f, &v, sizeof(f));
+	return f;
+}
+
+/* sign extend the lower bits of v */
+static inline int32_t sext(uint32_t v, uint32_t bits)
+{
+	return (int32_t)(v << (32 - bits)) >> (32 - bits);
+}
+
+static int16_t alaw_to_s16(uint8_t a)
+{
+	int16_t t, seg;
+
+	a ^= 0x55;
+	t = (a & 0x0f) << 4;
+	seg = (a & 0x70) >> 4;
+	switch (seg) {
+	case 0:
+		t += 8;
+		break;
+	case 1:
+		t += 0x108;
+		break;
+	default:
+		t += 0x108;
+		t <<= seg - 1;
+		break;
+	}
+	return (a & 0x80) ? t : -t;
+}
+
+static int16_t ulaw_to_s16(uint8_t u)
+{
+	int16_t t;
+
+	u = ~u;
+	t = ((u & 0x0f) << 3) + 0x84;
+	t <<= (u & 0x70) >> 4;
+	return (u & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+static int convert_to_f32(float *d, const uint8_t *s, uint32_t format, uint32_t n_samples)
+{
+	uint32_t i;
+
+	switch (format) {
+	case SPA_AUDIO_FORMAT_U8:
+		for (i = 0; i < n_samples; i++)
+			d[i] = ((int32_t)s[i] - 0x80) / 128.0f;
+		break;
+	case SPA_AUDIO_FORMAT_ALAW:
+		for (i = 0; i < n_samples; i++)
+			d[i] = alaw_to_s16(s[i]) / 32768.0f;
+		break;
+	case SPA_AUDIO_FORMAT_ULAW:
+		for (i = 0; i < n_samples; i++)
+			d[i] = ulaw_to_s16(s[i]) / 32768.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S16_LE:
+		for (i = 0; i < n_samples; i++, s += 2)
+			d[i] = sext(read_le(s, 2), 16) / 32768.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S16_BE:
+		for (i = 0; i < n_samples; i++, s += 2)
+			d[i] = sext(read_be(s, 2), 16) / 32768.0f;
+		break;
+	case SPA_AUDIO_FORMAT_F32_LE:
+		for (i = 0; i < n_samples; i++, s += 4)
+			d[i] = bits_to_f32(read_le(s, 4));
+		break;
+	case SPA_AUDIO_FORMAT_F32_BE:
+		for (i = 0; i < n_samples; i++, s += 4)
+			d[i] = bits_to_f32(read_be(s, 4));
+		break;
+	case SPA_AUDIO_FORMAT_S32_LE:
+		for (i = 0; i < n_samples; i++, s += 4)
+			d[i] = (int32_t)read_le(s, 4) / 2147483648.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S32_BE:
+		for (i = 0; i < n_samples; i++, s += 4)
+			d[i] = (int32_t)read_be(s, 4) / 2147483648.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S24_LE:
+		for (i = 0; i < n_samples; i++, s += 3)
+			d[i] = sext(read_le(s, 3), 24) / 8388608.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S24_BE:
+		for (i = 0; i < n_samples; i++, s += 3)
+			d[i] = sext(read_be(s, 3), 24) / 8388608.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S24_32_LE:
+		for (i = 0; i < n_samples; i++, s += 4)
+			d[i] = sext(read_le(s, 4), 24) / 8388608.0f;
+		break;
+	case SPA_AUDIO_FORMAT_S24_32_BE:
+		for (i = 0; i < n_samples; i++, s += 4)
+			d[i] = sext(read_be(s, 4), 24) / 8388608.0f;
+		break;
+	default:
+		return -ENOTSUP;
+	}
+	return 0;
+}
+
+/* Samples are converted to F32 when they are uploaded so that they can be
+ * mixed directly by the sample players. The converted data lives in a
+ * sealed memfd that is never written again. */
+int sample_set_data(struct sample *sample, const struct sample_spec *ss,
+		const struct channel_map *map, const void *data, uint32_t length)
 {
 	struct impl * const impl = sample->impl;
+	struct sample_spec fss = *ss;
+	struct pw_memblock *mem;
+	uint32_t frame_size, n_frames, size;
+	int res;
 
-	pw_log_info("free sample id:%u name:%s", sample->index, sample->name);
+	frame_size = sample_spec_frame_size(ss);
+	if (frame_size == 0)
+		return -EINVAL;
+
+	fss.format = SPA_AUDIO_FORMAT_F32;
+	n_frames = length / frame_size;
+	size = n_frames * sample_spec_frame_size(&fss);
+	if (size / sample_spec_frame_size(&fss) != n_frames)
+		return -ENOSPC;
+
+	mem = pw_mempool_alloc(pw_context_get_mempool(impl->context),
+			PW_MEMBLOCK_FLAG_READWRITE |
+			PW_MEMBLOCK_FLAG_SEAL |
+			PW_MEMBLOCK_FLAG_MAP |
+			PW_MEMBLOCK_FLAG_RT,
+			SPA_DATA_MemFd, SPA_MAX(size, 1u));
+	if (mem == NULL)
+		return -errno;
+
+	if ((res = convert_to_f32(mem->map->ptr, data, ss->format,
+					n_frames * ss->channels)) < 0) {
+		pw_memblock_unref(mem);
+		return res;
+	}
+
+	sample_clear_data(sample);
+
+	sample->ss = fss;
+	sample->map = *map;
+	sample->mem = mem;
+	sample->buffer = mem->map->ptr;
+	sample->length = size;
+
+	impl->stat.sample_cache += size;
+
+	return 0;
+}
+
+void sample_clear_data(struct sample *sample)
+{
+	struct impl * const impl = sample->impl;
+
+	if (sample->mem == NULL)
+		return;
 
 	impl->stat.sample_cache -= sample->length;
 
+	pw_memblock_unref(sample->mem);
+	sample->mem = NULL;
+	sample->buffer = NULL;
+	sample->length = 0;
+}
+
+void sample_free(struct sample *sample)
+{
+	struct impl * const impl = sample->impl;
+
+	pw_log_info("free sample id:%u name:%s", sample->index, sample->name);
+
 	if (sample->index != SPA_ID_INVALID)
 		pw_map_remove(&impl->samples, sample->index);
 
 	pw_properties_free(sample->props);
 
-	free(sample->buffer);
+	sample_clear_data(sample);
 	free(sample);
 }
@@ -10,6 +10,7 @@
 #include "format.h"
 
 struct impl;
+struct pw_memblock;
 struct pw_properties;
 
 struct sample {
@@ -22,8 +23,13 @@ struct sample {
 	struct pw_properties *props;
 	uint32_t length;
 	uint8_t *buffer;
+	struct pw_memblock *mem;
 };
 
+int sample_set_data(struct sample *sample, const struct sample_spec *ss,
+		const struct channel_map *map, const void *data, uint32_t length);
+void sample_clear_data(struct sample *sample);
+
 void sample_free(struct sample *sample);
 
 static inline struct sample *sample_ref(struct sample *sample)
@@ -33,10 +33,12 @@
 #include "commands.h"
 #include "defs.h"
 #include "internal.h"
+#include "io-shard.h"
 #include "log.h"
 #include "message.h"
 #include "reply.h"
 #include "server.h"
+#include "shm.h"
 #include "stream.h"
 #include "utils.h"
 #include "flatpak-utils.h"
@@ -94,6 +96,7 @@ static int handle_packet(struct client *client, struct message *msg)
 	res = cmd->run(client, command, tag, msg);
 
 finish:
+	client_close_fds(client);
 	message_free(msg, false, false);
 	if (res < 0)
 		reply_error(client, command, tag, res);
@@ -104,7 +107,7 @@ finish:
 static void stream_clear_data(struct stream *stream,
 		uint32_t offset, uint32_t len)
 {
-	uint32_t l0 = SPA_MIN(len, MAXLENGTH - offset), l1 = len - l0;
+	uint32_t l0 = SPA_MIN(len, stream->buffer_size - offset), l1 = len - l0;
 	sample_spec_silence(&stream->ss, SPA_PTROFF(stream->buffer, offset, void), l0);
 	if (SPA_UNLIKELY(l1 > 0))
 		sample_spec_silence(&stream->ss, stream->buffer, l1);
@@ -113,8 +116,9 @@ static void stream_clear_data(struct stream *stream,
 static int handle_memblock(struct client *client, struct message *msg)
 {
 	struct stream *stream;
-	uint32_t channel, flags, index;
-	int64_t offset, diff;
+	uint32_t channel, flags, index, length, block_id = SPA_ID_INVALID;
+	const void *data;
+	int64_t offset, diff, need;
 	int32_t filled;
 	int res = 0;
 
@@ -124,8 +128,30 @@ static int handle_memblock(struct client *client, struct message *msg)
 		(((uint64_t) ntohl(client->desc.offset_lo))));
 	flags = ntohl(client->desc.flags);
 
+	data = msg->data;
+	length = msg->length;
+
+	if (flags & FLAG_SHMDATA) {
+		/* the data is in a pool of the client, we copy it from there
+		 * into the ringbuffer and release the block right away */
+		struct shm_info info;
+
+		memcpy(&info, msg->data, sizeof(info));
+		length = ntohl(info.length);
+		data = shm_pool_get_data(client, flags & FLAG_SHMDATA_MEMFD_BLOCK,
+				ntohl(info.shm_id), ntohl(info.index), length);
+		if (data == NULL || length == 0 || length > FRAME_SIZE_MAX_ALLOW) {
+			pw_log_warn("client %p [%s]: invalid shm block shm:%u index:%u length:%u: %m",
+				    client, client->name, ntohl(info.shm_id),
+				    ntohl(info.index), length);
+			res = -EPROTO;
+			goto finish;
+		}
+		block_id = ntohl(info.block_id);
+	}
+
 	pw_log_debug("client %p: received memblock channel:%d offset:%" PRIi64 " flags:%08x size:%u",
-		     client, channel, offset, flags, msg->length);
+		     client, channel, offset, flags, length);
 
 	stream = pw_map_lookup(&client->streams, channel);
 	if (stream == NULL || stream->type == STREAM_TYPE_RECORD) {
@@ -136,7 +162,7 @@ static int handle_memblock(struct client *client, struct message *msg)
 
 	filled = spa_ringbuffer_get_write_index(&stream->ring, &index);
 	pw_log_debug("new block %p %p/%u filled:%d index:%d flags:%02x offset:%" PRIu64,
-		     msg, msg->data, msg->length, filled, index, flags, offset);
+		     msg, data, length, filled, index, flags, offset);
 
 	switch (flags & FLAG_SEEKMASK) {
 	case SEEK_RELATIVE:
@@ -156,13 +182,20 @@ static int handle_memblock(struct client *client, struct message *msg)
 		goto finish;
 	}
 
+	/* the client queues more than we sized the buffer for, grow it
+	 * up to the maxlength before writing */
+	need = SPA_MAX(filled + diff, 0) + length;
+	if (need > stream->buffer_size)
+		stream_ensure_buffer(stream, SPA_MIN(need, UINT32_MAX));
+
 	if (diff > 0) {
 		pw_log_debug("clear gap of %"PRIu64, diff);
 		/* if we jump forwards, clear the data we skipped because we might otherwise
 		 * play back old data. FIXME, if the write pointer goes backwards and
 		 * forwards, this might clear valid data. We should probably keep track of
 		 * the highest write pointer and only clear when we go past that one. */
-		stream_clear_data(stream, index % MAXLENGTH, SPA_MIN(diff, MAXLENGTH));
+		stream_clear_data(stream, index % stream->buffer_size,
+				SPA_MIN(diff, stream->buffer_size));
 	}
 
 	index += diff;
@@ -173,7 +206,7 @@ static int handle_memblock(struct client *client, struct message *msg)
 
 	if (filled < 0) {
 		/* underrun, reported on reader side */
-	} else if (filled + msg->length > stream->attr.maxlength) {
+	} else if (filled + length > stream->attr.maxlength) {
 		/* overrun */
 		stream_send_overflow(stream);
 	}
@@ -181,15 +214,15 @@ static int handle_memblock(struct client *client, struct message *msg)
 	/* always write data to ringbuffer, we expect the other side
 	 * to recover */
 	spa_ringbuffer_write_data(&stream->ring,
-			stream->buffer, MAXLENGTH,
-			index % MAXLENGTH,
-			msg->data,
-			SPA_MIN(msg->length, MAXLENGTH));
-	index += msg->length;
+			stream->buffer, stream->buffer_size,
+			index % stream->buffer_size,
+			data,
+			SPA_MIN(length, stream->buffer_size));
+	index += length;
 	spa_ringbuffer_write_update(&stream->ring, index);
 
-	stream->write_index += msg->length;
-	stream->requested -= msg->length;
+	stream->write_index += length;
+	stream->requested -= length;
 
 	stream_send_request(stream);
 
@@ -197,10 +230,72 @@ static int handle_memblock(struct client *client, struct message *msg)
 		stream_set_paused(stream, false, "new data");
 
 finish:
+	if (block_id != SPA_ID_INVALID)
+		shm_pool_release(client, block_id);
 	message_free(msg, false, false);
 	return res;
 }
 
+static ssize_t client_recv(struct client *client, void *data, size_t size)
+{
+	/* fds are sent with REGISTER_MEMFD_SHMID, keep them until the
+	 * packet is handled */
+	return recv_fds(client->source->fd, data, size,
+			client->fds, &client->n_fds, MAX_FDS);
+}
+
+/* check a frame header, returns 1 when the frame has no payload and is
+ * complete */
+int server_check_descriptor(const struct descriptor *desc, bool shm)
+{
+	uint32_t flags, length, channel;
+
+	flags = ntohl(desc->flags);
+	length = ntohl(desc->length);
+	channel = ntohl(desc->channel);
+
+	if ((flags & FLAG_SHMMASK) == FLAG_SHMRELEASE ||
+	    (flags & FLAG_SHMMASK) == FLAG_SHMREVOKE) {
+		/* we don't export memory to clients, there is nothing to
+		 * release or revoke */
+		if (channel != (uint32_t) -1 || length != 0)
+			return -EPROTO;
+		return 1;
+	} else if ((flags & FLAG_SHMDATA) != 0) {
+		if (!shm || channel == (uint32_t) -1 ||
+		    length != sizeof(struct shm_info)) {
+			pw_log_warn("received invalid shm frame channel:%u length:%u",
+				    channel, length);
+			return -EPROTO;
+		}
+	} else if ((flags & FLAG_SHMMASK) != 0) {
+		return -EPROTO;
+	}
+
+	if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
+		pw_log_warn("received invalid frame size: %u", length);
+		return -EPROTO;
+	}
+
+	if (channel == (uint32_t) -1) {
+		if (flags != 0) {
+			pw_log_warn("received packet frame with invalid flags: %08x",
+				    flags);
+			return -EPROTO;
+		}
+	}
+	return 0;
+}
+
+static int handle_message(struct client *client, struct message *msg)
+{
+	if (msg->channel == (uint32_t)-1)
+		return handle_packet(client, msg);
+
+	client_close_fds(client);
+	return handle_memblock(client, msg);
+}
+
 static int do_read(struct client *client)
 {
 	struct impl * const impl = client->impl;
@@ -224,7 +319,7 @@ static int do_read(struct client *client)
 	}
 
 	while (true) {
-		ssize_t r = recv(client->source->fd, data, size, MSG_DONTWAIT);
+		ssize_t r = client_recv(client, data, size);
 
 		if (r == 0 && size != 0) {
 			res = -EPIPE;
@@ -244,36 +339,20 @@ static int do_read(struct client *client)
 	}
 
 	if (client->in_index == sizeof(client->desc)) {
-		uint32_t flags, length, channel;
-
-		flags = ntohl(client->desc.flags);
-		if ((flags & FLAG_SHMMASK) != 0) {
-			res = -EPROTO;
-			goto exit;
-		}
-
-		length = ntohl(client->desc.length);
-		if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
-			pw_log_warn("client %p: received invalid frame size: %u",
-				    client, length);
-			res = -EPROTO;
-			goto exit;
-		}
-
-		channel = ntohl(client->desc.channel);
-		if (channel == (uint32_t) -1) {
-			if (flags != 0) {
-				pw_log_warn("client %p: received packet frame with invalid flags",
-					    client);
-				res = -EPROTO;
-				goto exit;
+		if ((res = server_check_descriptor(&client->desc, client->shm)) != 0) {
+			if (res > 0) {
+				client_close_fds(client);
+				client->in_index = 0;
+				res = 0;
 			}
+			goto exit;
 		}
 
 		if (client->message)
 			message_free(client->message, false, false);
 
-		client->message = message_alloc(impl, channel, length);
+		client->message = message_alloc(impl, ntohl(client->desc.channel),
+				ntohl(client->desc.length));
 	} else if (client->message &&
 	    client->in_index >= client->message->length + sizeof(client->desc)) {
 		struct message * const msg = client->message;
@@ -281,10 +360,7 @@ static int do_read(struct client *client)
 		client->message = NULL;
 		client->in_index = 0;
 
-		if (msg->channel == (uint32_t)-1)
-			res = handle_packet(client, msg);
-		else
-			res = handle_memblock(client, msg);
+		res = handle_message(client, msg);
 	}
 
 exit:
@@ -333,6 +409,41 @@ done:
 	return;
 
 error:
+	server_client_error(client, res);
+	goto done;
+}
+
+int server_handle_frame(struct client *client, const struct descriptor *desc,
+		void *data, const int *fds, uint32_t n_fds)
+{
+	struct impl * const impl = client->impl;
+	struct message *msg;
+	uint32_t i;
+	int res;
+
+	client_close_fds(client);
+	for (i = 0; i < n_fds; i++)
+		client->fds[client->n_fds++] = fds[i];
+
+	/* the I/O thread checked the header without knowing if the client
+	 * can use shm */
+	client->desc = *desc;
+	if ((res = server_check_descriptor(desc, client->shm)) != 0) {
+		free(data);
+		client_close_fds(client);
+		return SPA_MIN(res, 0);
+	}
+
+	msg = message_alloc_data(impl, ntohl(desc->channel), data, ntohl(desc->length));
+	if (msg == NULL) {
+		client_close_fds(client);
+		return -errno;
+	}
+	return handle_message(client, msg);
+}
+
+void server_client_error(struct client *client, int res)
+{
 	switch (res) {
 	case -EPIPE:
 	case -ECONNRESET:
@@ -344,8 +455,8 @@ error:
 		 * drop the server's reference to the client
 		 * (if it hasn't been dropped already),
 		 * it is guaranteed that this will not call `client_free()`
-		 * since at the beginning of this function an extra reference
-		 * has been acquired which will keep the client alive
+		 * since the caller holds an extra reference which will keep
+		 * the client alive
 		 */
 		if (client_detach(client))
 			client_unref(client);
@@ -358,8 +469,6 @@ error:
 			     client->server, client, client->name, res, spa_strerror(res));
 		break;
 	}
-
-	goto done;
 }
 
 static void
@@ -403,9 +512,12 @@ on_connect(void *data, int fd, uint32_t mask)
 
 	pw_log_debug("server %p: new client %p fd:%d", server, client, client_fd);
 
+	/* with I/O threads, the socket is read in one of the threads and the
+	 * main loop only writes the replies */
 	client->source = pw_loop_add_io(impl->main_loop,
 					client_fd,
-					SPA_IO_ERR | SPA_IO_HUP | SPA_IO_IN,
+					SPA_IO_ERR | SPA_IO_HUP |
+					(impl->n_io_shards > 0 ? 0 : SPA_IO_IN),
 					true, on_client_data, client);
 	if (client->source == NULL)
 		goto error;
@@ -448,6 +560,11 @@ on_connect(void *data, int fd, uint32_t mask)
 			pw_log_warn("setsockopt(SO_PRIORITY) failed: %m");
 #endif
 		pid = get_client_pid(client, client_fd);
+
+		/* like PulseAudio, only use shm with clients of the same user.
+		 * Sandboxed clients don't get it either. */
+		client->shm_allowed = client_access == NULL && is_same_user(client, client_fd);
+
 		if (pid != 0 && pw_check_flatpak(pid, &app_id, &instance_id, &devices) == 1) {
 			/*
 			 * XXX: we should really use Portal client access here
@@ -469,6 +586,7 @@ on_connect(void *data, int fd, uint32_t mask)
 			 * for it.
 			 */
 			client_access = "flatpak";
+			client->shm_allowed = false;
 			pw_properties_set(client->props, "pipewire.access.portal.app_id",
 					app_id);
 			pw_properties_set(client->props, "pipewire.access.portal.instance_id",
@@ -485,6 +603,7 @@ on_connect(void *data, int fd, uint32_t mask)
 #ifdef HAVE_SNAP
 		snap_access = pw_snap_get_audio_permissions(client, client_fd, &snap_app_id);
 		if ((snap_access & PW_SANDBOX_ACCESS_NOT_A_SANDBOX) == 0) {
+			client->shm_allowed = false;
 			pw_properties_set(client->props, PW_KEY_SNAP_ID, snap_app_id);
 
 			pw_properties_set(client->props,
@@ -513,6 +632,9 @@ on_connect(void *data, int fd, uint32_t mask)
 	}
 	pw_properties_set(client->props, PW_KEY_CLIENT_ACCESS, client_access);
 
+	if (impl->n_io_shards > 0 && io_shard_add_client(client) < 0)
+		goto error;
+
 	return;
 
 error:
@@ -5,6 +5,7 @@
 #ifndef PULSER_SERVER_SERVER_H
 #define PULSER_SERVER_SERVER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <sys/socket.h>
@@ -13,6 +14,8 @@
 #include <spa/utils/hook.h>
 
 struct impl;
+struct client;
+struct descriptor;
 struct pw_array;
 struct spa_source;
 
@@ -37,4 +40,9 @@ struct server {
 int servers_create_and_start(struct impl *impl, const char *addresses, struct pw_array *servers);
 void server_free(struct server *server);
 
+int server_check_descriptor(const struct descriptor *desc, bool shm);
+int server_handle_frame(struct client *client, const struct descriptor *desc,
+		void *data, const int *fds, uint32_t n_fds);
+void server_client_error(struct client *client, int res);
+
 #endif /* PULSER_SERVER_SERVER_H */
@@ -0,0 +1,147 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <spa/utils/defs.h>
+#include <pipewire/array.h>
+#include <pipewire/log.h>
+
+#include "client.h"
+#include "defs.h"
+#include "log.h"
+#include "message.h"
+#include "shm.h"
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS	1033
+#endif
+#ifndef F_GET_SEALS
+#define F_GET_SEALS	1034
+#endif
+#ifndef F_SEAL_SHRINK
+#define F_SEAL_SHRINK	0x0002
+#endif
+
+static struct shm_pool *find_pool(struct client *client, uint32_t shm_id)
+{
+	struct shm_pool *p;
+
+	pw_array_for_each(p, &client->shm_pools) {
+		if (p->id == shm_id)
+			return p;
+	}
+	return NULL;
+}
+
+static struct shm_pool *add_pool(struct client *client, uint32_t shm_id, int fd)
+{
+	struct shm_pool *p;
+	struct stat st;
+	void *data;
+	int seals;
+
+	if (pw_array_get_len(&client->shm_pools, struct shm_pool) >= MAX_SHM_POOLS) {
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	/* a pool that shrinks under our mapping would make us crash with
+	 * SIGBUS when we read it. Only use pools that can't shrink anymore,
+	 * libpulse creates its memfds with sealing allowed and never resizes
+	 * them. The size is taken after the seal is in place. */
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) < 0 ||
+	    (seals = fcntl(fd, F_GET_SEALS)) < 0 ||
+	    !SPA_FLAG_IS_SET(seals, F_SEAL_SHRINK)) {
+		pw_log_info("client %p: can't seal shm:%u: %m", client, shm_id);
+		errno = EPERM;
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0)
+		return NULL;
+
+	/* the segment must belong to us, we only do shm with clients of the
+	 * same user */
+	if (st.st_uid != getuid()) {
+		errno = EPERM;
+		return NULL;
+	}
+	if (st.st_size <= 0 || st.st_size > SHM_POOL_SIZE_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	p = pw_array_add(&client->shm_pools, sizeof(*p));
+	if (p == NULL) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+	p->id = shm_id;
+	p->data = data;
+	p->size = st.st_size;
+
+	pw_log_debug("client %p: added pool shm:%u size:%zu", client, shm_id, p->size);
+	return p;
+}
+
+int shm_pool_register_memfd(struct client *client, uint32_t shm_id, int fd)
+{
+	if (find_pool(client, shm_id) != NULL)
+		return -EEXIST;
+	if (add_pool(client, shm_id, fd) == NULL)
+		return -errno;
+	return 0;
+}
+
+const void *shm_pool_get_data(struct client *client, bool memfd, uint32_t shm_id,
+		uint32_t index, uint32_t length)
+{
+	struct shm_pool *p;
+
+	/* POSIX shm segments can't be sealed, only registered memfd pools
+	 * are used */
+	if (!memfd || (p = find_pool(client, shm_id)) == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+	if (index > p->size || length > p->size - index) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return SPA_PTROFF(p->data, index, void);
+}
+
+int shm_pool_release(struct client *client, uint32_t block_id)
+{
+	struct message *msg;
+
+	msg = message_alloc(client->impl, -1, 0);
+	if (msg == NULL)
+		return -errno;
+
+	msg->type = MESSAGE_TYPE_SHM_RELEASE;
+	msg->u.shm_release.block_id = block_id;
+
+	return client_queue_message(client, msg);
+}
+
+void shm_pools_clear(struct client *client)
+{
+	struct shm_pool *p;
+
+	pw_array_for_each(p, &client->shm_pools)
+		munmap(p->data, p->size);
+	pw_array_clear(&client->shm_pools);
+}
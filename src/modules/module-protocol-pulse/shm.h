@@ -0,0 +1,35 @@
+/* PipeWire */
+/* SPDX-FileCopyrightText: Copyright © 2026 PipeWire authors */
+/* SPDX-License-Identifier: MIT */
+
+#ifndef PULSE_SERVER_SHM_H
+#define PULSE_SERVER_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct client;
+
+/* a sealed memfd of a client, mapped read-only */
+struct shm_pool {
+	uint32_t id;
+	void *data;
+	size_t size;
+};
+
+/* the payload of a frame with FLAG_SHMDATA, in network byte order */
+struct shm_info {
+	uint32_t block_id;
+	uint32_t shm_id;
+	uint32_t index;
+	uint32_t length;
+};
+
+int shm_pool_register_memfd(struct client *client, uint32_t shm_id, int fd);
+const void *shm_pool_get_data(struct client *client, bool memfd, uint32_t shm_id,
+		uint32_t index, uint32_t length);
+int shm_pool_release(struct client *client, uint32_t block_id);
+void shm_pools_clear(struct client *client);
+
+#endif /* PULSE_SERVER_SHM_H */
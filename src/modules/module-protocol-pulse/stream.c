@@ -5,6 +5,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <spa/utils/hook.h>
 #include <spa/utils/ringbuffer.h>
@@ -143,6 +146,8 @@ void stream_free(struct stream *stream)
 	if (stream->killed)
 		stream_send_killed(stream);
 
+	stream_detach_record_data(stream);
+
 	if (stream->stream) {
 		spa_hook_remove(&stream->stream_listener);
 		pw_stream_disconnect(stream->stream);
@@ -158,8 +163,7 @@ void stream_free(struct stream *stream)
 
 	pw_work_queue_cancel(impl->work_queue, stream, SPA_ID_INVALID);
 
-	if (stream->buffer)
-		free(stream->buffer);
+	free(stream_take_buffer(stream));
 
 	pw_properties_free(stream->props);
 
@@ -183,9 +187,266 @@ void stream_flush(struct stream *stream)
 
 		stream_send_request(stream);
 	} else {
+		/* the data that was queued for sending stays queued */
+		stream_detach_record_data(stream);
+
 		stream->ring.readindex = stream->ring.writeindex;
 		stream->read_index = stream->write_index;
 	}
+	stream_trim_buffer(stream);
+}
+
+/* Queue record data for sending without copying it. The data stays in the
+ * ring until it was sent, only then the read index of the ring is moved. */
+int stream_queue_record_data(struct stream *stream, uint32_t index, uint32_t length)
+{
+	struct message *msg;
+
+	/* no room is allocated for the data, that only happens when the data
+	 * needs to be detached from the ring */
+	msg = message_alloc(stream->impl, stream->channel, 0);
+	if (msg == NULL)
+		return -errno;
+
+	msg->type = MESSAGE_TYPE_RECORD_DATA;
+	msg->length = length;
+	msg->u.record.stream = stream;
+	msg->u.record.index = index;
+
+	return client_queue_message(stream->client, msg);
+}
+
+uint32_t stream_get_record_iov(struct stream *stream, uint32_t index, uint32_t length,
+		struct iovec iov[2])
+{
+	uint32_t offset = index % stream->buffer_size;
+	uint32_t l0 = SPA_MIN(length, stream->buffer_size - offset);
+	uint32_t n_iov = 0;
+
+	iov[n_iov++] = (struct iovec) { SPA_PTROFF(stream->buffer, offset, void), l0 };
+	if (length > l0)
+		iov[n_iov++] = (struct iovec) { stream->buffer, length - l0 };
+	return n_iov;
+}
+
+static int detach_record_message(struct stream *stream, struct message *m)
+{
+	struct iovec iov[2];
+	uint32_t i, n_iov, length = m->length;
+	int res = 0;
+
+	n_iov = stream_get_record_iov(stream, m->u.record.index, length, iov);
+
+	m->length = 0;
+	for (i = 0; i < n_iov && res >= 0; i++)
+		res = message_put_raw(m, iov[i].iov_base, iov[i].iov_len);
+	m->length = length;
+
+	return res;
+}
+
+/* Copy the queued record data of the stream into the messages so that the
+ * ring can be reused, for flush and before the ring is overwritten or freed. */
+void stream_detach_record_data(struct stream *stream)
+{
+	struct client *client = stream->client;
+	struct message *m, *t, *first;
+	uint32_t index = 0;
+	bool found = false;
+	int res;
+
+	if (stream->type != STREAM_TYPE_RECORD)
+		return;
+
+	first = spa_list_first(&client->out_messages, struct message, link);
+
+	spa_list_for_each_safe(m, t, &client->out_messages, link) {
+		if (m->type != MESSAGE_TYPE_RECORD_DATA ||
+		    m->u.record.stream != stream)
+			continue;
+
+		index = m->u.record.index + m->length;
+		found = true;
+
+		if (client->disconnect) {
+			/* never sent, only freed */
+			m->length = 0;
+		} else if ((res = detach_record_message(stream, m)) < 0) {
+			pw_log_warn("%p: [%s] can't detach record data: %s",
+					stream, client->name, spa_strerror(res));
+			if (m == first && client->out_index > 0) {
+				/* partially sent, the client can't be
+				 * resynced, make it disconnect */
+				m->length = 0;
+				shutdown(client->source->fd, SHUT_RDWR);
+			} else {
+				message_free(m, true, false);
+				continue;
+			}
+		}
+		m->type = MESSAGE_TYPE_UNSPECIFIED;
+	}
+	if (found) {
+		pw_log_debug("%p: [%s] detached record data up to %u",
+				stream, client->name, index);
+		spa_ringbuffer_read_update(&stream->ring, index);
+	}
+}
+
+static inline uint32_t next_pow2(uint32_t v)
+{
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	return v + 1;
+}
+
+static uint32_t buffer_size_max(struct stream *stream)
+{
+	uint32_t max = next_pow2(SPA_CLAMP(stream->attr.maxlength, 1u, MAXLENGTH));
+	return SPA_MAX(max, stream->min_buffer_size);
+}
+
+int stream_alloc_buffer(struct stream *stream, uint32_t size)
+{
+	struct impl *impl = stream->impl;
+
+	if (stream->buffer != NULL)
+		return 0;
+
+	/* uploads are filled exactly once, other streams use a power of 2
+	 * so that the ring offsets stay continuous when the index wraps */
+	if (stream->type != STREAM_TYPE_UPLOAD)
+		size = next_pow2(SPA_CLAMP(size, MIN_BUFFER_SIZE, MAXLENGTH));
+
+	stream->buffer = calloc(1, size);
+	if (stream->buffer == NULL)
+		return -errno;
+
+	stream->buffer_size = size;
+	stream->min_buffer_size = size;
+
+	impl->stat.n_stream_buffers++;
+	impl->stat.stream_buffers += size;
+
+	pw_log_debug("%p: allocated buffer of %u bytes, max:%u",
+			stream, size, buffer_size_max(stream));
+	return 0;
+}
+
+void *stream_take_buffer(struct stream *stream)
+{
+	struct impl *impl = stream->impl;
+	void *buffer = stream->buffer;
+
+	if (buffer != NULL) {
+		impl->stat.n_stream_buffers--;
+		impl->stat.stream_buffers -= stream->buffer_size;
+	}
+	stream->buffer = NULL;
+	stream->buffer_size = 0;
+	return buffer;
+}
+
+struct buffer_swap {
+	void *buffer;
+	uint32_t size;
+};
+
+static int do_swap_buffer(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct stream *stream = user_data;
+	const struct buffer_swap *swap = data;
+	uint32_t index, avail;
+	int32_t filled;
+
+	filled = stream->ring.writeindex - stream->ring.readindex;
+	avail = SPA_CLAMP(filled, 0, (int32_t)stream->buffer_size);
+	if (avail > swap->size)
+		return -ENOSPC;
+
+	/* move the queued data to the same ring offsets in the new buffer */
+	index = stream->ring.writeindex - avail;
+	while (avail > 0) {
+		uint32_t o0 = index % stream->buffer_size;
+		uint32_t o1 = index % swap->size;
+		uint32_t l = SPA_MIN(avail, SPA_MIN(stream->buffer_size - o0, swap->size - o1));
+
+		memcpy(SPA_PTROFF(swap->buffer, o1, void),
+				SPA_PTROFF(stream->buffer, o0, void), l);
+		index += l;
+		avail -= l;
+	}
+	stream->buffer = swap->buffer;
+	stream->buffer_size = swap->size;
+	return 0;
+}
+
+static int stream_resize_buffer(struct stream *stream, uint32_t size)
+{
+	struct impl *impl = stream->impl;
+	struct pw_loop *loop = stream->stream ? pw_stream_get_data_loop(stream->stream) : NULL;
+	struct buffer_swap swap;
+	uint32_t old_size = stream->buffer_size;
+	void *old = stream->buffer;
+	int res;
+
+	/* allocate and prefault here, the data thread only copies the
+	 * queued data and swaps the pointers */
+	swap.buffer = malloc(size);
+	if (swap.buffer == NULL)
+		return -errno;
+	memset(swap.buffer, 0, size);
+	swap.size = size;
+
+	if (loop != NULL)
+		res = pw_loop_invoke(loop, do_swap_buffer, 0, &swap, sizeof(swap), true, stream);
+	else
+		res = do_swap_buffer(NULL, false, 0, &swap, sizeof(swap), stream);
+
+	if (res < 0) {
+		free(swap.buffer);
+		return res;
+	}
+	free(old);
+
+	impl->stat.stream_buffers += size;
+	impl->stat.stream_buffers -= old_size;
+
+	pw_log_debug("%p: [%s] resized buffer %u -> %u", stream,
+			stream->client ? stream->client->name : "", old_size, size);
+	return 0;
+}
+
+int stream_ensure_buffer(struct stream *stream, uint32_t size)
+{
+	if (size <= stream->buffer_size || stream->buffer == NULL ||
+	    stream->type == STREAM_TYPE_UPLOAD)
+		return 0;
+
+	size = next_pow2(SPA_MIN(size, buffer_size_max(stream)));
+	if (size <= stream->buffer_size)
+		return 0;
+
+	return stream_resize_buffer(stream, size);
+}
+
+void stream_trim_buffer(struct stream *stream)
+{
+	int32_t filled;
+
+	if (stream->buffer_size <= stream->min_buffer_size)
+		return;
+
+	filled = stream->ring.writeindex - stream->ring.readindex;
+	if (filled > (int32_t)(stream->min_buffer_size / 2))
+		return;
+
+	stream_resize_buffer(stream, stream->min_buffer_size);
 }
 
 static bool stream_prebuf_active(struct stream *stream, int32_t avail)
@@ -250,6 +511,8 @@ void stream_set_corked(struct stream *stream, bool cork)
 			&SPA_DICT_ITEMS(
 				SPA_DICT_ITEM("pulse.corked", cork ? "true" : "false")));
 	stream_set_paused(stream, cork, "cork request");
+	if (cork)
+		stream_trim_buffer(stream);
 }
 
 int stream_send_underflow(struct stream *stream, int64_t offset)
@@ -16,6 +16,7 @@
 #include "volume.h"
 
 struct impl;
+struct iovec;
 struct client;
 struct spa_io_rate_match;
 
@@ -55,6 +56,8 @@ struct stream {
 	struct spa_io_position *position;
 	struct spa_ringbuffer ring;
 	void *buffer;
+	uint32_t buffer_size;		/* power of 2, grows up to the maxlength */
+	uint32_t min_buffer_size;	/* size we shrink back to when idle */
 
 	int64_t read_index;
 	int64_t write_index;
@@ -94,6 +97,7 @@ struct stream {
 	unsigned int early_requests:1;
 	unsigned int adjust_latency:1;
 	unsigned int is_underrun:1;
+	unsigned int is_overrun:1;
 	unsigned int in_prebuf:1;
 	unsigned int killed:1;
 	unsigned int pending:1;
@@ -109,8 +113,18 @@ struct stream *stream_new(struct client *client, enum stream_type type, uint32_t
 void stream_created(struct stream *stream);
 void stream_free(struct stream *stream);
 void stream_flush(struct stream *stream);
+
+int stream_alloc_buffer(struct stream *stream, uint32_t size);
+int stream_ensure_buffer(struct stream *stream, uint32_t size);
+void stream_trim_buffer(struct stream *stream);
+void *stream_take_buffer(struct stream *stream);
 uint32_t stream_pop_missing(struct stream *stream);
 
+int stream_queue_record_data(struct stream *stream, uint32_t index, uint32_t length);
+uint32_t stream_get_record_iov(struct stream *stream, uint32_t index, uint32_t length,
+		struct iovec iov[2]);
+void stream_detach_record_data(struct stream *stream);
+
 void stream_set_corked(struct stream *stream, bool corked);
 void stream_set_paused(struct stream *stream, bool paused, const char *reason);
 
@@ -27,6 +27,7 @@
 #include <pipewire/log.h>
 #include <pipewire/keys.h>
 
+#include "defs.h"
 #include "log.h"
 #include "utils.h"
 
@@ -146,6 +147,72 @@ pid_t get_client_pid(struct client *client, int client_fd)
 	return 0;
 }
 
+bool is_same_user(struct client *client, int client_fd)
+{
+	socklen_t len;
+#if defined(__linux__)
+	struct ucred ucred;
+	len = sizeof(ucred);
+	if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &ucred, &len) < 0) {
+		pw_log_warn("client %p: no peercred: %m", client);
+		return false;
+	}
+	return ucred.uid == getuid();
+#elif defined(__FreeBSD__) || defined(__MidnightBSD__)
+	struct xucred xucred;
+	len = sizeof(xucred);
+	if (getsockopt(client_fd, 0, LOCAL_PEERCRED, &xucred, &len) < 0) {
+		pw_log_warn("client %p: no peercred: %m", client);
+		return false;
+	}
+	return xucred.cr_uid == getuid();
+#else
+	return false;
+#endif
+}
+
+ssize_t recv_fds(int fd, void *data, size_t size, int *fds, uint32_t *n_fds, uint32_t max_fds)
+{
+	union {
+		struct cmsghdr hdr;
+		uint8_t buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+	} cmsgbuf;
+	struct iovec iov = {
+		.iov_base = data,
+		.iov_len = size,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = &cmsgbuf,
+		.msg_controllen = sizeof(cmsgbuf),
+	};
+	struct cmsghdr *cmsg;
+	ssize_t r;
+
+	r = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (r < 0)
+		return r;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		uint32_t i, n;
+		int *cfds;
+
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		cfds = (int *) CMSG_DATA(cmsg);
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; i++) {
+			if (*n_fds < max_fds)
+				fds[(*n_fds)++] = cfds[i];
+			else
+				close(cfds[i]);
+		}
+	}
+	return r;
+}
+
 const char *get_server_name(struct pw_context *context)
 {
 	const char *name = NULL, *sep;
@@ -5,7 +5,9 @@
 #ifndef PULSE_SERVER_UTILS_H
 #define PULSE_SERVER_UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 struct client;
@@ -14,6 +16,8 @@ struct pw_context;
 int get_runtime_dir(char *buf, size_t buflen);
 int check_flatpak(struct client *client, pid_t pid);
 pid_t get_client_pid(struct client *client, int client_fd);
+bool is_same_user(struct client *client, int client_fd);
+ssize_t recv_fds(int fd, void *data, size_t size, int *fds, uint32_t *n_fds, uint32_t max_fds);
 const char *get_server_name(struct pw_context *context);
 int create_pid_file(void);
 int notify_startup(void);
@@ -25,8 +25,23 @@ struct port {
 	uint32_t port_id;
 };
 
+static struct pw_memblock *cache_take(struct pw_context *context, uint32_t flags, size_t size)
+{
+	struct pw_memblock **m, *mem;
+
+	pw_array_for_each(m, &context->buffer_cache) {
+		mem = *m;
+		if (mem->flags == flags && mem->size == size) {
+			pw_array_remove(&context->buffer_cache, m);
+			pw_log_debug("%p: reuse cached mem:%p size:%u", context, mem, mem->size);
+			return mem;
+		}
+	}
+	return NULL;
+}
+
 /* Allocate an array of buffers that can be shared */
-static int alloc_buffers(struct pw_mempool *pool,
+static int alloc_buffers(struct pw_context *context,
 			 uint32_t n_buffers,
 			 uint32_t n_metas,
 			 struct spa_meta *metas,
@@ -80,12 +95,22 @@ static int alloc_buffers(struct pw_mempool *pool,
 
 	if (SPA_FLAG_IS_SET(flags, PW_BUFFERS_FLAG_SHARED)) {
 		/* For shared data we use MemFd for meta/chunk/data */
-		m = pw_mempool_alloc(pool,
-				PW_MEMBLOCK_FLAG_READWRITE |
+		uint32_t mflags = PW_MEMBLOCK_FLAG_READWRITE |
 				PW_MEMBLOCK_FLAG_SEAL |
-				PW_MEMBLOCK_FLAG_MAP,
-				SPA_DATA_MemFd,
-				n_buffers * info.mem_size);
+				PW_MEMBLOCK_FLAG_MAP;
+
+		if (context->settings.mem_slab)
+			mflags |= PW_MEMBLOCK_FLAG_SLAB;
+		if (context->settings.mem_allow_mlock)
+			mflags |= PW_MEMBLOCK_FLAG_RT;
+
+		if ((m = cache_take(context, mflags, n_buffers * info.mem_size)) != NULL) {
+			/* don't leak the data of the previous user */
+			memset(m->map->ptr, 0, m->size);
+		} else {
+			m = pw_mempool_alloc(context->pool, mflags, SPA_DATA_MemFd,
+					n_buffers * info.mem_size);
+		}
 		if (m == NULL) {
 			free(buffers);
 			return -errno;
@@ -109,7 +134,7 @@ static int alloc_buffers(struct pw_mempool *pool,
 			for (j = 0; j < buf->n_datas; j++) {
 				struct spa_data *d = &buf->datas[j];
 				d->fd = m->fd;
-				d->mapoffset = SPA_PTRDIFF(d->data, data);
+				d->mapoffset = SPA_PTRDIFF(d->data, data) + m->map->offset;
 				SPA_FLAG_SET(d->flags, SPA_DATA_FLAG_MAPPABLE);
 			}
 		}
@@ -370,7 +395,7 @@ int pw_buffers_negotiate(struct pw_context *context, uint32_t flags,
 		data_types[i] = types;
 	}
 
-	if ((res = alloc_buffers(context->pool,
+	if ((res = alloc_buffers(context,
 				 max_buffers,
 				 n_metas,
 				 metas,
@@ -394,3 +419,34 @@ void pw_buffers_clear(struct pw_buffers *buffers)
 	free(buffers->buffers);
 	spa_zero(*buffers);
 }
+
+void pw_buffers_release(struct pw_context *context, struct pw_buffers *buffers)
+{
+	struct pw_memblock *mem = buffers->mem, **m;
+	uint32_t max = context->settings.link_buffer_cache;
+
+	/* only cache memory that nobody else holds on to */
+	if (max > 0 && mem != NULL && mem->map != NULL && mem->ref == 1) {
+		if (pw_array_get_len(&context->buffer_cache, struct pw_memblock*) >= max) {
+			/* evict the oldest */
+			m = pw_array_first(&context->buffer_cache);
+			pw_memblock_unref(*m);
+			pw_array_remove(&context->buffer_cache, m);
+		}
+		if (pw_array_add_ptr(&context->buffer_cache, mem) == 0) {
+			pw_log_debug("%p: cache mem:%p size:%u", context, mem, mem->size);
+			buffers->mem = NULL;
+		}
+	}
+	pw_buffers_clear(buffers);
+}
+
+void pw_buffers_cache_clear(struct pw_context *context)
+{
+	struct pw_memblock **m;
+
+	pw_array_consume(m, &context->buffer_cache) {
+		pw_memblock_unref(*m);
+		pw_array_remove(&context->buffer_cache, m);
+	}
+}
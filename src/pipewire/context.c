@@ -383,6 +383,23 @@ static int adjust_rlimits(const struct spa_dict *dict)
 	return 0;
 }
 
+struct pw_mempool *pw_context_new_mempool(struct pw_context *context)
+{
+	static const char * const keys[] = {
+		"mem.map-cache-size",
+		"mem.lock-budget",
+		NULL
+	};
+	struct pw_properties *props;
+
+	props = pw_properties_new(NULL, NULL);
+	if (props == NULL)
+		return NULL;
+	pw_properties_update_keys(props, &context->properties->dict, keys);
+
+	return pw_mempool_new(props);
+}
+
 /** Create a new context object
  *
  * \param main_loop the main loop to use
@@ -420,6 +437,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 
 	pw_array_init(&this->factory_lib, 32);
 	pw_array_init(&this->objects, 32);
+	pw_array_init(&this->buffer_cache, 16 * sizeof(void*));
 	pw_map_init(&this->globals, 128, 32);
 
 	spa_list_init(&this->core_impl_list);
@@ -511,7 +529,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	if ((res = setup_data_loops(impl)) < 0)
 		goto error_free;
 
-	this->pool = pw_mempool_new(NULL);
+	this->pool = pw_context_new_mempool(this);
 	if (this->pool == NULL) {
 		res = -errno;
 		goto error_free;
@@ -661,6 +679,9 @@ void pw_context_destroy(struct pw_context *context)
 
 	}
 
+	pw_buffers_cache_clear(context);
+	pw_array_clear(&context->buffer_cache);
+
 	if (context->pool)
 		pw_mempool_destroy(context->pool);
 
@@ -473,7 +473,7 @@ struct pw_impl_client *pw_context_create_client(struct pw_impl_core *core,
 	p->id = PW_ID_ANY;
 	p->permissions = 0;
 
-	this->pool = pw_mempool_new(NULL);
+	this->pool = pw_context_new_mempool(this->context);
 	if (this->pool == NULL) {
 		res = -errno;
 		goto error_clear_array;
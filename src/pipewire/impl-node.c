@@ -1677,7 +1677,8 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	this->activation = pw_mempool_alloc(this->context->pool,
 			PW_MEMBLOCK_FLAG_READWRITE |
 			PW_MEMBLOCK_FLAG_SEAL |
-			PW_MEMBLOCK_FLAG_MAP,
+			PW_MEMBLOCK_FLAG_MAP |
+			(this->context->settings.mem_allow_mlock ? PW_MEMBLOCK_FLAG_RT : 0),
 			SPA_DATA_MemFd, size);
 	if (this->activation == NULL) {
 		res = -errno;
@@ -2084,7 +2084,7 @@ int pw_impl_port_set_param(struct pw_impl_port *port, uint32_t id, uint32_t flag
 			spa_list_for_each(l, &port->links, output_link)
 				pw_impl_port_use_buffers(l->input, &l->rt.in_mix, 0, NULL, 0);
 		}
-		pw_buffers_clear(&port->buffers);
+		pw_buffers_release(port->node->context, &port->buffers);
 		pw_buffers_clear(&port->mix_buffers);
 
 		if (param == NULL || res < 0) {
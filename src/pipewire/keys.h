@@ -338,6 +338,8 @@ extern "C" {
 #define PW_KEY_STREAM_DONT_REMIX	"stream.dont-remix"	/**< don't remix channels */
 #define PW_KEY_STREAM_CAPTURE_SINK	"stream.capture.sink"	/**< Try to capture the sink output instead of
 								  *  source output */
+#define PW_KEY_STREAM_RING_SIZE		"stream.ring-size"	/**< size in bytes of the ring of a
+								  *  PW_STREAM_FLAG_RING stream. Since 1.7.0 */
 
 /** Media */
 #define PW_KEY_MEDIA_TYPE		"media.type"		/**< Media type, one of
@@ -14,7 +14,9 @@
 #include <stdlib.h>
 #include <sys/syscall.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 
+#include <spa/utils/atomic.h>
 #include <spa/utils/list.h>
 #include <spa/buffer/buffer.h>
 
@@ -108,6 +110,27 @@ static int pw_memfd_create(const char *name, unsigned int flags)
 #define memblock_emit(b,m,v,...) spa_hook_list_call(&b->listener_list, struct memblock_events, m, v, ##__VA_ARGS__)
 #define memblock_emit_invalidated(b)	memblock_emit(b, invalidated, 0)
 
+/* slab size classes go from 4K to 1M in powers of 2 */
+#define SLAB_MIN_SHIFT		12u
+#define SLAB_MAX_SHIFT		20u
+#define SLAB_MAX_SIZE		(1u << SLAB_MAX_SHIFT)
+#define SLAB_CLASSES		(SLAB_MAX_SHIFT - SLAB_MIN_SHIFT + 1)
+#define SLAB_ARENA_SIZE		(4u << 20)
+#define SLAB_MAX_SLOTS		(SLAB_ARENA_SIZE >> SLAB_MIN_SHIFT)
+
+#define DEFAULT_MAP_CACHE_SIZE	(8u * 1024 * 1024)
+
+/* a memfd that is divided in slots of one size class */
+struct arena {
+	struct spa_list link;		/* link in mempool arenas */
+	uint32_t class;
+	int fd;
+	void *ptr;
+	uint32_t n_slots;
+	uint32_t n_used;
+	uint64_t used[SLAB_MAX_SLOTS / 64];
+};
+
 struct mempool {
 	struct pw_mempool this;
 
@@ -116,8 +139,29 @@ struct mempool {
 	struct pw_map map;		/* map memblock to id */
 	struct spa_list blocks;		/* list of memblock */
 	uint32_t pagesize;
+
+	struct spa_list arenas[SLAB_CLASSES];
+	uint32_t n_arenas;
+	uint32_t n_slots;
+	uint64_t slot_size;
+	uint64_t requested_size;
+
+	struct spa_list map_cache;	/* unused mappings, least recently used first */
+	uint64_t map_cache_size;
+	uint64_t map_cache_max;
+	uint64_t map_hits;
+	uint64_t map_misses;
+	uint64_t map_evictions;
+
+	uint64_t lock_budget;
+	uint64_t locked_size;
+	uint64_t lock_failures;
+	unsigned int lock_warned:1;
 };
 
+/* memory locked for RT mappings by all pools of the process */
+static uint64_t locked_total;
+
 struct memblock {
 	struct pw_memblock this;
 	struct spa_list link;		/* link in mempool */
@@ -126,6 +170,8 @@ struct memblock {
 	struct memblock *owner;		/* owner of fd, if another memblock */
 	struct spa_hook owner_listener;	/* listen for fd owner memblock events */
 	struct spa_hook_list listener_list;
+	struct arena *arena;		/* arena when the block is a slot */
+	uint32_t slot;
 };
 
 struct memblock_events {
@@ -138,10 +184,14 @@ struct memblock_events {
 struct mapping {
 	struct memblock *block;
 	int ref;
+	uint32_t flags;
 	uint32_t offset;
 	uint32_t size;
 	unsigned int do_unmap:1;
+	unsigned int cached:1;
+	unsigned int locked:1;
 	struct spa_list link;
+	struct spa_list cache_link;	/* link in mempool map_cache when unused */
 	void *ptr;
 };
 
@@ -152,11 +202,23 @@ struct memmap {
 	struct spa_list link;
 };
 
+static void arena_free(struct mempool *impl, struct arena *a);
+
+static uint64_t default_lock_budget(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_MEMLOCK, &rl) < 0 || rl.rlim_cur == RLIM_INFINITY)
+		return UINT64_MAX;
+	return rl.rlim_cur;
+}
+
 SPA_EXPORT
 struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 {
 	struct mempool *impl;
 	struct pw_mempool *this;
+	uint32_t i;
 
 	impl = calloc(1, sizeof(struct mempool));
 	if (impl == NULL)
@@ -166,12 +228,25 @@ struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 	this->props = props;
 
 	impl->pagesize = sysconf(_SC_PAGESIZE);
-
-	pw_log_debug("%p: new pagesize:%" PRIu32 "", this, impl->pagesize);
+	impl->map_cache_max = DEFAULT_MAP_CACHE_SIZE;
+	if (props)
+		impl->map_cache_max = pw_properties_get_uint64(props,
+				"mem.map-cache-size", impl->map_cache_max);
+	impl->lock_budget = default_lock_budget();
+	if (props)
+		impl->lock_budget = pw_properties_get_uint64(props,
+				"mem.lock-budget", impl->lock_budget);
+
+	pw_log_debug("%p: new pagesize:%" PRIu32 " map-cache-size:%" PRIu64
+			" lock-budget:%" PRIu64, this, impl->pagesize,
+			impl->map_cache_max, impl->lock_budget);
 
 	spa_hook_list_init(&impl->listener_list);
 	pw_map_init(&impl->map, 64, 64);
 	spa_list_init(&impl->blocks);
+	spa_list_init(&impl->map_cache);
+	for (i = 0; i < SLAB_CLASSES; i++)
+		spa_list_init(&impl->arenas[i]);
 
 	return this;
 }
@@ -181,12 +256,18 @@ void pw_mempool_clear(struct pw_mempool *pool)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
 	struct memblock *b;
+	struct arena *a;
+	uint32_t i;
 
 	pw_log_debug("%p: clear", pool);
 
 	spa_list_consume(b, &impl->blocks, link)
 		pw_memblock_free(&b->this);
 	pw_map_reset(&impl->map);
+
+	for (i = 0; i < SLAB_CLASSES; i++)
+		spa_list_consume(a, &impl->arenas[i], link)
+			arena_free(impl, a);
 }
 
 SPA_EXPORT
@@ -277,6 +358,67 @@ int pw_memblock_map_old(struct pw_memblock *mem)
 }
 #endif
 
+static inline bool mapping_compatible(struct mapping *m, uint32_t flags)
+{
+	return ((flags & PW_MEMMAP_FLAG_READWRITE) & ~m->flags) == 0 &&
+		(flags & PW_MEMMAP_FLAG_PRIVATE) == (m->flags & PW_MEMMAP_FLAG_PRIVATE);
+}
+
+static void mapping_uncache(struct mapping *m)
+{
+	struct mempool *p = SPA_CONTAINER_OF(m->block->this.pool, struct mempool, this);
+
+	spa_list_remove(&m->cache_link);
+	p->map_cache_size -= m->size;
+	m->cached = false;
+}
+
+/* lock the pages of a mapping used from a realtime thread, this also faults
+ * them in. Failure is not fatal, the mapping is then only prefaulted. */
+static void mapping_lock(struct mapping *m)
+{
+	struct mempool *p = SPA_CONTAINER_OF(m->block->this.pool, struct mempool, this);
+	uint64_t total;
+	int res;
+
+	if (m->locked)
+		return;
+
+	total = __atomic_add_fetch(&locked_total, m->size, __ATOMIC_SEQ_CST);
+	if (total > p->lock_budget)
+		res = -ENOSPC;
+	else if (mlock(m->ptr, m->size) < 0)
+		res = -errno;
+	else
+		res = 0;
+
+	if (res < 0) {
+		__atomic_sub_fetch(&locked_total, m->size, __ATOMIC_SEQ_CST);
+		p->lock_failures++;
+		pw_log(p->lock_warned ? SPA_LOG_LEVEL_DEBUG : SPA_LOG_LEVEL_INFO,
+				"%p: can't lock mapping:%p size:%u locked:%" PRIu64
+				" budget:%" PRIu64 ": %s", p, m, m->size,
+				total - m->size, p->lock_budget, strerror(-res));
+		p->lock_warned = true;
+#ifdef MADV_WILLNEED
+		madvise(m->ptr, m->size, MADV_WILLNEED);
+#endif
+		return;
+	}
+	p->locked_size += m->size;
+	m->locked = true;
+}
+
+static void mapping_unlock(struct mapping *m)
+{
+	struct mempool *p = SPA_CONTAINER_OF(m->block->this.pool, struct mempool, this);
+
+	munlock(m->ptr, m->size);
+	__atomic_sub_fetch(&locked_total, m->size, __ATOMIC_SEQ_CST);
+	p->locked_size -= m->size;
+	m->locked = false;
+}
+
 static struct mapping * memblock_find_mapping(struct memblock *b,
 		uint32_t flags, uint32_t offset, uint32_t size)
 {
@@ -287,10 +429,20 @@ static struct mapping * memblock_find_mapping(struct memblock *b,
 		pw_log_debug("%p: check %p offset:(%u <= %u) end:(%u >= %u)",
 				pool, m, m->offset, offset, m->offset + m->size,
 				offset + size);
-		if (m->offset <= offset && (m->offset + m->size) >= (offset + size)) {
-			pw_log_debug("%p: found %p id:%u fd:%d offs:%u size:%u ref:%d",
+		if (m->offset <= offset && (m->offset + m->size) >= (offset + size) &&
+		    mapping_compatible(m, flags)) {
+			pw_log_debug("%p: found %p id:%u fd:%d offs:%u size:%u ref:%d cached:%u",
 					pool, &b->this, b->this.id, b->this.fd,
-					offset, size, b->this.ref);
+					offset, size, b->this.ref, m->cached);
+			if (m->cached) {
+				/* revive an unused mapping, it takes a block ref again */
+				mapping_uncache(m);
+				b->this.ref++;
+#ifdef MADV_WILLNEED
+				if (flags & (PW_MEMMAP_FLAG_POPULATE | PW_MEMMAP_FLAG_RT))
+					madvise(m->ptr, m->size, MADV_WILLNEED);
+#endif
+			}
 			return m;
 		}
 	}
@@ -317,6 +469,10 @@ static struct mapping * memblock_map(struct memblock *b,
 
 	if (flags & PW_MEMMAP_FLAG_LOCKED)
 		fl |= MAP_LOCKED;
+#ifdef MAP_POPULATE
+	if (flags & (PW_MEMMAP_FLAG_POPULATE | PW_MEMMAP_FLAG_RT))
+		fl |= MAP_POPULATE;
+#endif
 
 	if (flags & PW_MEMMAP_FLAG_TWICE) {
 		pw_log_error("%p: implement me PW_MEMMAP_FLAG_TWICE", p);
@@ -350,10 +506,12 @@ static struct mapping * memblock_map(struct memblock *b,
 	m->ptr = ptr;
 	m->do_unmap = true;
 	m->block = b;
+	m->flags = flags;
 	m->offset = offset;
 	m->size = size;
 	b->this.ref++;
 	spa_list_append(&b->mappings, &m->link);
+	p->map_misses++;
 
         pw_log_debug("%p: block:%p fd:%d flags:%08x map:%p ptr:%p (%u %u) block-ref:%d", p, &b->this,
 			b->this.fd, b->this.flags, m, m->ptr, offset, size, b->this.ref);
@@ -369,22 +527,76 @@ static void mapping_free(struct mapping *m)
         pw_log_debug("%p: mapping:%p block:%p fd:%d ptr:%p size:%u block-ref:%d",
 			p, m, b, b->this.fd, m->ptr, m->size, b->this.ref);
 
+	if (m->cached)
+		mapping_uncache(m);
+	if (m->locked)
+		mapping_unlock(m);
 	if (m->do_unmap)
 		munmap(m->ptr, m->size);
 	spa_list_remove(&m->link);
 	free(m);
 }
 
+static void map_cache_trim(struct mempool *p, uint64_t max)
+{
+	struct mapping *m;
+
+	while (p->map_cache_size > max) {
+		m = spa_list_first(&p->map_cache, struct mapping, cache_link);
+		pw_log_debug("%p: evict mapping:%p size:%u", p, m, m->size);
+		p->map_evictions++;
+		mapping_free(m);
+	}
+}
+
 static void mapping_unmap(struct mapping *m)
 {
 	struct memblock *b = m->block;
 	struct mempool *p = SPA_CONTAINER_OF(b->this.pool, struct mempool, this);
         pw_log_debug("%p: mapping:%p block:%p fd:%d ptr:%p size:%u block-ref:%d",
 			p, m, b, b->this.fd, m->ptr, m->size, b->this.ref);
-	mapping_free(m);
+
+	/* keep unused mappings around for when the block is mapped again. The
+	 * mapping does not keep the block alive, it is dropped with the block. */
+	if (m->do_unmap && !(m->flags & PW_MEMMAP_FLAG_LOCKED) &&
+	    m->size <= p->map_cache_max && b->this.fd != -1) {
+		/* the lock is taken again when the mapping is revived for RT use */
+		if (m->locked)
+			mapping_unlock(m);
+		spa_list_append(&p->map_cache, &m->cache_link);
+		p->map_cache_size += m->size;
+		m->cached = true;
+		map_cache_trim(p, p->map_cache_max);
+	} else {
+		mapping_free(m);
+	}
 	pw_memblock_unref(&b->this);
 }
 
+/* extend the page aligned range [*start, *end) over the unused mappings of
+ * the block that touch it so that they can be replaced by one mapping */
+static void memblock_coalesce_range(struct memblock *b, uint32_t flags,
+		uint32_t *start, uint32_t *end)
+{
+	struct mapping *m;
+	bool changed;
+
+	do {
+		changed = false;
+		spa_list_for_each(m, &b->mappings, link) {
+			if (!m->cached || !mapping_compatible(m, flags))
+				continue;
+			if (m->offset > *end || m->offset + m->size < *start)
+				continue;
+			if (m->offset < *start || m->offset + m->size > *end) {
+				*start = SPA_MIN(*start, m->offset);
+				*end = SPA_MAX(*end, m->offset + m->size);
+				changed = true;
+			}
+		}
+	} while (changed);
+}
+
 SPA_EXPORT
 struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 		enum pw_memmap_flags flags, uint32_t offset, uint32_t size, uint32_t tag[5])
@@ -420,16 +632,34 @@ struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 	m = memblock_find_mapping(b, flags, offset, size);
 	if (m == NULL) {
 		struct pw_map_range range;
+		struct mapping *c, *t;
+		uint32_t start, end;
+
 		if (pw_map_range_init(&range, offset, size, p->pagesize) < 0) {
 			errno = EOVERFLOW;
 			return NULL;
 		}
+		start = range.offset;
+		end = range.offset + range.size;
+		memblock_coalesce_range(b, flags, &start, &end);
 
-		m = memblock_map(b, flags, range.offset, range.size);
+		m = memblock_map(b, flags, start, end - start);
 		if (m == NULL)
 			return NULL;
+
+		/* the unused mappings that were merged are not needed anymore */
+		spa_list_for_each_safe(c, t, &b->mappings, link) {
+			if (c->cached && c->offset >= start &&
+			    c->offset + c->size <= end)
+				mapping_free(c);
+		}
+	} else {
+		p->map_hits++;
 	}
 
+	if (flags & PW_MEMMAP_FLAG_RT)
+		mapping_lock(m);
+
 	mm = calloc(1, sizeof(struct memmap));
 	if (mm == NULL) {
 		if (m->ref == 0)
@@ -511,10 +741,212 @@ static inline enum pw_memmap_flags block_flags_to_mem(enum pw_memblock_flags fla
 		fl |= PW_MEMMAP_FLAG_READ;
 	if (flags & PW_MEMBLOCK_FLAG_WRITABLE)
 		fl |= PW_MEMMAP_FLAG_WRITE;
+	if (flags & PW_MEMBLOCK_FLAG_RT)
+		fl |= PW_MEMMAP_FLAG_RT;
 
 	return fl;
 }
 
+static int create_fd(struct pw_mempool *pool, enum pw_memblock_flags flags,
+		uint32_t type, size_t size)
+{
+	int fd, res;
+
+#ifdef HAVE_MEMFD_CREATE
+	char name[128];
+	snprintf(name, sizeof(name),
+		 "pipewire-memfd:flags=0x%08x,type=%" PRIu32 ",size=%zu",
+		 (unsigned int) flags, type, size);
+
+	fd = pw_memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_NOEXEC_SEAL);
+	if (fd == -1) {
+		res = -errno;
+		pw_log_error("%p: Failed to create memfd: %m", pool);
+		return res;
+	}
+#elif defined(__FreeBSD__) || defined(__MidnightBSD__)
+	fd = shm_open(SHM_ANON, O_CREAT | O_RDWR | O_CLOEXEC, 0);
+	if (fd == -1) {
+		res = -errno;
+		pw_log_error("%p: Failed to create SHM_ANON fd: %m", pool);
+		return res;
+	}
+#else
+	char filename[128];
+	snprintf(filename, sizeof(filename),
+		 "/dev/shm/pipewire-tmpfile:flags=0x%08x,type=%" PRIu32 ",size=%zu:XXXXXX",
+		 (unsigned int) flags, type, size);
+
+	fd = mkostemp(filename, O_CLOEXEC);
+	if (fd == -1) {
+		res = -errno;
+		pw_log_error("%p: Failed to create temporary file: %m", pool);
+		return res;
+	}
+	unlink(filename);
+#endif
+	pw_log_debug("%p: new fd:%d", pool, fd);
+
+	if (ftruncate(fd, size) < 0) {
+		res = -errno;
+		pw_log_warn("%p: Failed to truncate temporary file: %m", pool);
+		pw_log_debug("%p: close fd:%d", pool, fd);
+		close(fd);
+		return res;
+	}
+#ifdef HAVE_MEMFD_CREATE
+	if (flags & PW_MEMBLOCK_FLAG_SEAL) {
+		unsigned int seals = F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL;
+		if (fcntl(fd, F_ADD_SEALS, seals) == -1) {
+			pw_log_warn("%p: Failed to add seals: %m", pool);
+		}
+	}
+#endif
+	return fd;
+}
+
+static inline uint32_t slab_class(size_t size)
+{
+	uint32_t shift = SLAB_MIN_SHIFT;
+	while (((size_t)1 << shift) < size)
+		shift++;
+	return shift - SLAB_MIN_SHIFT;
+}
+
+static struct arena *arena_new(struct mempool *impl, uint32_t class)
+{
+	struct arena *a;
+	int res;
+
+	a = calloc(1, sizeof(struct arena));
+	if (a == NULL)
+		return NULL;
+
+	a->class = class;
+	a->n_slots = SLAB_ARENA_SIZE >> (class + SLAB_MIN_SHIFT);
+
+	/* always seal, the fd is shared with everybody using a slot */
+	a->fd = create_fd(&impl->this, PW_MEMBLOCK_FLAG_READWRITE | PW_MEMBLOCK_FLAG_SEAL,
+			SPA_DATA_MemFd, SLAB_ARENA_SIZE);
+	if (a->fd < 0) {
+		res = a->fd;
+		goto error_free;
+	}
+	a->ptr = mmap(NULL, SLAB_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, a->fd, 0);
+	if (a->ptr == MAP_FAILED) {
+		res = -errno;
+		pw_log_error("%p: Failed to mmap arena fd:%d: %m", impl, a->fd);
+		goto error_close;
+	}
+#ifdef MADV_HUGEPAGE
+	/* lower the TLB pressure when shmem huge pages are enabled */
+	madvise(a->ptr, SLAB_ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+	spa_list_append(&impl->arenas[class], &a->link);
+	impl->n_arenas++;
+
+	pw_log_debug("%p: arena:%p fd:%d class:%u slots:%u", impl, a, a->fd,
+			class, a->n_slots);
+	return a;
+
+error_close:
+	close(a->fd);
+error_free:
+	free(a);
+	errno = -res;
+	return NULL;
+}
+
+static void arena_free(struct mempool *impl, struct arena *a)
+{
+	pw_log_debug("%p: arena:%p fd:%d class:%u", impl, a, a->fd, a->class);
+	spa_list_remove(&a->link);
+	impl->n_arenas--;
+	munmap(a->ptr, SLAB_ARENA_SIZE);
+	close(a->fd);
+	free(a);
+}
+
+static int slab_alloc(struct mempool *impl, struct memblock *b, uint32_t flags, size_t size)
+{
+	uint32_t class = slab_class(size), i, slot, slot_size;
+	struct arena *a, *found = NULL;
+	struct mapping *m;
+
+	spa_list_for_each(a, &impl->arenas[class], link) {
+		if (a->n_used < a->n_slots) {
+			found = a;
+			break;
+		}
+	}
+	if (found == NULL && (found = arena_new(impl, class)) == NULL)
+		return -errno;
+	a = found;
+
+	for (i = 0; a->used[i] == UINT64_MAX; i++);
+	slot = i * 64 + __builtin_ctzll(~a->used[i]);
+	slot_size = 1u << (class + SLAB_MIN_SHIFT);
+
+	m = calloc(1, sizeof(struct mapping));
+	if (m == NULL)
+		return -errno;
+
+	a->used[i] |= 1ull << (slot & 63);
+	a->n_used++;
+	impl->n_slots++;
+	impl->slot_size += slot_size;
+	impl->requested_size += size;
+
+	/* the view shares the arena fd and mapping */
+	b->arena = a;
+	b->slot = slot;
+	b->this.fd = a->fd;
+
+	m->block = b;
+	m->flags = PW_MEMMAP_FLAG_READWRITE;
+	m->offset = slot * slot_size;
+	m->size = slot_size;
+	m->ptr = SPA_PTROFF(a->ptr, m->offset, void);
+	/* slots are reused, clear them like a new memfd */
+	memset(m->ptr, 0, slot_size);
+	b->this.ref++;
+	spa_list_append(&b->mappings, &m->link);
+
+	b->this.map = pw_memblock_map(&b->this, block_flags_to_mem(flags),
+			m->offset, size, NULL);
+	if (b->this.map == NULL)
+		return -errno;
+	b->this.ref--;
+
+	pw_log_debug("%p: block:%p arena:%p fd:%d slot:%u offset:%u", impl, b, a,
+			a->fd, slot, m->offset);
+	return 0;
+}
+
+static void slab_free(struct mempool *impl, struct memblock *b)
+{
+	struct arena *a = b->arena, *o;
+	uint32_t slot_size = 1u << (a->class + SLAB_MIN_SHIFT);
+
+	a->used[b->slot / 64] &= ~(1ull << (b->slot & 63));
+	a->n_used--;
+	impl->n_slots--;
+	impl->slot_size -= slot_size;
+	impl->requested_size -= b->this.size;
+	b->arena = NULL;
+
+	if (a->n_used > 0)
+		return;
+
+	/* keep one empty arena per class around for the next allocation */
+	spa_list_for_each(o, &impl->arenas[a->class], link) {
+		if (o != a && o->n_used == 0) {
+			arena_free(impl, a);
+			break;
+		}
+	}
+}
+
 /** Create a new memblock
  * \param pool the pool to use
  * \param flags memblock flags
@@ -528,6 +960,7 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
 	struct memblock *b;
+	struct mapping *m;
 	int res;
 
 	b = calloc(1, sizeof(struct memblock));
@@ -549,54 +982,22 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 	spa_list_init(&b->memmaps);
 	spa_hook_list_init(&b->listener_list);
 
-#ifdef HAVE_MEMFD_CREATE
-	char name[128];
-	snprintf(name, sizeof(name),
-		 "pipewire-memfd:flags=0x%08x,type=%" PRIu32 ",size=%zu",
-		 (unsigned int) flags, type, size);
-
-	b->this.fd = pw_memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_NOEXEC_SEAL);
-	if (b->this.fd == -1) {
-		res = -errno;
-		pw_log_error("%p: Failed to create memfd: %m", pool);
-		goto error_free;
-	}
-#elif defined(__FreeBSD__) || defined(__MidnightBSD__)
-	b->this.fd = shm_open(SHM_ANON, O_CREAT | O_RDWR | O_CLOEXEC, 0);
-	if (b->this.fd == -1) {
-		res = -errno;
-		pw_log_error("%p: Failed to create SHM_ANON fd: %m", pool);
-		goto error_free;
+	/* slots are only handed out premapped, so that they can use the
+	 * mapping of the arena */
+	if ((flags & PW_MEMBLOCK_FLAG_SLAB) && (flags & PW_MEMBLOCK_FLAG_MAP) &&
+	    size > 0 && size <= SLAB_MAX_SIZE) {
+		if ((res = slab_alloc(impl, b, flags, size)) < 0) {
+			pw_log_warn("%p: slab alloc failure: %s", pool, strerror(-res));
+			goto error_slab;
+		}
+		goto done;
 	}
-#else
-	char filename[128];
-	snprintf(filename, sizeof(filename),
-		 "/dev/shm/pipewire-tmpfile:flags=0x%08x,type=%" PRIu32 ",size=%zu:XXXXXX",
-		 (unsigned int) flags, type, size);
 
-	b->this.fd = mkostemp(filename, O_CLOEXEC);
-	if (b->this.fd == -1) {
-		res = -errno;
-		pw_log_error("%p: Failed to create temporary file: %m", pool);
+	if ((b->this.fd = create_fd(pool, flags, type, size)) < 0) {
+		res = b->this.fd;
 		goto error_free;
 	}
-	unlink(filename);
-#endif
-	pw_log_debug("%p: new fd:%d", pool, b->this.fd);
 
-	if (ftruncate(b->this.fd, size) < 0) {
-		res = -errno;
-		pw_log_warn("%p: Failed to truncate temporary file: %m", pool);
-		goto error_close;
-	}
-#ifdef HAVE_MEMFD_CREATE
-	if (flags & PW_MEMBLOCK_FLAG_SEAL) {
-		unsigned int seals = F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL;
-		if (fcntl(b->this.fd, F_ADD_SEALS, seals) == -1) {
-			pw_log_warn("%p: Failed to add seals: %m", pool);
-		}
-	}
-#endif
 	if (flags & PW_MEMBLOCK_FLAG_MAP && size > 0) {
 		b->this.map = pw_memblock_map(&b->this,
 				block_flags_to_mem(flags), 0, size, NULL);
@@ -608,6 +1009,7 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 		b->this.ref--;
 	}
 
+done:
 	b->this.id = pw_map_insert_new(&impl->map, b);
 	spa_list_append(&impl->blocks, &b->link);
 	pw_log_debug("%p: block:%p id:%d type:%u flags:%08x size:%zu", pool,
@@ -618,6 +1020,12 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 
 	return &b->this;
 
+error_slab:
+	spa_list_consume(m, &b->mappings, link)
+		mapping_free(m);
+	if (b->arena)
+		slab_free(impl, b);
+	goto error_free;
 error_close:
 	pw_log_debug("%p: close fd:%d", pool, b->this.fd);
 	close(b->this.fd);
@@ -773,6 +1181,7 @@ struct pw_memmap * pw_mempool_import_map(struct pw_mempool *pool,
 		}
 		m->ptr = old->map->ptr;
 		m->block = b;
+		m->flags = old->map->flags;
 		m->offset = old->map->offset;
 		m->size = old->map->size;
 		spa_list_append(&b->mappings, &m->link);
@@ -782,7 +1191,7 @@ struct pw_memmap * pw_mempool_import_map(struct pw_mempool *pool,
 		block->ref--;
 	}
 
-	offset = SPA_PTRDIFF(data, old->map->ptr);
+	offset = SPA_PTRDIFF(data, old->map->ptr) + old->map->offset;
 
 	map = pw_memblock_map(block,
 			block_flags_to_mem(block->flags), offset, size, tag);
@@ -854,11 +1263,14 @@ void pw_memblock_free(struct pw_memblock *block)
 		pw_memmap_free(&mm->this);
 
 	spa_list_consume(m, &b->mappings, link) {
-		pw_log_warn("%p: stray mapping:%p", pool, m);
+		if (!m->cached)
+			pw_log_warn("%p: stray mapping:%p", pool, m);
 		mapping_free(m);
 	}
 
-	if (block->fd != -1 && !(block->flags & PW_MEMBLOCK_FLAG_DONT_CLOSE)) {
+	if (b->arena) {
+		slab_free(impl, b);
+	} else if (block->fd != -1 && !(block->flags & PW_MEMBLOCK_FLAG_DONT_CLOSE)) {
 		pw_log_debug("%p: close fd:%d", pool, block->fd);
 		close(block->fd);
 	}
@@ -933,3 +1345,28 @@ struct pw_memmap * pw_mempool_find_tag(struct pw_mempool *pool, uint32_t tag[5],
 	}
 	return NULL;
 }
+
+SPA_EXPORT
+int pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats)
+{
+	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
+	struct memblock *b;
+
+	spa_zero(*stats);
+	spa_list_for_each(b, &impl->blocks, link)
+		stats->n_blocks++;
+	stats->n_arenas = impl->n_arenas;
+	stats->n_slots = impl->n_slots;
+	stats->arena_size = (uint64_t)impl->n_arenas * SLAB_ARENA_SIZE;
+	stats->slot_size = impl->slot_size;
+	stats->requested_size = impl->requested_size;
+	stats->map_hits = impl->map_hits;
+	stats->map_misses = impl->map_misses;
+	stats->map_evictions = impl->map_evictions;
+	stats->map_cache_size = impl->map_cache_size;
+	stats->locked_size = impl->locked_size;
+	stats->locked_total = SPA_ATOMIC_LOAD(locked_total);
+	stats->lock_budget = impl->lock_budget;
+	stats->lock_failures = impl->lock_failures;
+	return 0;
+}
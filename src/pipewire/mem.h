@@ -36,6 +36,13 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_DONT_CLOSE =	(1 << 4),	/**< don't close fd */
 	PW_MEMBLOCK_FLAG_DONT_NOTIFY =	(1 << 5),	/**< don't notify events */
 	PW_MEMBLOCK_FLAG_UNMAPPABLE =	(1 << 6),	/**< the fd can not be mmapped */
+	PW_MEMBLOCK_FLAG_SLAB =		(1 << 7),	/**< allocate a slot of a larger shared
+							  *  memfd arena when possible. Everybody
+							  *  who receives the fd can access the
+							  *  complete arena. Since 1.7.0 */
+	PW_MEMBLOCK_FLAG_RT =		(1 << 8),	/**< the map of PW_MEMBLOCK_FLAG_MAP is used
+							  *  from a realtime thread, see
+							  *  PW_MEMMAP_FLAG_RT. Since 1.7.0 */
 
 	PW_MEMBLOCK_FLAG_READWRITE = PW_MEMBLOCK_FLAG_READABLE | PW_MEMBLOCK_FLAG_WRITABLE,
 };
@@ -48,6 +55,12 @@ enum pw_memmap_flags {
 							  *  creating a circular ringbuffer */
 	PW_MEMMAP_FLAG_PRIVATE =	(1 << 3),	/**< writes will be private */
 	PW_MEMMAP_FLAG_LOCKED =		(1 << 4),	/**< lock the memory into RAM */
+	PW_MEMMAP_FLAG_POPULATE =	(1 << 5),	/**< prefault the pages of the mapping.
+							  *  Since 1.7.0 */
+	PW_MEMMAP_FLAG_RT =		(1 << 6),	/**< the mapping is used from a realtime
+							  *  thread. Prefault the pages and lock them
+							  *  into RAM when the lock budget of the
+							  *  pool allows it. Since 1.7.0 */
 	PW_MEMMAP_FLAG_READWRITE = PW_MEMMAP_FLAG_READ | PW_MEMMAP_FLAG_WRITE,
 };
 
@@ -83,6 +96,24 @@ struct pw_memmap {
 	uint32_t tag[5];		/**< user tag */
 };
 
+/** Statistics of a memory pool. Since 1.7.0 */
+struct pw_mempool_stats {
+	uint32_t n_blocks;		/**< number of blocks in the pool */
+	uint32_t n_arenas;		/**< number of slab arenas */
+	uint32_t n_slots;		/**< number of allocated slots in the arenas */
+	uint64_t arena_size;		/**< total size of the arenas */
+	uint64_t slot_size;		/**< total size of the allocated slots */
+	uint64_t requested_size;	/**< total size requested for the slots */
+	uint64_t map_hits;		/**< maps that used an existing mapping */
+	uint64_t map_misses;		/**< maps that needed a new mmap */
+	uint64_t map_evictions;		/**< unused mappings that were unmapped */
+	uint64_t map_cache_size;	/**< size of the unused mappings kept around */
+	uint64_t locked_size;		/**< size of the RT mappings locked by the pool */
+	uint64_t locked_total;		/**< size locked by all pools of the process */
+	uint64_t lock_budget;		/**< maximum locked size of the process */
+	uint64_t lock_failures;		/**< RT mappings that could not be locked */
+};
+
 struct pw_mempool_events {
 #define PW_VERSION_MEMPOOL_EVENTS	0
 	uint32_t version;
@@ -97,7 +128,11 @@ struct pw_mempool_events {
 	void (*removed) (void *data, struct pw_memblock *block);
 };
 
-/** Create a new memory pool */
+/** Create a new memory pool. Unused mappings are kept around up to the
+ * size in bytes of the "mem.map-cache-size" property in \a props.
+ * PW_MEMMAP_FLAG_RT mappings are locked as long as the memory locked by all
+ * pools of the process stays below the "mem.lock-budget" property, which
+ * defaults to RLIMIT_MEMLOCK. */
 struct pw_mempool *pw_mempool_new(struct pw_properties *props);
 
 /** Listen for events */
@@ -112,6 +147,12 @@ void pw_mempool_clear(struct pw_mempool *pool);
 /** Clear and destroy a pool */
 void pw_mempool_destroy(struct pw_mempool *pool);
 
+/** Get statistics of the pool. The difference between \a slot_size and
+ * \a requested_size is lost to rounding to a size class, the difference
+ * between \a arena_size and \a slot_size is free for new slots.
+ * Since 1.7.0 */
+int pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats);
+
 
 /** Allocate a memory block from the pool */
 struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool,
@@ -47,8 +47,10 @@ struct settings {
 	struct spa_rectangle video_size;
 	struct spa_fraction video_rate;
 	uint32_t link_max_buffers;
+	uint32_t link_buffer_cache;
 	unsigned int mem_warn_mlock:1;
 	unsigned int mem_allow_mlock:1;
+	unsigned int mem_slab:1;
 	unsigned int clock_power_of_two_quantum:1;
 	unsigned int check_quantum:1;
 	unsigned int check_rate:1;
@@ -412,6 +414,7 @@ struct pw_context {
 	struct pw_array factory_lib;	/**< mapping of factory_name regexp to library */
 
 	struct pw_array objects;	/**< objects */
+	struct pw_array buffer_cache;	/**< released link buffer memory for reuse */
 
 	struct pw_impl_client *current_client;	/**< client currently executing code in mainloop */
 
@@ -1275,6 +1278,15 @@ void pw_proxy_remove(struct pw_proxy *proxy);
 
 int pw_context_recalc_graph(struct pw_context *context, const char *reason);
 
+/** Make a memory pool configured with the mem.* properties of the context */
+struct pw_mempool *pw_context_new_mempool(struct pw_context *context);
+
+/** Clear \a buffers and keep the memory in the context cache so that the
+ * next negotiation of the same layout can reuse it */
+void pw_buffers_release(struct pw_context *context, struct pw_buffers *buffers);
+/** Free all cached buffer memory */
+void pw_buffers_cache_clear(struct pw_context *context);
+
 void pw_impl_port_update_info(struct pw_impl_port *port, const struct spa_port_info *info);
 
 int pw_impl_port_register(struct pw_impl_port *port,
@@ -33,8 +33,10 @@
 #define DEFAULT_VIDEO_RATE_NUM			25u
 #define DEFAULT_VIDEO_RATE_DENOM		1u
 #define DEFAULT_LINK_MAX_BUFFERS		64u
+#define DEFAULT_LINK_BUFFER_CACHE		0u
 #define DEFAULT_MEM_WARN_MLOCK			false
 #define DEFAULT_MEM_ALLOW_MLOCK			true
+#define DEFAULT_MEM_SLAB			false
 #define DEFAULT_CHECK_QUANTUM			false
 #define DEFAULT_CHECK_RATE			false
 
@@ -222,8 +224,10 @@ void pw_settings_init(struct pw_context *this)
 	d->clock_power_of_two_quantum = get_default_bool(p, "clock.power-of-two-quantum",
 			DEFAULT_CLOCK_POWER_OF_TWO_QUANTUM);
 	d->link_max_buffers = get_default_int(p, "link.max-buffers", DEFAULT_LINK_MAX_BUFFERS);
+	d->link_buffer_cache = get_default_int(p, "link.buffer-cache", DEFAULT_LINK_BUFFER_CACHE);
 	d->mem_warn_mlock = get_default_bool(p, "mem.warn-mlock", DEFAULT_MEM_WARN_MLOCK);
 	d->mem_allow_mlock = get_default_bool(p, "mem.allow-mlock", DEFAULT_MEM_ALLOW_MLOCK);
+	d->mem_slab = get_default_bool(p, "mem.slab", DEFAULT_MEM_SLAB);
 
 	d->check_quantum = get_default_bool(p, "settings.check-quantum", DEFAULT_CHECK_QUANTUM);
 	d->check_rate = get_default_bool(p, "settings.check-rate", DEFAULT_CHECK_RATE);
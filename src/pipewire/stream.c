@@ -11,6 +11,7 @@
 #include <spa/buffer/alloc.h>
 #include <spa/param/props.h>
 #include <spa/param/format-utils.h>
+#include <spa/param/audio/format-utils.h>
 #include <spa/param/peer-utils.h>
 #include <spa/node/io.h>
 #include <spa/node/utils.h>
@@ -34,6 +35,11 @@ PW_LOG_TOPIC_EXTERN(log_stream);
 
 #define MASK_BUFFERS	(MAX_BUFFERS-1)
 
+#define MAX_RING_PERIODS	16u
+#define MIN_RING_SIZE		4096u
+#define MAX_RING_SIZE		(64u * 1024u * 1024u)
+#define DEFAULT_RING_SIZE	(128u * 1024u)
+
 static bool mlock_warned = false;
 
 struct buffer {
@@ -147,6 +153,10 @@ struct stream {
 
 	struct spa_callbacks rt_callbacks;
 
+	struct pw_stream_ring ring;
+	struct pw_stream_ring_period ring_periods[MAX_RING_PERIODS];
+	uint32_t ring_period_count;
+
 	unsigned int have_peer_capability:1;
 	unsigned int disconnecting:1;
 	unsigned int disconnect_core:1;
@@ -158,6 +168,7 @@ struct stream {
 	unsigned int trigger:1;
 	unsigned int early_process:1;
 	unsigned int trigger_done_rt:1;
+	unsigned int ring_mode:1;
 	int in_set_param;
 	int in_emit_param_changed;
 	int pending_drain;
@@ -380,6 +391,26 @@ static inline int queue_push(struct stream *stream, struct queue *queue, struct
 	return 0;
 }
 
+/* push a batch of buffers with one update of the write index */
+static inline int queue_push_n(struct stream *stream, struct queue *queue,
+		struct buffer **buffers, uint32_t n_buffers)
+{
+	uint32_t i, index;
+
+	for (i = 0; i < n_buffers; i++)
+		if (buffers[i]->id >= stream->n_buffers)
+			return -EINVAL;
+
+	spa_ringbuffer_get_write_index(&queue->ring, &index);
+	for (i = 0; i < n_buffers; i++) {
+		queue->incount += buffers[i]->this.size;
+		queue->ids[(index + i) & MASK_BUFFERS] = buffers[i]->id;
+	}
+	spa_ringbuffer_write_update(&queue->ring, index + n_buffers);
+
+	return 0;
+}
+
 static inline bool queue_is_empty(struct stream *stream, struct queue *queue)
 {
 	uint32_t index;
@@ -404,6 +435,26 @@ static inline struct buffer *queue_pop(struct stream *stream, struct queue *queu
 
 	return buffer;
 }
+/* pop up to max_buffers with one update of the read index */
+static inline uint32_t queue_pop_n(struct stream *stream, struct queue *queue,
+		struct buffer **buffers, uint32_t max_buffers)
+{
+	uint32_t i, index, n_buffers;
+	int32_t avail;
+
+	avail = spa_ringbuffer_get_read_index(&queue->ring, &index);
+	n_buffers = SPA_MIN((uint32_t)SPA_MAX(avail, 0), max_buffers);
+
+	for (i = 0; i < n_buffers; i++) {
+		buffers[i] = &stream->buffers[queue->ids[(index + i) & MASK_BUFFERS]];
+		queue->outcount += buffers[i]->this.size;
+	}
+	if (n_buffers > 0)
+		spa_ringbuffer_read_update(&queue->ring, index + n_buffers);
+
+	return n_buffers;
+}
+
 static inline void clear_queue(struct stream *stream, struct queue *queue)
 {
 	spa_ringbuffer_init(&queue->ring);
@@ -466,13 +517,124 @@ static inline uint32_t update_requested(struct stream *impl)
 	return impl->have_requested;
 }
 
+static void ring_add_period(struct stream *impl, uint32_t index, uint32_t size)
+{
+	struct pw_stream_ring_period *p;
+
+	SPA_SEQ_WRITE(impl->seq);
+	p = &impl->ring_periods[impl->ring_period_count++ & (MAX_RING_PERIODS - 1)];
+	p->index = index;
+	p->size = size;
+	p->now = impl->time.now;
+	p->ticks = impl->time.ticks;
+	SPA_SEQ_WRITE(impl->seq);
+}
+
+static void ring_reset(struct stream *impl, uint32_t stride)
+{
+	SPA_SEQ_WRITE(impl->seq);
+	spa_ringbuffer_init(&impl->ring.ring);
+	impl->ring.stride = stride;
+	impl->ring_period_count = 0;
+	SPA_SEQ_WRITE(impl->seq);
+}
+
+static void ring_process_output(struct stream *impl)
+{
+	struct pw_stream *stream = &impl->this;
+	struct pw_stream_ring *r = &impl->ring;
+	struct pw_buffer *b;
+	struct spa_data *d;
+	uint32_t index, size, n, stride = SPA_MAX(r->stride, 1u);
+	int32_t avail;
+
+	if ((b = pw_stream_dequeue_buffer(stream)) == NULL)
+		return;
+
+	d = &b->buffer->datas[0];
+	size = n = 0;
+	avail = spa_ringbuffer_get_read_index(&r->ring, &index);
+
+	if (SPA_LIKELY(d->data != NULL)) {
+		size = d->maxsize;
+		if (b->requested)
+			size = SPA_MIN(size, b->requested * stride);
+		size -= size % stride;
+
+		n = SPA_CLAMP(avail, 0, (int32_t)r->size);
+		n = SPA_MIN(n, size);
+		n -= n % stride;
+
+		if (n > 0) {
+			spa_ringbuffer_read_data(&r->ring, r->data, r->size,
+					index & (r->size - 1), d->data, n);
+			spa_ringbuffer_read_update(&r->ring, index + n);
+		}
+		if (n < size) {
+			pw_log_trace_fp("%p: ring underrun %u < %u", impl, n, size);
+			memset(SPA_PTROFF(d->data, n, void), 0, size - n);
+		}
+	}
+	d->chunk->offset = 0;
+	d->chunk->size = size;
+	d->chunk->stride = r->stride;
+	d->chunk->flags = 0;
+
+	ring_add_period(impl, index, n);
+
+	pw_stream_queue_buffer(stream, b);
+}
+
+static void ring_process_input(struct stream *impl)
+{
+	struct pw_stream *stream = &impl->this;
+	struct pw_stream_ring *r = &impl->ring;
+	struct pw_buffer *b;
+	struct spa_data *d;
+	uint32_t index, offs, size, stride = SPA_MAX(r->stride, 1u);
+	int32_t filled;
+
+	while ((b = pw_stream_dequeue_buffer(stream)) != NULL) {
+		d = &b->buffer->datas[0];
+
+		if (SPA_LIKELY(d->data != NULL)) {
+			offs = SPA_MIN(d->chunk->offset, d->maxsize);
+			size = SPA_MIN(d->chunk->size, d->maxsize - offs);
+
+			filled = spa_ringbuffer_get_write_index(&r->ring, &index);
+			filled = SPA_CLAMP(filled, 0, (int32_t)r->size);
+			if (size > r->size - filled) {
+				pw_log_trace_fp("%p: ring overrun %u > %u", impl,
+						size, r->size - filled);
+				size = r->size - filled;
+				size -= size % stride;
+			}
+			if (size > 0) {
+				spa_ringbuffer_write_data(&r->ring, r->data, r->size,
+						index & (r->size - 1),
+						SPA_PTROFF(d->data, offs, void), size);
+				spa_ringbuffer_write_update(&r->ring, index + size);
+			}
+			ring_add_period(impl, index, size);
+		}
+		pw_stream_queue_buffer(stream, b);
+	}
+}
+
 static inline void call_process(struct stream *impl)
 {
 	pw_log_trace_fp("%p: call process buffers:%d", impl, impl->n_buffers);
 	if (impl->n_buffers == 0 ||
 	    (impl->direction == SPA_DIRECTION_OUTPUT && update_requested(impl) <= 0))
 		return;
-	if (impl->rt_callbacks.funcs && !impl->disconnecting)
+	if (impl->ring_mode) {
+		if (impl->disconnecting)
+			return;
+		if (impl->direction == SPA_DIRECTION_OUTPUT)
+			ring_process_output(impl);
+		else
+			ring_process_input(impl);
+	} else if (impl->rt_callbacks.funcs && !impl->disconnecting)
 		spa_callbacks_call_fast(&impl->rt_callbacks, struct pw_stream_events, process, 0);
 }
 
@@ -934,6 +1096,53 @@ static void emit_dummy_peer_capability(struct stream *impl, bool empty)
 	emit_param_changed(impl, SPA_PARAM_PeerCapability, param);
 }
 
+static uint32_t ring_frame_size(const struct spa_pod *param)
+{
+	uint32_t media_type, media_subtype;
+	struct spa_audio_info_raw info;
+
+	if (param == NULL ||
+	    spa_format_parse(param, &media_type, &media_subtype) < 0 ||
+	    media_type != SPA_MEDIA_TYPE_audio ||
+	    media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		return 0;
+
+	spa_zero(info);
+	if (spa_format_audio_raw_parse(param, &info) < 0)
+		return 0;
+
+	switch (info.format) {
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_S8:
+	case SPA_AUDIO_FORMAT_ALAW:
+	case SPA_AUDIO_FORMAT_ULAW:
+		return info.channels;
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16_OE:
+	case SPA_AUDIO_FORMAT_U16:
+		return info.channels * 2;
+	case SPA_AUDIO_FORMAT_S24:
+	case SPA_AUDIO_FORMAT_S24_OE:
+	case SPA_AUDIO_FORMAT_U24:
+		return info.channels * 3;
+	case SPA_AUDIO_FORMAT_S24_32:
+	case SPA_AUDIO_FORMAT_S24_32_OE:
+	case SPA_AUDIO_FORMAT_S32:
+	case SPA_AUDIO_FORMAT_S32_OE:
+	case SPA_AUDIO_FORMAT_U32:
+	case SPA_AUDIO_FORMAT_U32_OE:
+	case SPA_AUDIO_FORMAT_F32:
+	case SPA_AUDIO_FORMAT_F32_OE:
+		return info.channels * 4;
+	case SPA_AUDIO_FORMAT_F64:
+	case SPA_AUDIO_FORMAT_F64_OE:
+		return info.channels * 8;
+	default:
+		/* planar formats have more than one data plane */
+		return 0;
+	}
+}
+
 static int impl_port_set_param(void *object,
 			       enum spa_direction direction, uint32_t port_id,
 			       uint32_t id, uint32_t flags,
@@ -969,6 +1178,13 @@ static int impl_port_set_param(void *object,
 			emit_dummy_peer_capability(impl, param == NULL);
 		parse_latency(stream, param, &fl);
 		break;
+	case SPA_PARAM_Format:
+		/* the ring can only hold interleaved frames */
+		if (impl->ring_mode && param != NULL && ring_frame_size(param) == 0) {
+			pw_log_warn("%p: format can't be used with a ring", impl);
+			return -ENOTSUP;
+		}
+		break;
 	}
 
 	if ((res = update_params(impl, id, fl, params, n_params)) < 0)
@@ -977,6 +1193,8 @@ static int impl_port_set_param(void *object,
 	switch (id) {
 	case SPA_PARAM_Format:
 		clear_buffers(stream);
+		if (impl->ring_mode)
+			ring_reset(impl, ring_frame_size(param));
 		user = impl->params[NODE_Format].user;
 		break;
 	default:
@@ -1771,6 +1989,9 @@ static void stream_free(struct pw_stream *stream)
 	if (impl->data.context)
 		pw_context_destroy(impl->data.context);
 
+	if (impl->ring.data != NULL)
+		munmap(impl->ring.data, impl->ring.size);
+
 	pw_properties_free(impl->port_props);
 	free(impl);
 }
@@ -1967,6 +2188,38 @@ static const char *get_media_class(struct stream *impl)
 	}
 }
 
+static int alloc_ring(struct stream *impl)
+{
+	struct pw_stream_ring *r = &impl->ring;
+	const char *str;
+	uint32_t size = DEFAULT_RING_SIZE, n = MIN_RING_SIZE;
+	void *data;
+
+	if (r->data != NULL)
+		return 0;
+
+	if ((str = pw_properties_get(impl->this.properties, PW_KEY_STREAM_RING_SIZE)) != NULL)
+		spa_atou32(str, &size, 0);
+	size = SPA_CLAMP(size, MIN_RING_SIZE, MAX_RING_SIZE);
+	while (n < size)
+		n <<= 1;
+
+	data = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		pw_log_error("%p: failed to allocate ring of %u bytes: %m", impl, n);
+		return -errno;
+	}
+	if (impl->allow_mlock && mlock(data, n) < 0)
+		pw_log(impl->warn_mlock ? SPA_LOG_LEVEL_WARN : SPA_LOG_LEVEL_DEBUG,
+				"%p: Failed to mlock ring %p %u: %m", impl, data, n);
+
+	r->data = data;
+	r->size = n;
+
+	pw_log_debug("%p: ring of %u bytes", impl, n);
+	return 0;
+}
+
 SPA_EXPORT int
 pw_stream_connect(struct pw_stream *stream,
 		  enum pw_direction direction,
@@ -1992,6 +2245,10 @@ pw_stream_connect(struct pw_stream *stream,
 
 	impl->direction =
 	    direction == PW_DIRECTION_INPUT ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT;
+	/* the ring is served from the data thread without calling process */
+	impl->ring_mode = SPA_FLAG_IS_SET(flags, PW_STREAM_FLAG_RING);
+	if (impl->ring_mode)
+		flags |= PW_STREAM_FLAG_RT_PROCESS | PW_STREAM_FLAG_MAP_BUFFERS;
 	impl->flags = flags;
 	impl->node_methods = impl_node;
 
@@ -2163,6 +2420,12 @@ pw_stream_connect(struct pw_stream *stream,
 	if ((str = pw_properties_get(stream->properties, "mem.allow-mlock")) != NULL)
 		impl->allow_mlock = pw_properties_parse_bool(str);
 
+	if (impl->ring_mode) {
+		if ((res = alloc_ring(impl)) < 0)
+			return res;
+		ring_reset(impl, 0);
+	}
+
 	if (stream->core == NULL) {
 		stream->core = pw_context_connect(impl->context,
 				pw_properties_copy(stream->properties), 0);
@@ -2610,6 +2873,142 @@ int pw_stream_queue_buffer(struct pw_stream *stream, struct pw_buffer *buffer)
 	return res;
 }
 
+SPA_EXPORT
+int pw_stream_dequeue_buffers(struct pw_stream *stream, struct pw_buffer **buffers,
+		uint32_t n_buffers)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct buffer *bufs[MAX_BUFFERS];
+	uint32_t i, n, count = 0;
+
+	/* For reliable output streams, only give buffers when both queue AND output IO are clear */
+	if (impl->direction == SPA_DIRECTION_OUTPUT && stream->node->reliable) {
+		struct spa_io_buffers *io = impl->io;
+
+		if (!queue_is_empty(impl, &impl->queued) || io->status == SPA_STATUS_HAVE_DATA)
+			return -EAGAIN;
+	}
+
+	n = queue_pop_n(impl, &impl->dequeued, bufs, SPA_MIN(n_buffers, MAX_BUFFERS));
+	if (n == 0) {
+		pw_log_trace_fp("%p: no more buffers", stream);
+		return -EPIPE;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct buffer *b = bufs[i];
+
+		if (b->busy && impl->direction == SPA_DIRECTION_OUTPUT) {
+			if (SPA_ATOMIC_INC(b->busy->count) > 1) {
+				SPA_ATOMIC_DEC(b->busy->count);
+				queue_push(impl, &impl->dequeued, b);
+				pw_log_trace_fp("%p: buffer %d busy", stream, b->id);
+				continue;
+			}
+		}
+		SPA_FLAG_SET(b->flags, BUFFER_FLAG_DEQUEUED);
+		buffers[count++] = &b->this;
+	}
+	pw_log_trace_fp("%p: dequeued %d of %d buffers", stream, count, n);
+
+	return count > 0 ? (int)count : -EBUSY;
+}
+
+SPA_EXPORT
+int pw_stream_queue_buffers(struct pw_stream *stream, struct pw_buffer **buffers,
+		uint32_t n_buffers)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct buffer *bufs[MAX_BUFFERS];
+	uint64_t seen = 0;
+	uint32_t i;
+	int res;
+
+	if (n_buffers > MAX_BUFFERS)
+		return -EINVAL;
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = SPA_CONTAINER_OF(buffers[i], struct buffer, this);
+
+		if (!SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_DEQUEUED) ||
+		    b->id >= impl->n_buffers || (seen & (1ull << b->id))) {
+			pw_log_warn("%p: tried to queue cleared buffer %d", stream, b->id);
+			return -EINVAL;
+		}
+		seen |= 1ull << b->id;
+		bufs[i] = b;
+	}
+	/* the flags need to be cleared before the data thread can see the
+	 * buffers, undo this when they could not be queued */
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = bufs[i];
+
+		SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_DEQUEUED);
+		if (b->busy)
+			SPA_ATOMIC_DEC(b->busy->count);
+	}
+	pw_log_trace_fp("%p: queue %d buffers", stream, n_buffers);
+
+	if ((res = queue_push_n(impl, &impl->queued, bufs, n_buffers)) < 0) {
+		for (i = 0; i < n_buffers; i++) {
+			struct buffer *b = bufs[i];
+
+			if (b->busy)
+				SPA_ATOMIC_INC(b->busy->count);
+			SPA_FLAG_SET(b->flags, BUFFER_FLAG_DEQUEUED);
+		}
+		return res;
+	}
+
+	if (impl->direction == SPA_DIRECTION_OUTPUT &&
+	    stream->node->driving && !impl->using_trigger && n_buffers > 0) {
+		pw_log_debug("deprecated: use pw_stream_trigger_process() to drive the stream.");
+		res = pw_loop_invoke(impl->data_loop,
+			do_trigger_deprecated, 1, NULL, 0, false, impl);
+	}
+	return res;
+}
+
+SPA_EXPORT
+struct pw_stream_ring *pw_stream_get_ring(struct pw_stream *stream)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+
+	if (impl->ring.data == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return &impl->ring;
+}
+
+SPA_EXPORT
+int pw_stream_ring_get_period(struct pw_stream *stream, uint32_t index,
+		struct pw_stream_ring_period *period)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct pw_stream_ring_period periods[MAX_RING_PERIODS];
+	uintptr_t seq1, seq2;
+	uint32_t i, count;
+
+	do {
+		seq1 = SPA_SEQ_READ(impl->seq);
+		count = impl->ring_period_count;
+		memcpy(periods, impl->ring_periods, sizeof(periods));
+		seq2 = SPA_SEQ_READ(impl->seq);
+	} while (!SPA_SEQ_READ_SUCCESS(seq1, seq2));
+
+	/* search from the most recent period back */
+	for (i = 0; i < SPA_MIN(count, MAX_RING_PERIODS); i++) {
+		struct pw_stream_ring_period *p =
+			&periods[(count - 1 - i) & (MAX_RING_PERIODS - 1)];
+		if (index == SPA_ID_INVALID || index - p->index < p->size) {
+			*period = *p;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
 static inline int queue_push_front(struct stream *stream, struct queue *queue, struct buffer *buffer)
 {
 	int ret = 0;
@@ -2649,8 +3048,9 @@ do_flush(struct spa_loop *loop,
                  bool async, uint32_t seq, const void *data, size_t size, void *user_data)
 {
 	struct stream *impl = user_data;
-	struct buffer *b;
+	struct buffer *bufs[MAX_BUFFERS];
 	struct queue *from, *to;
+	uint32_t n;
 
 	pw_log_trace_fp("%p: flush", impl);
 
@@ -2661,12 +3061,8 @@ do_flush(struct spa_loop *loop,
 		from = &impl->dequeued;
 		to = &impl->queued;
 	}
-	do {
-		b = queue_pop(impl, from);
-		if (b != NULL)
-			queue_push(impl, to, b);
-	}
-	while (b);
+	while ((n = queue_pop_n(impl, from, bufs, MAX_BUFFERS)) > 0)
+		queue_push_n(impl, to, bufs, n);
 
 	impl->queued.outcount = impl->dequeued.incount =
 		impl->dequeued.outcount = impl->queued.incount = 0;
@@ -241,6 +241,7 @@ struct pw_stream;
 #include <spa/param/param.h>
 #include <spa/pod/command.h>
 #include <spa/pod/event.h>
+#include <spa/utils/ringbuffer.h>
 
 /** \enum pw_stream_state The state of a stream */
 enum pw_stream_state {
@@ -501,6 +502,36 @@ enum pw_stream_flags {
 	PW_STREAM_FLAG_RT_TRIGGER_DONE	= (1 << 12),	/**< Call trigger_done from the realtime
 							  *  thread. You MUST use RT safe functions
 							  *  in the trigger_done callback. Since 1.1.0 */
+	PW_STREAM_FLAG_RING		= (1 << 13),	/**< Transfer the data through a ring of
+							  *  frames that can be read or written
+							  *  from any thread, see
+							  *  pw_stream_get_ring(). The process
+							  *  callback is not called. Since 1.7.0 */
+};
+
+/** A ring of frames for streams connected with \ref PW_STREAM_FLAG_RING.
+ *
+ * The data thread of the stream reads from the ring for playback streams
+ * and writes to the ring for capture streams. The application uses the
+ * other side of \a ring with the spa_ringbuffer functions. The indexes are
+ * in bytes and \a size is a power of 2. The ring is emptied when the
+ * stream is connected and when the format changes. Only formats with
+ * interleaved frames can be negotiated. Since 1.7.0 */
+struct pw_stream_ring {
+	struct spa_ringbuffer ring;	/**< read and write index */
+	void *data;			/**< the ring memory */
+	uint32_t size;			/**< size of \a data in bytes */
+	uint32_t stride;		/**< size of a frame in bytes, 0 when unknown */
+};
+
+/** The timing of one graph cycle of a \ref PW_STREAM_FLAG_RING stream.
+ * Since 1.7.0 */
+struct pw_stream_ring_period {
+	uint32_t index;			/**< ring index of the first byte of the period */
+	uint32_t size;			/**< bytes transferred in the period */
+	int64_t now;			/**< the time of the period in nanoseconds,
+					  *  see \ref pw_time */
+	uint64_t ticks;			/**< the ticks of the period, see \ref pw_time */
 };
 
 /** Create a new unconnected \ref pw_stream
@@ -622,6 +653,29 @@ int pw_stream_queue_buffer(struct pw_stream *stream, struct pw_buffer *buffer);
  * immediately available to dequeue again. RT safe. */
 int pw_stream_return_buffer(struct pw_stream *stream, struct pw_buffer *buffer);
 
+/** Get up to \a n_buffers buffers at once, like pw_stream_dequeue_buffer().
+ * Returns the number of buffers placed in \a buffers or a negative error
+ * code when no buffer could be dequeued. RT safe. Since 1.7.0 */
+int pw_stream_dequeue_buffers(struct pw_stream *stream, struct pw_buffer **buffers,
+		uint32_t n_buffers);
+
+/** Queue \a n_buffers dequeued buffers at once, like pw_stream_queue_buffer().
+ * Either all or none of the buffers are queued. RT safe. Since 1.7.0 */
+int pw_stream_queue_buffers(struct pw_stream *stream, struct pw_buffer **buffers,
+		uint32_t n_buffers);
+
+/** Get the ring of a stream connected with \ref PW_STREAM_FLAG_RING.
+ * Returns NULL with errno set when the stream has no ring. The ring stays
+ * valid until the stream is destroyed. Since 1.7.0 */
+struct pw_stream_ring *pw_stream_get_ring(struct pw_stream *stream);
+
+/** Get the period that transferred the byte at ring \a index, or the
+ * last period when \a index is SPA_ID_INVALID. Only the most recent
+ * periods are kept, -ENOENT is returned for older indexes. RT safe.
+ * Since 1.7.0 */
+int pw_stream_ring_get_period(struct pw_stream *stream, uint32_t index,
+		struct pw_stream_ring_period *period);
+
 /** Activate or deactivate the stream */
 int pw_stream_set_active(struct pw_stream *stream, bool active);
 
@@ -3,10 +3,12 @@
 /* SPDX-License-Identifier: MIT */
 
 #include <pipewire/pipewire.h>
+#include <pipewire/impl-module.h>
 #include <pipewire/main-loop.h>
 #include <pipewire/stream.h>
 
 #include <spa/utils/string.h>
+#include <spa/param/audio/format-utils.h>
 
 #define TEST_FUNC(a,b,func)	\
 do {				\
@@ -132,6 +134,7 @@ static void test_create(void)
 	struct spa_hook listener = { 0, };
 	const char *error = NULL;
 	struct pw_time tm;
+	struct pw_stream_ring_period period;
 
 	loop = pw_main_loop_new(NULL);
 	context = pw_context_new(pw_main_loop_get_loop(loop), NULL, 12);
@@ -162,6 +165,11 @@ static void test_create(void)
 
 	spa_assert_se(pw_stream_dequeue_buffer(stream) == NULL);
 
+	/* no ring without PW_STREAM_FLAG_RING */
+	spa_assert_se(pw_stream_get_ring(stream) == NULL);
+	spa_assert_se(errno == EINVAL);
+	spa_assert_se(pw_stream_ring_get_period(stream, SPA_ID_INVALID, &period) == -ENOENT);
+
 	/* check destroy */
 	destroy_count = 0;
 	stream_events.destroy = stream_destroy_count;
@@ -223,6 +231,213 @@ static void test_properties(void)
 	pw_main_loop_destroy(loop);
 }
 
+struct link_data {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct pw_core *core;
+
+	struct pw_stream *out;
+	struct pw_stream *in;
+	struct spa_hook out_listener;
+	struct spa_hook in_listener;
+	struct pw_proxy *link;
+
+	uint32_t n_out_buffers;
+};
+
+static void link_out_add_buffer(void *data, struct pw_buffer *buffer)
+{
+	struct link_data *d = data;
+	d->n_out_buffers++;
+}
+
+static void link_out_remove_buffer(void *data, struct pw_buffer *buffer)
+{
+	struct link_data *d = data;
+	d->n_out_buffers--;
+}
+
+static const struct pw_stream_events link_out_events =
+{
+	PW_VERSION_STREAM_EVENTS,
+	.add_buffer = link_out_add_buffer,
+	.remove_buffer = link_out_remove_buffer,
+};
+
+static const struct pw_stream_events link_in_events =
+{
+	PW_VERSION_STREAM_EVENTS,
+};
+
+static void connect_stream(struct pw_stream *stream, enum pw_direction direction,
+		enum pw_stream_flags flags)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod *params[1];
+
+	params[0] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat,
+			&SPA_AUDIO_INFO_RAW_INIT(
+				.format = SPA_AUDIO_FORMAT_F32,
+				.rate = 48000,
+				.channels = 2,
+				.position = { SPA_AUDIO_CHANNEL_FL, SPA_AUDIO_CHANNEL_FR }));
+
+	spa_assert_se(pw_stream_connect(stream, direction, PW_ID_ANY,
+			flags | PW_STREAM_FLAG_MAP_BUFFERS, params, 1) == 0);
+}
+
+/* link an output stream to an input stream in the same process and wait
+ * until the output stream has buffers */
+static void link_streams(struct link_data *d, enum pw_stream_flags out_flags,
+		enum pw_stream_flags in_flags)
+{
+	struct pw_properties *props;
+	uint32_t out_id, in_id;
+
+	d->loop = pw_main_loop_new(NULL);
+	d->context = pw_context_new(pw_main_loop_get_loop(d->loop), NULL, 0);
+	spa_assert_se(d->context != NULL);
+	spa_assert_se(pw_context_load_module(d->context,
+			"libpipewire-module-link-factory", NULL, NULL) != NULL);
+	d->core = pw_context_connect_self(d->context, NULL, 0);
+	spa_assert_se(d->core != NULL);
+
+	/* there is no session manager to configure the ports */
+	d->out = pw_stream_new(d->core, "out",
+			pw_properties_new("adapter.auto-port-config", "{ mode = passthrough }",
+				NULL));
+	spa_assert_se(d->out != NULL);
+	pw_stream_add_listener(d->out, &d->out_listener, &link_out_events, d);
+	connect_stream(d->out, PW_DIRECTION_OUTPUT, out_flags | PW_STREAM_FLAG_DRIVER);
+
+	d->in = pw_stream_new(d->core, "in",
+			pw_properties_new("adapter.auto-port-config", "{ mode = passthrough }",
+				NULL));
+	spa_assert_se(d->in != NULL);
+	pw_stream_add_listener(d->in, &d->in_listener, &link_in_events, d);
+	connect_stream(d->in, PW_DIRECTION_INPUT, in_flags);
+
+	while (pw_stream_get_state(d->out, NULL) != PW_STREAM_STATE_PAUSED ||
+	    pw_stream_get_state(d->in, NULL) != PW_STREAM_STATE_PAUSED)
+		pw_loop_iterate(pw_main_loop_get_loop(d->loop), -1);
+
+	out_id = pw_stream_get_node_id(d->out);
+	in_id = pw_stream_get_node_id(d->in);
+
+	props = pw_properties_new(NULL, NULL);
+	pw_properties_setf(props, PW_KEY_LINK_OUTPUT_NODE, "%u", out_id);
+	pw_properties_setf(props, PW_KEY_LINK_INPUT_NODE, "%u", in_id);
+	d->link = pw_core_create_object(d->core, "link-factory",
+			PW_TYPE_INTERFACE_Link, PW_VERSION_LINK, &props->dict, 0);
+	pw_properties_free(props);
+	spa_assert_se(d->link != NULL);
+
+	while (d->n_out_buffers == 0 ||
+	    pw_stream_get_state(d->out, NULL) != PW_STREAM_STATE_STREAMING ||
+	    pw_stream_get_state(d->in, NULL) != PW_STREAM_STATE_STREAMING)
+		pw_loop_iterate(pw_main_loop_get_loop(d->loop), -1);
+}
+
+static void unlink_streams(struct link_data *d)
+{
+	pw_proxy_destroy(d->link);
+	pw_stream_destroy(d->out);
+	pw_stream_destroy(d->in);
+	pw_context_destroy(d->context);
+	pw_main_loop_destroy(d->loop);
+}
+
+static void test_queue_buffers(void)
+{
+	struct link_data d = { 0, };
+	struct pw_buffer *bufs[64], *dup[2];
+	int n, m;
+
+	link_streams(&d, 0, 0);
+	/* the cycles are started with pw_stream_trigger_process() */
+	spa_assert_se(pw_stream_trigger_process(d.out) >= 0);
+
+	/* all buffers of an output stream start out dequeueable */
+	n = pw_stream_dequeue_buffers(d.out, bufs, SPA_N_ELEMENTS(bufs));
+	spa_assert_se(n > 0);
+	spa_assert_se((uint32_t)n == d.n_out_buffers);
+	spa_assert_se(pw_stream_dequeue_buffers(d.out, bufs, 1) == -EPIPE);
+
+	/* the same buffer twice fails and leaves all buffers dequeued */
+	if (n >= 2) {
+		dup[0] = bufs[0];
+		dup[1] = bufs[0];
+		spa_assert_se(pw_stream_queue_buffers(d.out, dup, 2) == -EINVAL);
+	}
+	spa_assert_se(pw_stream_queue_buffers(d.out, bufs, n) == 0);
+
+	/* queued buffers can not be queued again */
+	spa_assert_se(pw_stream_queue_buffers(d.out, bufs, 1) == -EINVAL);
+	spa_assert_se(pw_stream_queue_buffer(d.out, bufs[0]) == -EINVAL);
+
+	/* the data thread recycles the queued buffers */
+	while ((m = pw_stream_dequeue_buffers(d.out, bufs, n)) < 0) {
+		spa_assert_se(m == -EPIPE);
+		pw_stream_trigger_process(d.out);
+		pw_loop_iterate(pw_main_loop_get_loop(d.loop), 10);
+	}
+	spa_assert_se(pw_stream_queue_buffers(d.out, bufs, m) == 0);
+
+	unlink_streams(&d);
+}
+
+static void test_ring(void)
+{
+	struct link_data d = { 0, };
+	struct pw_stream_ring *out, *in;
+	struct pw_stream_ring_period period;
+	float src[2048], dst[2048];
+	uint32_t i, index;
+	int32_t avail;
+
+	link_streams(&d, PW_STREAM_FLAG_RING, PW_STREAM_FLAG_RING);
+
+	out = pw_stream_get_ring(d.out);
+	in = pw_stream_get_ring(d.in);
+	spa_assert_se(out != NULL);
+	spa_assert_se(in != NULL);
+	spa_assert_se(out->stride == 2 * sizeof(float));
+	spa_assert_se(in->stride == 2 * sizeof(float));
+	spa_assert_se(pw_stream_ring_get_period(d.in, SPA_ID_INVALID, &period) == -ENOENT);
+
+	for (i = 0; i < SPA_N_ELEMENTS(src); i++)
+		src[i] = (float)i;
+
+	avail = spa_ringbuffer_get_write_index(&out->ring, &index);
+	spa_assert_se(avail == 0);
+	spa_ringbuffer_write_data(&out->ring, out->data, out->size,
+			index & (out->size - 1), src, sizeof(src));
+	spa_ringbuffer_write_update(&out->ring, index + sizeof(src));
+
+	/* the data threads move the frames from one ring to the other */
+	while ((avail = spa_ringbuffer_get_read_index(&in->ring, &index)) <
+	    (int32_t)sizeof(dst)) {
+		pw_stream_trigger_process(d.out);
+		pw_loop_iterate(pw_main_loop_get_loop(d.loop), 10);
+	}
+	spa_assert_se(index == 0);
+	spa_ringbuffer_read_data(&in->ring, in->data, in->size,
+			index & (in->size - 1), dst, sizeof(dst));
+	spa_ringbuffer_read_update(&in->ring, index + sizeof(dst));
+	spa_assert_se(memcmp(src, dst, sizeof(dst)) == 0);
+
+	/* the first period of the capture stream starts at the first frame */
+	spa_assert_se(pw_stream_ring_get_period(d.in, 0, &period) == 0);
+	spa_assert_se(period.index == 0);
+	spa_assert_se(period.size > 0);
+	spa_assert_se(period.size % in->stride == 0);
+	spa_assert_se(pw_stream_ring_get_period(d.in, SPA_ID_INVALID, &period) == 0);
+	spa_assert_se(period.index + period.size == (uint32_t)avail);
+
+	unlink_streams(&d);
+}
+
 int main(int argc, char *argv[])
 {
 	pw_init(&argc, &argv);
@@ -230,6 +445,8 @@ int main(int argc, char *argv[])
 	test_abi();
 	test_create();
 	test_properties();
+	test_queue_buffers();
+	test_ring();
 
 	pw_deinit();
 
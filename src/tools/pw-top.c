@@ -12,6 +12,7 @@
 
 #include <spa/utils/result.h>
 #include <spa/utils/string.h>
+#include <spa/utils/json.h>
 #include <spa/pod/parser.h>
 #include <spa/debug/types.h>
 #include <spa/param/format-utils.h>
@@ -64,6 +65,7 @@ struct node {
 	struct spa_hook proxy_listener;
 	unsigned int inactive:1;
 	struct spa_hook object_listener;
+	char *timing;
 };
 
 struct data {
@@ -88,6 +90,11 @@ struct data {
 	unsigned pending_refresh:1;
 
 	WINDOW *win;
+	/* the selected node and the rows around it in the last refresh */
+	uint32_t selected;
+	uint32_t row_first;
+	uint32_t row_prev;
+	uint32_t row_next;
 
 	unsigned int batch_mode:1;
 	int iterations;
@@ -207,8 +214,17 @@ static void node_info(void *data, const struct pw_node_info *info)
 		do_refresh(n->data, !n->data->batch_mode);
 	}
 
-	if (info->change_mask & PW_NODE_CHANGE_MASK_PROPS)
+	if (info->change_mask & PW_NODE_CHANGE_MASK_PROPS) {
+		const char *str;
+
 		set_node_name(n, find_node_name(info->props));
+
+		str = spa_dict_lookup(info->props, "filter-graph.node.timing");
+		if (!spa_streq(str, n->timing)) {
+			free(n->timing);
+			n->timing = str ? strdup(str) : NULL;
+		}
+	}
 }
 
 static void node_param(void *data, int seq,
@@ -365,6 +381,7 @@ static void remove_node(struct data *d, struct node *n)
 	d->n_nodes--;
 	if (!d->batch_mode)
 		d->pending_refresh = true;
+	free(n->timing);
 	free(n);
 }
 
@@ -554,10 +571,76 @@ static void clear_node(struct node *n)
 }
 
 #define HEADER	"S   ID  QUANT   RATE    WAIT    BUSY   W/Q   B/Q  ERR FORMAT           NAME "
+#define TIMING_HEADER	"     MIN     AVG     MAX  INST LABEL            FILTER "
+
+static void print_row(struct data *d, struct node *dr, struct node *n, int y,
+		struct node **selected)
+{
+	bool sel = !d->batch_mode && n->id == d->selected;
+
+	if (d->row_first == SPA_ID_INVALID)
+		d->row_first = n->id;
+	if (sel) {
+		wattron(d->win, A_REVERSE);
+		*selected = n;
+	} else if (*selected == NULL)
+		d->row_prev = n->id;
+	else if (d->row_next == SPA_ID_INVALID)
+		d->row_next = n->id;
+
+	print_node(d, dr, n, y);
+	if (sel)
+		wattroff(d->win, A_REVERSE);
+}
+
+/* print the run time of the nodes of a filter-graph, published by
+ * filter-chain when profiling is enabled */
+static int print_timing(struct data *d, struct node *n, int y)
+{
+	struct spa_json it[2];
+	char key[64], name[MAX_NAME], label[MAX_NAME], buf[3][64];
+	const char *val;
+	int len;
+
+	if (spa_json_begin_array(&it[0], n->timing, strlen(n->timing)) <= 0)
+		return y;
+
+	wmove(d->win, y++, 0);
+	wattron(d->win, A_REVERSE);
+	wprintw(d->win, "%-*.*s", COLS, COLS, TIMING_HEADER);
+	wattroff(d->win, A_REVERSE);
+
+	while (spa_json_enter_object(&it[0], &it[1]) > 0 && y < LINES) {
+		float min = 0.0f, avg = 0.0f, max = 0.0f;
+		int instances = 0;
+
+		name[0] = label[0] = '\0';
+		while ((len = spa_json_object_next(&it[1], key, sizeof(key), &val)) > 0) {
+			if (spa_streq(key, "name"))
+				spa_json_parse_stringn(val, len, name, sizeof(name));
+			else if (spa_streq(key, "label"))
+				spa_json_parse_stringn(val, len, label, sizeof(label));
+			else if (spa_streq(key, "instances"))
+				spa_json_parse_int(val, len, &instances);
+			else if (spa_streq(key, "min"))
+				spa_json_parse_float(val, len, &min);
+			else if (spa_streq(key, "avg"))
+				spa_json_parse_float(val, len, &avg);
+			else if (spa_streq(key, "max"))
+				spa_json_parse_float(val, len, &max);
+		}
+		print_mode_dependent(d, y++, 0, "%s %s %s %5d %-16.16s %s",
+				print_time(buf[0], true, 64, (uint64_t)min),
+				print_time(buf[1], true, 64, (uint64_t)avg),
+				print_time(buf[2], true, 64, (uint64_t)max),
+				instances, label, name);
+	}
+	return y;
+}
 
 static void do_refresh(struct data *d, bool force_refresh)
 {
-	struct node *n, *t, *f;
+	struct node *n, *t, *f, *selected = NULL;
 	int y = 1;
 
 	if (!d->pending_refresh && !force_refresh)
@@ -572,11 +655,12 @@ static void do_refresh(struct data *d, bool force_refresh)
 	} else
 		printf(HEADER "\n");
 
+	d->row_first = d->row_prev = d->row_next = SPA_ID_INVALID;
 	spa_list_for_each_safe(n, t, &d->node_list, link) {
 		if (n->driver != n)
 			continue;
 
-		print_node(d, n, n, y++);
+		print_row(d, n, n, y++, &selected);
 		if(!d->batch_mode && y > LINES)
 			break;
 
@@ -587,12 +671,16 @@ static void do_refresh(struct data *d, bool force_refresh)
 			if (f->driver != n || f == n)
 				continue;
 
-			print_node(d, n, f, y++);
+			print_row(d, n, f, y++, &selected);
 			if(!d->batch_mode && y > LINES)
 				break;
 
 		}
 	}
+	if (selected == NULL)
+		d->selected = SPA_ID_INVALID;
+	else if (selected->timing != NULL && y + 1 < LINES)
+		y = print_timing(d, selected, y + 1);
 
 	if (!d->batch_mode) {
 		// Clear from last line to the end of the window to hide text wrapping from the last node
@@ -785,6 +873,7 @@ static void terminal_start(void)
 	initscr();
 	cbreak();
 	noecho();
+	keypad(stdscr, TRUE);
 	refresh();
 }
 
@@ -807,6 +896,18 @@ static void do_handle_io(void *data, int fd, uint32_t mask)
 		case 'c':
 			reset_xruns(d);
 			break;
+		case KEY_UP:
+			if (d->selected != SPA_ID_INVALID)
+				d->selected = d->row_prev;
+			do_refresh(d, true);
+			break;
+		case KEY_DOWN:
+			if (d->selected == SPA_ID_INVALID)
+				d->selected = d->row_first;
+			else if (d->row_next != SPA_ID_INVALID)
+				d->selected = d->row_next;
+			do_refresh(d, true);
+			break;
 		default:
 			do_refresh(d, !d->batch_mode);
 			break;
@@ -835,6 +936,7 @@ int main(int argc, char *argv[])
 	pw_init(&argc, &argv);
 
 	data.iterations = -1;
+	data.selected = SPA_ID_INVALID;
 
 	spa_list_init(&data.node_list);
 
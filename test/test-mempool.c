@@ -5,6 +5,7 @@
 #include <unistd.h>
 
 #include <pipewire/mem.h>
+#include <pipewire/properties.h>
 #include <spa/buffer/buffer.h>
 
 #include "pwtest.h"
@@ -105,10 +106,180 @@ PWTEST(map_range_overflow)
 	return PWTEST_PASS;
 }
 
+PWTEST(mempool_slab)
+{
+	struct pw_mempool_stats stats;
+	struct pw_memblock *b[3];
+	uint32_t flags = PW_MEMBLOCK_FLAG_READWRITE | PW_MEMBLOCK_FLAG_SEAL |
+		PW_MEMBLOCK_FLAG_MAP | PW_MEMBLOCK_FLAG_SLAB;
+
+	struct pw_mempool *p = pw_mempool_new(NULL);
+	pwtest_ptr_notnull(p);
+
+	/* two blocks of the same size class share an arena */
+	b[0] = pw_mempool_alloc(p, flags, SPA_DATA_MemFd, 5000);
+	pwtest_ptr_notnull(b[0]);
+	b[1] = pw_mempool_alloc(p, flags, SPA_DATA_MemFd, 8000);
+	pwtest_ptr_notnull(b[1]);
+	pwtest_int_eq(b[0]->fd, b[1]->fd);
+	pwtest_int_ne(b[0]->id, b[1]->id);
+	pwtest_int_eq(b[0]->map->offset, 0u);
+	pwtest_int_eq(b[1]->map->offset, 8192u);
+	pwtest_ptr_eq(pw_mempool_find_ptr(p, b[1]->map->ptr), b[1]);
+
+	/* too large for a slot, gets its own fd */
+	b[2] = pw_mempool_alloc(p, flags, SPA_DATA_MemFd, 2 * 1024 * 1024);
+	pwtest_ptr_notnull(b[2]);
+	pwtest_int_ne(b[2]->fd, b[0]->fd);
+
+	memset(b[1]->map->ptr, 0x55, b[1]->size);
+
+	/* mapping the slot again through the fd sees the same memory */
+	struct pw_memmap *mm = pw_mempool_map_id(p, b[1]->id, PW_MEMMAP_FLAG_READ,
+			b[1]->map->offset + 100, 100, NULL);
+	pwtest_ptr_notnull(mm);
+	pwtest_int_eq(((uint8_t*)mm->ptr)[0], 0x55);
+	pw_memmap_free(mm);
+
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.n_blocks, 3u);
+	pwtest_int_eq(stats.n_arenas, 1u);
+	pwtest_int_eq(stats.n_slots, 2u);
+	pwtest_int_eq(stats.slot_size, 16384u);
+	pwtest_int_eq(stats.requested_size, 13000u);
+
+	/* a freed slot is reused, cleared like a new block */
+	memset(b[0]->map->ptr, 0xaa, b[0]->size);
+	pw_memblock_unref(b[0]);
+	b[0] = pw_mempool_alloc(p, flags, SPA_DATA_MemFd, 8192);
+	pwtest_ptr_notnull(b[0]);
+	pwtest_int_eq(b[0]->fd, b[1]->fd);
+	pwtest_int_eq(b[0]->map->offset, 0u);
+	for (uint32_t i = 0; i < b[0]->size; i++)
+		pwtest_int_eq(((uint8_t*)b[0]->map->ptr)[i], 0);
+
+	pw_memblock_unref(b[0]);
+	pw_memblock_unref(b[1]);
+	pw_memblock_unref(b[2]);
+
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.n_blocks, 0u);
+	pwtest_int_eq(stats.n_slots, 0u);
+	pwtest_int_eq(stats.requested_size, 0u);
+
+	pw_mempool_destroy(p);
+
+	return PWTEST_PASS;
+}
+
+PWTEST(mempool_map_cache)
+{
+	struct pw_mempool_stats stats;
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	struct pw_mempool *p = pw_mempool_new(NULL);
+	pwtest_ptr_notnull(p);
+
+	struct pw_memblock *b = pw_mempool_alloc(p, PW_MEMBLOCK_FLAG_READWRITE, SPA_DATA_MemFd, 4 * page_size);
+	pwtest_ptr_notnull(b);
+
+	struct pw_memmap *m1 = pw_mempool_map_id(p, b->id, PW_MEMMAP_FLAG_READWRITE, 0, page_size, NULL);
+	pwtest_ptr_notnull(m1);
+	void *ptr = m1->ptr;
+	pw_memmap_free(m1);
+
+	/* the unused mapping is reused */
+	m1 = pw_mempool_map_id(p, b->id, PW_MEMMAP_FLAG_READWRITE, 0, page_size, NULL);
+	pwtest_ptr_notnull(m1);
+	pwtest_ptr_eq(m1->ptr, ptr);
+
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.map_misses, 1u);
+	pwtest_int_eq(stats.map_hits, 1u);
+	pw_memmap_free(m1);
+
+	/* an adjacent range is coalesced with the unused mapping */
+	struct pw_memmap *m2 = pw_mempool_map_id(p, b->id, PW_MEMMAP_FLAG_READWRITE, page_size, page_size, NULL);
+	pwtest_ptr_notnull(m2);
+	m1 = pw_mempool_map_id(p, b->id, PW_MEMMAP_FLAG_READWRITE, 0, page_size, NULL);
+	pwtest_ptr_notnull(m1);
+	pwtest_ptr_eq(SPA_PTROFF(m1->ptr, page_size, void), m2->ptr);
+
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.map_misses, 2u);
+	pwtest_int_eq(stats.map_hits, 2u);
+	pwtest_int_eq(stats.map_cache_size, 0u);
+
+	pw_memmap_free(m1);
+	pw_memmap_free(m2);
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.map_cache_size, (uint64_t)(2 * page_size));
+
+	/* unused mappings go away with the block */
+	pw_memblock_unref(b);
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.map_cache_size, 0u);
+	pwtest_int_eq(stats.n_blocks, 0u);
+
+	pw_mempool_destroy(p);
+
+	return PWTEST_PASS;
+}
+
+PWTEST(mempool_lock_budget)
+{
+	struct pw_mempool_stats stats;
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	struct pw_mempool *p = pw_mempool_new(pw_properties_new("mem.lock-budget", "0", NULL));
+	pwtest_ptr_notnull(p);
+
+	struct pw_memblock *b = pw_mempool_alloc(p, PW_MEMBLOCK_FLAG_READWRITE, SPA_DATA_MemFd, page_size);
+	pwtest_ptr_notnull(b);
+
+	/* over budget, the mapping is still made */
+	struct pw_memmap *m = pw_mempool_map_id(p, b->id, PW_MEMMAP_FLAG_READWRITE | PW_MEMMAP_FLAG_RT,
+			0, page_size, NULL);
+	pwtest_ptr_notnull(m);
+
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.lock_budget, 0u);
+	pwtest_int_eq(stats.locked_size, 0u);
+	pwtest_int_eq(stats.lock_failures, 1u);
+
+	pw_memmap_free(m);
+	pw_memblock_unref(b);
+	pw_mempool_destroy(p);
+
+	p = pw_mempool_new(NULL);
+	pwtest_ptr_notnull(p);
+
+	b = pw_mempool_alloc(p, PW_MEMBLOCK_FLAG_READWRITE | PW_MEMBLOCK_FLAG_MAP |
+			PW_MEMBLOCK_FLAG_RT, SPA_DATA_MemFd, page_size);
+	pwtest_ptr_notnull(b);
+
+	/* the lock can still fail because of RLIMIT_MEMLOCK */
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.locked_size + stats.lock_failures * page_size, (uint64_t)page_size);
+	pwtest_bool_true(stats.locked_total >= stats.locked_size);
+
+	/* the lock is released with the mapping */
+	pw_memblock_unref(b);
+	pwtest_int_eq(pw_mempool_get_stats(p, &stats), 0);
+	pwtest_int_eq(stats.locked_size, 0u);
+
+	pw_mempool_destroy(p);
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(pw_mempool)
 {
 	pwtest_add(mempool_issue4884, PWTEST_NOARG);
 	pwtest_add(map_range_overflow, PWTEST_NOARG);
+	pwtest_add(mempool_slab, PWTEST_NOARG);
+	pwtest_add(mempool_map_cache, PWTEST_NOARG);
+	pwtest_add(mempool_lock_budget, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }